@@ -28,11 +28,39 @@
 
 #pragma once
 
+// -- Standard Libs
+#include <stdint.h>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoUtil.h"
+#include "MojoCollector.h"
+
 /** \cond HIDE_FORWARD_REFERENCE */
 template< typename value_T > class MojoArray;
 template< typename value_T > class MojoCollector;
 /** \endcond */
 
+/**
+ \enum MojoSetKind
+ \ingroup group_set_common
+ Kind of node in a set expression, as reported by MojoAbstractSet::_GetKind(). Used to walk expressions.
+ \private
+ */
+enum MojoSetKind
+{
+  /// A set that is not a boolean combination of other sets, such as MojoSet or MojoFunction.
+  kMojoSetKind_Leaf,
+  /// MojoIntersection.
+  kMojoSetKind_Intersection,
+  /// MojoUnion.
+  kMojoSetKind_Union,
+  /// MojoDifference. The first input is the set to subtract from.
+  kMojoSetKind_Difference,
+  /// MojoComplement.
+  kMojoSetKind_Complement
+};
+
 /**
  \interface MojoAbstractSet
  \ingroup group_set_common
@@ -46,6 +74,23 @@ public:
    Test if a key is an element of the set.
    */
   virtual bool Contains( const key_T& key ) const = 0;
+  /**
+   Test a block of keys. Only keys whose bit is set in mask are tested. The bit is cleared if the key is not an
+   element of the set. The default calls Contains() for each key. Override to avoid a virtual call per key.
+   \param[in] keys Keys to test.
+   \param[in] count Number of keys.
+   \param[in,out] mask One bit per key, MojoMaskWordCount( count ) words. See MojoMaskSetAll().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      if( MojoMaskTest( mask, i ) && !Contains( keys[ i ] ) )
+      {
+        MojoMaskClear( mask, i );
+      }
+    }
+  }
   /**
    Push all keys into the collector object.
    */
@@ -61,6 +106,49 @@ public:
    \private
    */
   virtual int _GetChangeCount() const = 0;
+  /**
+   Used internally to walk set expressions. Boolean sets report their kind and their inputs. All other sets are
+   leaves, with no inputs.
+   \private
+   */
+  virtual MojoSetKind _GetKind() const { return kMojoSetKind_Leaf; }
+  /** \private */
+  virtual int _GetInputCount() const { return 0; }
+  /** \private */
+  virtual const MojoAbstractSet< key_T >* _GetInput( int ) const { return NULL; }
+  /**
+   Used internally to combine bitmap sets a word at a time. A set stored as a bitmap, such as MojoBitSet, returns its
+   words, bit n standing for the key with ordinal n, and returns true. All other sets return false.
+   \private
+   */
+  virtual bool _GetWords( const uint64_t**, int* ) const { return false; }
+  /**
+   Used internally to push the keys for the bits set in words, where words[ 0 ] holds ordinals 64 * first_word
+   onward. Only called on sets that return words from _GetWords().
+   \private
+   */
+  virtual bool _EnumerateWords( const uint64_t*, int, int, const MojoCollector< key_T >&,
+                                const MojoAbstractSet< key_T >* ) const { return true; }
+  /**
+   Used internally to merge sorted sets. A set stored as an array sorted by hash, such as MojoSortedSet, returns its
+   hashes and keys, and returns true. All other sets return false.
+   \private
+   */
+  virtual bool _GetSorted( const uint64_t**, const key_T**, int* ) const { return false; }
+  /**
+   Used internally to update MojoCacheSet incrementally. A set that keeps a change log, such as a MojoSet created
+   with MojoConfig::m_ChangeLogCount, returns its current position in the log. All other sets return false.
+   Compare positions by their difference only, so that the comparison holds if the counter wraps around.
+   \private
+   */
+  virtual bool _GetChangeLogPosition( uint64_t* ) const { return false; }
+  /**
+   Used internally to update MojoCacheSet incrementally. Push every key inserted or removed since a position
+   returned by _GetChangeLogPosition(). A key may be pushed more than once.
+   \return False if the log no longer reaches back that far, or the set keeps no log.
+   \private
+   */
+  virtual bool _GetChangesSince( uint64_t, const MojoCollector< key_T >& ) const { return false; }
   virtual ~MojoAbstractSet() {}
 };
 
@@ -85,6 +173,24 @@ public:
   {
     return m_Set->Contains( value );
   }
+  virtual bool PushBatch( const value_T* values, int count ) const override
+  {
+    uint64_t mask[ kMojoBatchSize / 64 ];
+    for( int base = 0; base < count; base += kMojoBatchSize )
+    {
+      int n = MojoMin( count - base, kMojoBatchSize );
+      MojoMaskSetAll( mask, n );
+      m_Set->ContainsBatch( values + base, n, mask );
+      for( int i = 0; i < n; ++i )
+      {
+        if( !MojoMaskTest( mask, i ) )
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
 private:
   const MojoAbstractSet< value_T >* m_Set;
 };
@@ -104,10 +210,139 @@ public:
   {
     return !m_Set->Contains( value );
   }
+  virtual bool PushBatch( const value_T* values, int count ) const override
+  {
+    uint64_t mask[ kMojoBatchSize / 64 ];
+    for( int base = 0; base < count; base += kMojoBatchSize )
+    {
+      int n = MojoMin( count - base, kMojoBatchSize );
+      MojoMaskSetAll( mask, n );
+      m_Set->ContainsBatch( values + base, n, mask );
+      if( !MojoMaskIsEmpty( mask, n ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
 private:
   const MojoAbstractSet< value_T >* m_Set;
 };
 
+/**
+ \class MojoEnumerationBatch
+ \ingroup group_set_common
+ Used by Enumerate() implementations to hand keys to a collector in blocks of kMojoBatchSize. Keys are gathered
+ with Add(), tested against the limit set with one call to MojoAbstractSet::ContainsBatch() per block, and the
+ survivors are pushed with one call to MojoCollector::PushBatch(). Call Flush() when done.
+ \private
+ */
+template< typename key_T >
+class MojoEnumerationBatch final
+{
+public:
+  MojoEnumerationBatch( const MojoCollector< key_T >& collector, const MojoAbstractSet< key_T >* limit )
+  : m_Collector( collector )
+  , m_Limit( limit )
+  , m_Count( 0 )
+  {}
+  /**
+   Add a key to the block, and flush the block if full.
+   \return False if the collector aborted.
+   */
+  bool Add( const key_T& key )
+  {
+    m_Keys[ m_Count++ ] = key;
+    return m_Count < kMojoBatchSize || Flush();
+  }
+  /**
+   Add a contiguous range of keys. Without a limit set, keys are pushed straight from the range, without copying.
+   \return False if the collector aborted.
+   */
+  bool AddRange( const key_T* keys, int count )
+  {
+    if( !m_Limit )
+    {
+      return Flush() && ( !count || m_Collector.PushBatch( keys, count ) );
+    }
+    for( int i = 0; i < count; ++i )
+    {
+      if( !Add( keys[ i ] ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  /**
+   Test the pending keys against the limit set, and push the survivors.
+   \return False if the collector aborted.
+   */
+  bool Flush()
+  {
+    int count = m_Count;
+    m_Count = 0;
+    if( m_Limit && count )
+    {
+      uint64_t mask[ kMojoBatchSize / 64 ];
+      MojoMaskSetAll( mask, count );
+      m_Limit->ContainsBatch( m_Keys, count, mask );
+      int pass_count = 0;
+      for( int i = 0; i < count; ++i )
+      {
+        if( MojoMaskTest( mask, i ) )
+        {
+          if( pass_count != i )
+          {
+            m_Keys[ pass_count ] = m_Keys[ i ];
+          }
+          pass_count += 1;
+        }
+      }
+      count = pass_count;
+    }
+    return !count || m_Collector.PushBatch( m_Keys, count );
+  }
+private:
+  const MojoCollector< key_T >&     m_Collector;
+  const MojoAbstractSet< key_T >*   m_Limit;
+  int                               m_Count;
+  key_T                             m_Keys[ kMojoBatchSize ];
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+
+/**
+ Clear the mask bits of keys that are an element of any of the sets. Used by MojoDifference and MojoComplement.
+ \private
+ */
+template< typename key_T >
+void MojoExcludeBatch( const MojoAbstractSet< key_T >* const* sets, int set_count,
+                       const key_T* keys, int count, uint64_t* mask )
+{
+  uint64_t hits[ kMojoBatchSize / 64 ];
+  for( int base = 0; base < count; base += kMojoBatchSize )
+  {
+    int n = MojoMin( count - base, kMojoBatchSize );
+    int word_count = MojoMaskWordCount( n );
+    uint64_t* block_mask = mask + base / 64;
+    for( int i = 0; i < set_count && !MojoMaskIsEmpty( block_mask, n ); ++i )
+    {
+      for( int w = 0; w < word_count; ++w )
+      {
+        hits[ w ] = block_mask[ w ];
+      }
+      sets[ i ]->ContainsBatch( keys + base, n, hits );
+      for( int w = 0; w < word_count; ++w )
+      {
+        block_mask[ w ] &= ~hits[ w ];
+      }
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
 template< typename key_T >
 bool MojoIsSubsetOf( const MojoAbstractSet< key_T >* first, const MojoAbstractSet< key_T >* second )
 {
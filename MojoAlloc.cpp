@@ -28,6 +28,7 @@
 
 // Standard Libs
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "MojoAlloc.h"
 
@@ -38,14 +39,43 @@ class DefaultAlloc final : public MojoAlloc
 {
   virtual void* Allocate( size_t byte_count, const char* name ) override
   {
+    ( void )name;
     return malloc( byte_count );
   }
   virtual void Free( void* p ) override
   {
     free( p );
   }
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name ) override
+  {
+    ( void )old_byte_count;
+    ( void )name;
+    return realloc( p, new_byte_count );
+  }
 };
 
+void* MojoAlloc::AllocateAligned( size_t byte_count, size_t alignment, const char* name )
+{
+  // Room to align, and to keep the address of the block just before the aligned address.
+  alignment = alignment < sizeof( void* ) ? sizeof( void* ) : alignment;
+  char* block = ( char* )Allocate( byte_count + alignment + sizeof( void* ), name );
+  if( !block )
+  {
+    return NULL;
+  }
+  uintptr_t aligned = ( ( uintptr_t )block + sizeof( void* ) + alignment - 1 ) & ~( uintptr_t )( alignment - 1 );
+  ( ( void** )aligned )[ -1 ] = block;
+  return ( void* )aligned;
+}
+
+void MojoAlloc::FreeAligned( void* p )
+{
+  if( p )
+  {
+    Free( ( ( void** )p )[ -1 ] );
+  }
+}
+
 MojoAlloc* MojoAlloc::GetDefault()
 {
   static DefaultAlloc default_alloc;
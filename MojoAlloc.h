@@ -54,6 +54,53 @@ public:
    \param[in] p Pointer to the memory block
    */
   virtual void  Free( void* p ) = 0;
+  /**
+   Implement realloc() equivalent. Optional: the default implementation returns NULL, in which case the caller
+   will allocate a new block and copy.
+   Only blocks from Allocate() are passed in, never blocks from AllocateAligned().
+   \param[in] p Pointer to the memory block
+   \param[in] old_byte_count Number of bytes requested for the block when it was allocated or last resized.
+   \param[in] new_byte_count New number of bytes needed.
+   \param[in] name Name of the object requesting memory.
+   You may ignore this.
+   \return Pointer to the resized memory block, which may have moved. Contents are preserved up to the smaller of
+   the old and new size. NULL if the block could not be resized, in which case p is still valid.
+   */
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name )
+  {
+    ( void )p;
+    ( void )old_byte_count;
+    ( void )new_byte_count;
+    ( void )name;
+    return NULL;
+  }
+  /**
+   Allocate a block with a start address that is a multiple of alignment. Optional: the default implementation
+   allocates a larger block with Allocate(), and aligns within it.
+   \param[in] byte_count Number of bytes needed.
+   \param[in] alignment Required alignment. Must be a power of 2.
+   \param[in] name Name of the object requesting memory.
+   You may ignore this.
+   \return Pointer to memory block. NULL if memory could not be allocated.
+   */
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* name );
+  /**
+   Free a block from AllocateAligned(). If you implement AllocateAligned(), you must implement this as well.
+   \param[in] p Pointer to the memory block
+   */
+  virtual void  FreeAligned( void* p );
+  /**
+   Called by containers when they move their contents to a new block of a different size, instead of resizing the
+   old block with Reallocate(). Optional: the default implementation does nothing. See MojoTelemetryAlloc.
+   \param[in] name Name of the object that was resized.
+   */
+  virtual void  NotifyResize( const char* name ) { ( void )name; }
+  /**
+   Tell containers that memory is released all at once, rather than block by block. Containers will then not call
+   Free(), and will not visit values that need no destruction when they are destroyed. See MojoArenaAlloc.
+   \return true if Free() need not be called. The default implementation returns false.
+   */
+  virtual bool IsArena() const { return false; }
 
   /**
    Get global default allocator.
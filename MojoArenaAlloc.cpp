@@ -0,0 +1,165 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Standard Libs
+#include <stddef.h>
+
+#include "MojoArenaAlloc.h"
+
+// Allocations are aligned like malloc() does, which is enough for any type without extended alignment.
+static const size_t kAlignment = 16;
+
+static size_t AlignUp( size_t byte_count )
+{
+  return ( byte_count + kAlignment - 1 ) & ~( kAlignment - 1 );
+}
+
+// Block header size, rounded up so the first allocation in the block is aligned.
+static const size_t kHeaderSize = ( sizeof( void* ) + sizeof( size_t ) + kAlignment - 1 ) & ~( kAlignment - 1 );
+
+MojoArenaAlloc::MojoArenaAlloc( size_t block_size, MojoAlloc* parent )
+{
+  m_Parent = parent ? parent : MojoAlloc::GetDefault();
+  m_BlockSize = block_size;
+  m_Block = NULL;
+  m_Top = NULL;
+  m_End = NULL;
+  m_Last = NULL;
+  m_UsedByteCount = 0;
+  m_BlockByteCount = 0;
+}
+
+MojoArenaAlloc::~MojoArenaAlloc()
+{
+  while( m_Block )
+  {
+    Block* previous = m_Block->m_Previous;
+    FreeBlock( m_Block );
+    m_Block = previous;
+  }
+}
+
+void* MojoArenaAlloc::Allocate( size_t byte_count, const char* name )
+{
+  ( void )name;
+  size_t aligned_count = AlignUp( byte_count ? byte_count : 1 );
+  if( !m_Top || ( size_t )( m_End - m_Top ) < aligned_count )
+  {
+    if( !NewBlock( aligned_count ) )
+    {
+      return NULL;
+    }
+  }
+  m_Last = m_Top;
+  m_Top += aligned_count;
+  m_UsedByteCount += aligned_count;
+  return m_Last;
+}
+
+void MojoArenaAlloc::Free( void* p )
+{
+  // Only the most recent allocation can be taken back.
+  if( p && p == m_Last )
+  {
+    m_UsedByteCount -= m_Top - m_Last;
+    m_Top = m_Last;
+    m_Last = NULL;
+  }
+}
+
+void* MojoArenaAlloc::Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name )
+{
+  ( void )old_byte_count;
+  ( void )name;
+  // Only the most recent allocation can grow or shrink in place.
+  if( p && p == m_Last )
+  {
+    size_t aligned_count = AlignUp( new_byte_count ? new_byte_count : 1 );
+    if( ( size_t )( m_End - m_Last ) >= aligned_count )
+    {
+      m_UsedByteCount += aligned_count;
+      m_UsedByteCount -= m_Top - m_Last;
+      m_Top = m_Last + aligned_count;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+void MojoArenaAlloc::Reset()
+{
+  // Keep the current block if it is a standard one. Oversized blocks are not worth keeping.
+  Block* keep = ( m_Block && m_Block->m_Size == kHeaderSize + m_BlockSize ) ? m_Block : NULL;
+  Block* block = keep ? m_Block->m_Previous : m_Block;
+  while( block )
+  {
+    Block* previous = block->m_Previous;
+    FreeBlock( block );
+    block = previous;
+  }
+  m_Block = keep;
+  if( keep )
+  {
+    keep->m_Previous = NULL;
+    m_Top = ( char* )keep + kHeaderSize;
+    m_End = ( char* )keep + keep->m_Size;
+  }
+  else
+  {
+    m_Top = NULL;
+    m_End = NULL;
+  }
+  m_Last = NULL;
+  m_UsedByteCount = 0;
+}
+
+bool MojoArenaAlloc::NewBlock( size_t byte_count )
+{
+  size_t size = kHeaderSize + ( byte_count > m_BlockSize ? byte_count : m_BlockSize );
+  Block* block = ( Block* )m_Parent->Allocate( size, "MojoArenaAlloc" );
+  if( !block )
+  {
+    return false;
+  }
+  block->m_Previous = m_Block;
+  block->m_Size = size;
+  m_Block = block;
+  m_Top = ( char* )block + kHeaderSize;
+  m_End = ( char* )block + size;
+  m_Last = NULL;
+  m_BlockByteCount += size;
+  return true;
+}
+
+void MojoArenaAlloc::FreeBlock( Block* block )
+{
+  m_BlockByteCount -= block->m_Size;
+  m_Parent->Free( block );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
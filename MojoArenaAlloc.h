@@ -0,0 +1,131 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stddef.h>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoAlloc.h"
+
+/**
+ \class MojoArenaAlloc
+ \ingroup group_config
+ An allocator that hands out memory from large blocks, and releases it all at once.
+
+ Allocate() takes the next piece of the current block. When the block is full, a new block is taken from the parent
+ allocator. Free() does nothing, except when it frees the most recent allocation. That memory is handed out again.
+ Reallocate() grows the most recent allocation in place if it fits in the current block, so a MojoArray that is
+ filled while nothing else allocates does not have to copy. Reset() releases everything in one go.
+
+ IsArena() returns true, so containers that use the arena don't call Free(), and don't visit values that need no
+ destruction when they are destroyed. Destroying a MojoSet of MojoHash, for instance, does almost nothing.
+
+ \code
+ MojoArenaAlloc frame_alloc;
+ for( ;; )
+ {
+   {
+     MojoSet< MojoHash< int > > visible( "visible", NULL, &frame_alloc );
+     // ...
+   }
+   frame_alloc.Reset();
+ }
+ \endcode
+
+ \warning After Reset(), containers that allocated from the arena must not be used again. Destroying them is only
+ safe if their values need no destruction. Destroy containers of MojoId before calling Reset().
+ \note Not thread safe.
+ */
+class MojoArenaAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Constructor. Does not allocate any memory.
+   \param[in] block_size Size in bytes of the blocks taken from the parent allocator. Larger allocations get a
+   block of their own.
+   \param[in] parent Allocator to take blocks from. If omitted, the global default will be used. See documentation
+   for MojoAlloc for details on how to set the global default.
+   */
+  MojoArenaAlloc( size_t block_size = kMojoArenaBlockSize, MojoAlloc* parent = NULL );
+
+  /**
+   Destructor releases all blocks.
+   */
+  virtual ~MojoArenaAlloc();
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  virtual void  Free( void* p ) override;
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name ) override;
+  virtual bool  IsArena() const override { return true; }
+
+  /**
+   Release all memory handed out since construction or the last Reset(). The current block is kept for reuse, if
+   it is of the standard size. All other blocks go back to the parent allocator.
+   */
+  void Reset();
+
+  /**
+   Get the number of bytes handed out since construction or the last Reset(), including alignment padding.
+   \return Number of bytes.
+   */
+  size_t GetUsedByteCount() const { return m_UsedByteCount; }
+
+  /**
+   Get the number of bytes currently taken from the parent allocator, including block headers.
+   \return Number of bytes.
+   */
+  size_t GetBlockByteCount() const { return m_BlockByteCount; }
+
+private:
+  struct Block
+  {
+    Block*  m_Previous;
+    size_t  m_Size;       // Total size, including this header
+  };
+
+  // Copying would release the blocks twice.
+  MojoArenaAlloc( const MojoArenaAlloc& );
+  MojoArenaAlloc& operator=( const MojoArenaAlloc& );
+
+  MojoAlloc*  m_Parent;
+  size_t      m_BlockSize;
+  Block*      m_Block;            // Current block. Earlier blocks are linked through m_Previous.
+  char*       m_Top;              // Next free byte in current block
+  char*       m_End;              // End of current block
+  char*       m_Last;             // Most recent allocation, if it can still be rewound or grown. Otherwise NULL.
+  size_t      m_UsedByteCount;
+  size_t      m_BlockByteCount;
+
+  bool NewBlock( size_t byte_count );
+  void FreeBlock( Block* block );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
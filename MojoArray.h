@@ -35,8 +35,12 @@
 #include "MojoStatus.h"
 #include "MojoConfig.h"
 #include "MojoAlloc.h"
+#include "MojoUtil.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
+#include "MojoJobs.h"
+#include "MojoSet.h"
+#include "MojoMap.h"
 
 /**
  \class MojoArray
@@ -179,7 +183,7 @@ public:
    \param[in] value The new value.
    \return The old value.
    */
-  value_T SwapAt( int index, const value_T& value ) const;
+  value_T SwapAt( int index, const value_T& value );
 
   /**
    Return a single element.
@@ -204,11 +208,86 @@ public:
    Test presence of a value.
    \param[in] value The value to look for.
    \return true if value is present
-   \warning This is a performance hazard. The array is simply scanned. Use only with small arrays, or where
-   performance is not an issue.
+   \warning This is a performance hazard. Unless CreateIndex() was called, the array is simply scanned. Use only
+   with small arrays, or where performance is not an issue.
    */
   virtual bool Contains( const value_T& value ) const override;
 
+  /**
+   Test presence of a block of values. Uses the index if there is one, else scans the array for each value.
+   See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const value_T* values, int count, uint64_t* mask ) const override;
+
+  /**
+   Keep a hash index of the values in the array, so Contains() takes constant time. Every change to the array
+   updates the index in constant time per value added or removed, so Contains() only reads, and may be called from
+   more than one thread at a time.
+   Requires a hashable value type. The index is allocated with the allocator of the array.
+   \return Status code. Fails if the array uses a fixed buffer.
+   */
+  MojoStatus CreateIndex();
+
+  /**
+   Release the index created by CreateIndex(). Contains() will scan the array again.
+   */
+  void DestroyIndex();
+
+  /**
+   Get direct access to the values. Because the array is a ring buffer, the values occupy at most two contiguous
+   ranges of memory. The first range holds the values starting at index 0, the second range holds the rest. The
+   pointers remain valid until the array is changed.
+   \code
+   MojoSpan< const int > first, second;
+   array.GetSpans( &first, &second );
+   for( int i = 0; i < first.m_Count; ++i ) sum += first.m_Values[ i ];
+   for( int i = 0; i < second.m_Count; ++i ) sum += second.m_Values[ i ];
+   \endcode
+   \param[out] first Receives the first range.
+   \param[out] second Receives the second range. Its count is 0 if all values are in the first range.
+   */
+  void GetSpans( MojoSpan< const value_T >* first, MojoSpan< const value_T >* second ) const;
+
+  /**
+   Rotate the buffer in place, so that all values are in one contiguous range. After this, GetSpans() returns an
+   empty second range, until the array wraps around the end of the buffer again. Does not allocate memory.
+   \return Status code.
+   */
+  MojoStatus Linearize();
+
+  /**
+   Sort the values in order of GetHash(). For MojoHash of an unsigned type, that is ascending order. The sort is a
+   stable radix sort, and takes linear time. Arrays of kMojoJobMinCount values or more are sorted in parallel
+   through MojoJobs.
+   Requires a hashable value type.
+   \return Status code. Fails if the array uses a fixed buffer.
+   */
+  MojoStatus Sort();
+
+  /**
+   Sort the values as Sort() does, and remove duplicates.
+   \return Status code. Fails if the array uses a fixed buffer.
+   */
+  MojoStatus SortUnique();
+
+  /**
+   Sort the values with a comparison function object. The sort is a stable merge sort.
+   \code
+   names.SortBy( MojoIdLessByString() );
+   \endcode
+   \param[in] less Function object that returns true if its first argument goes before its second argument.
+   \return Status code. Fails if the array uses a fixed buffer.
+   */
+  template< typename less_T >
+  MojoStatus SortBy( const less_T& less );
+
+  /**
+   Replace the contents of a set with the values in the array. See MojoSet::FromArray().
+   \param[out] set The set to fill.
+   \return Status code.
+   */
+  MojoStatus ToSet( MojoSet< value_T >* set ) const;
+
   virtual bool Enumerate( const MojoCollector< value_T >& collector,
                          const MojoAbstractSet< value_T >* limit = NULL ) const override;
   /** \private */
@@ -218,6 +297,79 @@ public:
   
 private:
 
+  // Abstract, so value types that are not hashable only need to be hashable if CreateIndex() is used.
+  class Index
+  {
+  public:
+    virtual ~Index() {}
+    virtual bool Contains( const value_T& value ) const = 0;
+    virtual void ContainsBatch( const value_T* values, int count, uint64_t* mask ) const = 0;
+    virtual void Insert( const value_T& value ) = 0;
+    virtual void Remove( const value_T& value ) = 0;
+    virtual void Clear() = 0;
+  };
+
+  // Counts how many times each value is in the array, so removing one copy of a value keeps the others.
+  class HashIndex final : public Index
+  {
+  public:
+    HashIndex( const char* name, const MojoConfig* config, MojoAlloc* alloc )
+    : m_Counts( name, 0, config, alloc )
+    {}
+    virtual bool Contains( const value_T& value ) const override
+    {
+      return m_Counts.Contains( value );
+    }
+    virtual void ContainsBatch( const value_T* values, int count, uint64_t* mask ) const override
+    {
+      m_Counts.ContainsBatch( values, count, mask );
+    }
+    virtual void Insert( const value_T& value ) override
+    {
+      int* count = m_Counts.FindForImmediateChange( value );
+      if( count )
+      {
+        *count += 1;
+      }
+      else
+      {
+        m_Counts.Insert( value, 1 );
+      }
+    }
+    virtual void Remove( const value_T& value ) override
+    {
+      int* count = m_Counts.FindForImmediateChange( value );
+      if( count && --*count == 0 )
+      {
+        m_Counts.Remove( value );
+      }
+    }
+    virtual void Clear() override
+    {
+      m_Counts.Clear();
+    }
+  private:
+    MojoMap< value_T, int > m_Counts;
+  };
+
+  struct SortEntry
+  {
+    uint64_t  m_Hash;
+    int       m_Index;
+  };
+
+  // Shared by all jobs of a radix sort. Each job owns a contiguous range of entries, and a row of m_Offsets.
+  struct RadixContext
+  {
+    const MojoArray< value_T >* m_Array;
+    SortEntry*  m_Source;
+    SortEntry*  m_Target;
+    int         m_Count;
+    int         m_JobCount;
+    int         m_Shift;
+    int         m_Offsets[ kMojoJobMax ][ 256 ];
+  };
+
   MojoAlloc*          m_Alloc;
   const char*         m_Name;
   value_T*            m_Buffer;
@@ -229,14 +381,27 @@ private:
   int                 m_ChangeCount;
   MojoStatus          m_Status;
   MojoConfig          m_Config;
+  Index*              m_Index;
 
   void Init();
+  bool AllocatesOnDemand() const { return m_Alloc && m_Config.m_DynamicAlloc && m_Config.m_DynamicTable; }
+  void IndexInsert( const value_T& value );
+  void IndexRemove( const value_T& value );
+  static bool Scan( const value_T* values, int count, const value_T& value );
   MojoStatus Resize( int new_capacity );
   MojoStatus Grow( int count = 1 );
   MojoStatus Shrink();
   void Move( int from_index, int to_index, int count, bool clear );
+  void MoveBytes( int from_index, int to_index, int count );
+  void Reverse( int begin, int end );
   value_T* AllocAndConstruct( int new_buffer_count );
   void DestructAndFree( value_T* old_buffer, int old_buffer_count );
+  value_T& ValueAt( int index ) const { return m_Buffer[ ( m_StartIndex + index ) % m_BufferCount ]; }
+  MojoStatus Permute( const SortEntry* entries );
+  static void RunJobs( void ( *function )( void* context, int index ), RadixContext* context );
+  static void RadixFill( void* context, int job );
+  static void RadixCount( void* context, int job );
+  static void RadixScatter( void* context, int job );
 };
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -262,6 +427,14 @@ public:
     m_Array->Push( value );
     return true;
   }
+  virtual bool PushBatch( const value_T* values, int count ) const override
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      m_Array->Push( values[ i ] );
+    }
+    return true;
+  }
 private:
   MojoArray< value_T >* m_Array;
 };
@@ -277,6 +450,7 @@ void MojoArray< value_T >::Init()
   m_ActiveCount = 0;
   m_ChangeCount = 0;
   m_Status = kMojoStatus_NotInitialized;
+  m_Index = NULL;
 }
 
 template< typename value_T >
@@ -313,13 +487,19 @@ MojoStatus MojoArray< value_T >::Create( const char* name, const value_T& not_fo
       m_BufferCount           = fixed_array_count;
       // Note to self: fixed array is assumed to consist of constructed values. Don't call Construct() here.
     }
+    else if( AllocatesOnDemand() )
+    {
+      // Nothing is allocated until the first insert. Grow() takes care of that.
+      m_BufferCount           = 0;
+      m_Buffer                = NULL;
+    }
     else
     {
       m_BufferCount           = m_Config.m_BufferMinCount;
       m_Buffer                = AllocAndConstruct( m_BufferCount );
     }
     
-    m_Status = m_Buffer ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
+    m_Status = ( m_Buffer || AllocatesOnDemand() ) ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
   }
   return m_Status;
 }
@@ -339,6 +519,7 @@ MojoStatus MojoArray< value_T >::GetStatus() const
 template< typename value_T >
 void MojoArray< value_T >::Destroy()
 {
+  DestroyIndex();
   if( m_Alloc )
   {
     DestructAndFree( m_Buffer, m_BufferCount );
@@ -349,14 +530,26 @@ void MojoArray< value_T >::Destroy()
 template< typename value_T >
 MojoStatus MojoArray< value_T >::Clear()
 {
-  for( int i = 0; i < m_ActiveCount; ++i )
+  if( !MojoIsTriviallyCopyable< value_T >::value )
   {
-    int index = ( m_StartIndex + i ) % m_BufferCount;
-    m_Buffer[ index ] = value_T();
+    for( int i = 0; i < m_ActiveCount; ++i )
+    {
+      int index = ( m_StartIndex + i ) % m_BufferCount;
+      m_Buffer[ index ] = value_T();
+    }
   }
   m_StartIndex = 0;
   m_ActiveCount = 0;
   m_ChangeCount += 1;
+  if( m_Index )
+  {
+    m_Index->Clear();
+  }
+  if( AllocatesOnDemand() )
+  {
+    // Keep the buffer for reuse, up to m_BufferMinCount entries of it. Without a buffer, there is nothing to keep.
+    return m_BufferCount > m_Config.m_BufferMinCount ? Resize( m_Config.m_BufferMinCount ) : m_Status;
+  }
   return Resize( m_Config.m_BufferMinCount );
 }
 
@@ -378,7 +571,7 @@ MojoStatus MojoArray< value_T >::Insert( int index, const value_T& value )
       {
         // Mode the end portion.
         Move( index, index + 1, end_count, false );
-        int i = ( m_StartIndex + i ) % m_BufferCount;
+        int i = ( m_StartIndex + index ) % m_BufferCount;
         m_Buffer[ i ] = value;
       }
       else
@@ -386,11 +579,12 @@ MojoStatus MojoArray< value_T >::Insert( int index, const value_T& value )
         // Move the start
         Move( 0, -1, start_count, false );
         m_StartIndex = ( m_StartIndex - 1 + m_BufferCount ) % m_BufferCount;
-        int i = ( m_StartIndex + i ) % m_BufferCount;
+        int i = ( m_StartIndex + index ) % m_BufferCount;
         m_Buffer[ i ] = value;
       }
       m_ActiveCount += 1;
       m_ChangeCount += 1;
+      IndexInsert( value );
     }
   }
   return status;
@@ -418,7 +612,12 @@ void MojoArray< value_T >::Move( int from_index, int to_index, int count, bool c
   from_index += m_BufferCount;
   to_index += m_BufferCount;
 
-  if( to_index < from_index )
+  if( MojoIsTriviallyCopyable< value_T >::value )
+  {
+    // Vacated slots don't need clearing. They hold no resources, and are never read.
+    MoveBytes( from_index, to_index, count );
+  }
+  else if( to_index < from_index )
   {
     // Move down
     for( int i = 0; i < count; ++i )
@@ -456,6 +655,35 @@ void MojoArray< value_T >::Move( int from_index, int to_index, int count, bool c
   }
 }
 
+template< typename value_T >
+void MojoArray< value_T >::MoveBytes( int from_index, int to_index, int count )
+{
+  // Same order as the element by element loops in Move(), but in runs that don't cross the end of the buffer.
+  if( to_index < from_index )
+  {
+    for( int i = 0; i < count; )
+    {
+      int to = ( m_StartIndex + to_index + i ) % m_BufferCount;
+      int from = ( m_StartIndex + from_index + i ) % m_BufferCount;
+      int run = MojoMin( count - i, MojoMin( m_BufferCount - to, m_BufferCount - from ) );
+      memmove( ( void* )( m_Buffer + to ), ( const void* )( m_Buffer + from ), run * sizeof( value_T ) );
+      i += run;
+    }
+  }
+  else if( to_index > from_index )
+  {
+    for( int i = count; i > 0; )
+    {
+      int to = ( m_StartIndex + to_index + i - 1 ) % m_BufferCount;
+      int from = ( m_StartIndex + from_index + i - 1 ) % m_BufferCount;
+      int run = MojoMin( i, MojoMin( to + 1, from + 1 ) );
+      memmove( ( void* )( m_Buffer + to + 1 - run ), ( const void* )( m_Buffer + from + 1 - run ),
+              run * sizeof( value_T ) );
+      i -= run;
+    }
+  }
+}
+
 template< typename value_T >
 MojoStatus MojoArray< value_T >::RemoveRange( int index, int count )
 {
@@ -471,6 +699,13 @@ MojoStatus MojoArray< value_T >::RemoveRange( int index, int count )
   index = ( index + m_ActiveCount ) % m_ActiveCount;
   // count == INT_MAX means "to the end"
   count = MojoMin( count, m_ActiveCount - index );
+  if( m_Index )
+  {
+    for( int i = index; i < index + count; ++i )
+    {
+      m_Index->Remove( ValueAt( i ) );
+    }
+  }
 
   // Decide whether it is more efficient to move the start or the end of the array.
   int start_count = index;
@@ -506,6 +741,7 @@ MojoStatus MojoArray< value_T >::Push( const value_T& value )
       m_Buffer[ index ] = value;
       m_ActiveCount += 1;
       m_ChangeCount += 1;
+      IndexInsert( value );
     }
   }
   return status;
@@ -523,6 +759,7 @@ value_T MojoArray< value_T >::Pop()
   m_Buffer[ index ] = value_T();
   m_ActiveCount -= 1;
   m_ChangeCount += 1;
+  IndexRemove( value );
   Shrink();
   return value;
 }
@@ -541,6 +778,7 @@ MojoStatus MojoArray< value_T >::Unshift( const value_T& value )
       m_StartIndex = index;
       m_ActiveCount += 1;
       m_ChangeCount += 1;
+      IndexInsert( value );
     }
   }  
   return status;
@@ -559,6 +797,7 @@ value_T MojoArray< value_T >::Shift()
   m_StartIndex = ( m_StartIndex + 1 ) % m_BufferCount;
   m_ActiveCount -= 1;
   m_ChangeCount += 1;
+  IndexRemove( value );
   Shrink();
   return value;
 }
@@ -583,11 +822,31 @@ value_T MojoArray< value_T >::GetAt( int index ) const
   }
 }
 
+template< typename value_T >
+value_T MojoArray< value_T >::SwapAt( int index, const value_T& value )
+{
+  if( !m_Status && index < m_ActiveCount && index >= -m_ActiveCount )
+  {
+    index = ( index + m_ActiveCount ) % m_ActiveCount;
+    value_T& slot = m_Buffer[ ( index + m_StartIndex ) % m_BufferCount ];
+    value_T old_value = slot;
+    slot = value;
+    m_ChangeCount += 1;
+    IndexRemove( old_value );
+    IndexInsert( value );
+    return old_value;
+  }
+  else
+  {
+    return m_NotFoundValue;
+  }
+}
+
 template< typename value_T >
 value_T* MojoArray< value_T >::AllocAndConstruct( int new_buffer_count )
 {
   value_T* new_buffer = ( value_T* )m_Alloc->Allocate( new_buffer_count * sizeof( value_T ), m_Name );
-  if( new_buffer )
+  if( new_buffer && !MojoIsTriviallyCopyable< value_T >::value )
   {
     for( int i = 0; i < new_buffer_count; ++i )
     {
@@ -602,11 +861,17 @@ void MojoArray< value_T >::DestructAndFree( value_T* old_buffer, int old_buffer_
 {
   if( old_buffer )
   {
-    for( int i = 0; i < old_buffer_count; ++i )
+    if( !MojoIsTriviallyCopyable< value_T >::value )
+    {
+      for( int i = 0; i < old_buffer_count; ++i )
+      {
+        old_buffer[ i ].~value_T();
+      }
+    }
+    if( !m_Alloc->IsArena() )
     {
-      old_buffer[ i ].~value_T();
+      m_Alloc->Free( old_buffer );
     }
-    m_Alloc->Free( old_buffer );
   }
 }
 
@@ -623,6 +888,45 @@ MojoStatus MojoArray< value_T >::Resize( int new_capacity )
     return kMojoStatus_CouldNotAlloc;
   }
 
+  if( MojoIsTriviallyCopyable< value_T >::value && m_Buffer && new_capacity > m_BufferCount )
+  {
+    // Try to extend the buffer in place. Values stay where they are, except for values that wrapped around to the
+    // start of the old buffer. Those are moved to just past its old end.
+    value_T* new_buffer = ( value_T* )m_Alloc->Reallocate( m_Buffer, m_BufferCount * sizeof( value_T ),
+                                                           new_capacity * sizeof( value_T ), m_Name );
+    if( new_buffer )
+    {
+      int wrap_count = m_StartIndex + m_ActiveCount - m_BufferCount;
+      if( wrap_count > 0 )
+      {
+        memcpy( ( void* )( new_buffer + m_BufferCount ), ( const void* )new_buffer, wrap_count * sizeof( value_T ) );
+      }
+      m_Buffer = new_buffer;
+      m_BufferCount = new_capacity;
+      return kMojoStatus_Ok;
+    }
+  }
+
+  if( MojoIsTriviallyCopyable< value_T >::value && new_capacity < m_BufferCount &&
+     m_StartIndex + m_ActiveCount <= m_BufferCount )
+  {
+    // Try to shrink the buffer in place. Values that don't wrap around can first be moved to the start of the
+    // buffer, so they are in the part that is kept.
+    if( m_StartIndex + m_ActiveCount > new_capacity )
+    {
+      memmove( ( void* )m_Buffer, ( const void* )( m_Buffer + m_StartIndex ), m_ActiveCount * sizeof( value_T ) );
+      m_StartIndex = 0;
+    }
+    value_T* new_buffer = ( value_T* )m_Alloc->Reallocate( m_Buffer, m_BufferCount * sizeof( value_T ),
+                                                           new_capacity * sizeof( value_T ), m_Name );
+    if( new_buffer )
+    {
+      m_Buffer = new_buffer;
+      m_BufferCount = new_capacity;
+      return kMojoStatus_Ok;
+    }
+  }
+
   value_T* new_buffer = AllocAndConstruct( new_capacity );
 
   if( !new_buffer )
@@ -630,12 +934,26 @@ MojoStatus MojoArray< value_T >::Resize( int new_capacity )
     return kMojoStatus_CouldNotAlloc;
   }
 
-  // Copy used portion from old to new array
-  for( int i = 0; i < m_ActiveCount; ++i )
+  // Copy used portion from old to new array. An empty array may not have a buffer yet.
+  if( MojoIsTriviallyCopyable< value_T >::value && m_ActiveCount )
+  {
+    int first_count = MojoMin( m_ActiveCount, m_BufferCount - m_StartIndex );
+    memcpy( ( void* )new_buffer, ( const void* )( m_Buffer + m_StartIndex ), first_count * sizeof( value_T ) );
+    memcpy( ( void* )( new_buffer + first_count ), ( const void* )m_Buffer,
+           ( m_ActiveCount - first_count ) * sizeof( value_T ) );
+  }
+  else
   {
-    new_buffer[ i ] = GetAt( i );
+    for( int i = 0; i < m_ActiveCount; ++i )
+    {
+      new_buffer[ i ] = GetAt( i );
+    }
   }
 
+  if( m_Buffer )
+  {
+    m_Alloc->NotifyResize( m_Name );
+  }
   DestructAndFree( m_Buffer, m_BufferCount );
   m_Buffer = new_buffer;
   m_BufferCount = new_capacity;
@@ -649,7 +967,7 @@ MojoStatus MojoArray< value_T >::Grow( int count )
 {
   if( GetCount() + count > m_BufferCount )
   {
-    int new_buffer_count = m_BufferCount * 2;
+    int new_buffer_count = m_BufferCount ? m_BufferCount * 2 : kMojoBufferInitialCount;
     while( GetCount() + count > new_buffer_count )
     {
       new_buffer_count *= 2;
@@ -673,11 +991,25 @@ MojoStatus MojoArray< value_T >::Shrink()
 }
 
 template< typename value_T >
-bool MojoArray< value_T >::Contains( const value_T& value ) const
+bool MojoArray< value_T >::Scan( const value_T* values, int count, const value_T& value )
 {
-  for( int i = 0; i < m_ActiveCount; ++i )
+  // Compare in blocks of 8 with no early exit inside a block, so the compiler is free to vectorize the block.
+  int i = 0;
+  for( ; i + 8 <= count; i += 8 )
+  {
+    bool found = false;
+    for( int j = 0; j < 8; ++j )
+    {
+      found |= ( values[ i + j ] == value );
+    }
+    if( found )
+    {
+      return true;
+    }
+  }
+  for( ; i < count; ++i )
   {
-    if( GetAt( i ) == value )
+    if( values[ i ] == value )
     {
       return true;
     }
@@ -685,30 +1017,432 @@ bool MojoArray< value_T >::Contains( const value_T& value ) const
   return false;
 }
 
+template< typename value_T >
+bool MojoArray< value_T >::Contains( const value_T& value ) const
+{
+  if( m_Status )
+  {
+    return false;
+  }
+  if( m_Index )
+  {
+    return m_Index->Contains( value );
+  }
+  MojoSpan< const value_T > first;
+  MojoSpan< const value_T > second;
+  GetSpans( &first, &second );
+  return Scan( first.m_Values, first.m_Count, value ) || Scan( second.m_Values, second.m_Count, value );
+}
+
+template< typename value_T >
+void MojoArray< value_T >::ContainsBatch( const value_T* values, int count, uint64_t* mask ) const
+{
+  if( m_Index && !m_Status )
+  {
+    m_Index->ContainsBatch( values, count, mask );
+    return;
+  }
+  for( int i = 0; i < count; ++i )
+  {
+    if( MojoMaskTest( mask, i ) && !MojoArray::Contains( values[ i ] ) )
+    {
+      MojoMaskClear( mask, i );
+    }
+  }
+}
+
+template< typename value_T >
+void MojoArray< value_T >::GetSpans( MojoSpan< const value_T >* first, MojoSpan< const value_T >* second ) const
+{
+  // From the start index up to the end of the buffer, and from the beginning of the buffer onward.
+  int first_count = m_ActiveCount ? MojoMin( m_ActiveCount, m_BufferCount - m_StartIndex ) : 0;
+  first->m_Values = m_Buffer ? m_Buffer + m_StartIndex : NULL;
+  first->m_Count = first_count;
+  second->m_Values = m_Buffer;
+  second->m_Count = m_ActiveCount - first_count;
+}
+
+template< typename value_T >
+MojoStatus MojoArray< value_T >::Linearize()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( m_StartIndex + m_ActiveCount > m_BufferCount )
+  {
+    // Rotate the whole buffer left by the start index: reverse both parts, then reverse the whole.
+    Reverse( 0, m_StartIndex );
+    Reverse( m_StartIndex, m_BufferCount );
+    Reverse( 0, m_BufferCount );
+    m_StartIndex = 0;
+  }
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+void MojoArray< value_T >::Reverse( int begin, int end )
+{
+  for( int low = begin, high = end - 1; low < high; ++low, --high )
+  {
+    value_T value = m_Buffer[ low ];
+    m_Buffer[ low ] = m_Buffer[ high ];
+    m_Buffer[ high ] = value;
+  }
+}
+
+template< typename value_T >
+MojoStatus MojoArray< value_T >::CreateIndex()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( m_Index )
+  {
+    return kMojoStatus_DoubleInitialized;
+  }
+  if( !m_Alloc || !m_Config.m_DynamicAlloc )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  void* memory = m_Alloc->Allocate( sizeof( HashIndex ), m_Name );
+  if( !memory )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  HashIndex* index = new( memory ) HashIndex( m_Name, &m_Config, m_Alloc );
+  m_Index = index;
+  for( int i = 0; i < m_ActiveCount; ++i )
+  {
+    m_Index->Insert( ValueAt( i ) );
+  }
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+void MojoArray< value_T >::DestroyIndex()
+{
+  if( m_Index )
+  {
+    m_Index->~Index();
+    if( !m_Alloc->IsArena() )
+    {
+      m_Alloc->Free( m_Index );
+    }
+    m_Index = NULL;
+  }
+}
+
+template< typename value_T >
+void MojoArray< value_T >::IndexInsert( const value_T& value )
+{
+  if( m_Index )
+  {
+    m_Index->Insert( value );
+  }
+}
+
+template< typename value_T >
+void MojoArray< value_T >::IndexRemove( const value_T& value )
+{
+  if( m_Index )
+  {
+    m_Index->Remove( value );
+  }
+}
+
 template< typename value_T >
 bool MojoArray< value_T >::Enumerate( const MojoCollector< value_T >& collector,
                                      const MojoAbstractSet< value_T >* limit ) const
 {
-  bool more = true;
-  if( limit )
+  if( m_Status )
   {
-    for( int i = 0; more && i < m_ActiveCount; ++i )
+    return true;
+  }
+  MojoSpan< const value_T > first;
+  MojoSpan< const value_T > second;
+  GetSpans( &first, &second );
+  MojoEnumerationBatch< value_T > batch( collector, limit );
+  return batch.AddRange( first.m_Values, first.m_Count ) && batch.AddRange( second.m_Values, second.m_Count )
+      && batch.Flush();
+}
+
+template< typename value_T >
+MojoStatus MojoArray< value_T >::Sort()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( m_ActiveCount < 2 )
+  {
+    return kMojoStatus_Ok;
+  }
+  if( !m_Config.m_DynamicAlloc )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+
+  SortEntry* entries = ( SortEntry* )m_Alloc->Allocate( 2 * m_ActiveCount * sizeof( SortEntry ), m_Name );
+  if( !entries )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+
+  RadixContext context;
+  context.m_Array = this;
+  context.m_Source = entries;
+  context.m_Target = entries + m_ActiveCount;
+  context.m_Count = m_ActiveCount;
+  context.m_JobCount = MojoMax( 1, MojoMin( kMojoJobMax, m_ActiveCount / kMojoJobMinCount ) );
+  context.m_Shift = 0;
+  RunJobs( RadixFill, &context );
+
+  // One pass per byte of the hash, least significant first.
+  for( int shift = 0; shift < 64; shift += 8 )
+  {
+    context.m_Shift = shift;
+    RunJobs( RadixCount, &context );
+
+    // Turn the counts into the offset at which each job writes each digit. If all entries have the same digit, the
+    // pass would not change anything.
+    bool skip = false;
+    int offset = 0;
+    for( int digit = 0; digit < 256; ++digit )
     {
-      value_T value = GetAt( i );
-      if( limit->Contains( value ) )
+      int digit_count = 0;
+      for( int job = 0; job < context.m_JobCount; ++job )
       {
-        more = collector.Push( value );
+        int count = context.m_Offsets[ job ][ digit ];
+        context.m_Offsets[ job ][ digit ] = offset;
+        offset += count;
+        digit_count += count;
       }
+      skip = skip || digit_count == m_ActiveCount;
+    }
+
+    if( !skip )
+    {
+      RunJobs( RadixScatter, &context );
+      SortEntry* swap = context.m_Source;
+      context.m_Source = context.m_Target;
+      context.m_Target = swap;
     }
   }
-  else
+
+  MojoStatus status = Permute( context.m_Source );
+  m_Alloc->Free( entries );
+  return status;
+}
+
+template< typename value_T >
+MojoStatus MojoArray< value_T >::SortUnique()
+{
+  MojoStatus status = Sort();
+  if( status )
   {
-    for( int i = 0; more && i < m_ActiveCount; ++i )
+    return status;
+  }
+
+  // Equal values are now adjacent, but different values with the same hash may be interleaved. So compare each
+  // value with all values kept so far that have the same hash.
+  int kept_count = 0;
+  int run_start = 0;
+  for( int i = 0; i < m_ActiveCount; ++i )
+  {
+    const value_T& value = ValueAt( i );
+    bool duplicate = false;
+    if( kept_count > 0 && ValueAt( kept_count - 1 ).GetHash() == value.GetHash() )
+    {
+      for( int j = run_start; !duplicate && j < kept_count; ++j )
+      {
+        duplicate = ValueAt( j ) == value;
+      }
+    }
+    else
     {
-      more = collector.Push( GetAt( i ) );
+      run_start = kept_count;
     }
+    if( !duplicate )
+    {
+      if( kept_count != i )
+      {
+        ValueAt( kept_count ) = value;
+      }
+      kept_count += 1;
+    }
+  }
+  if( kept_count < m_ActiveCount )
+  {
+    return RemoveRange( kept_count );
+  }
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+template< typename less_T >
+MojoStatus MojoArray< value_T >::SortBy( const less_T& less )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( m_ActiveCount < 2 )
+  {
+    return kMojoStatus_Ok;
+  }
+  if( !m_Config.m_DynamicAlloc )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+
+  int count = m_ActiveCount;
+  value_T* source = AllocAndConstruct( count );
+  value_T* target = AllocAndConstruct( count );
+  if( !source || !target )
+  {
+    DestructAndFree( source, count );
+    DestructAndFree( target, count );
+    return kMojoStatus_CouldNotAlloc;
+  }
+
+  for( int i = 0; i < count; ++i )
+  {
+    source[ i ] = ValueAt( i );
+  }
+
+  // Bottom-up merge sort. Each pass merges pairs of sorted runs from source into target.
+  for( int width = 1; width < count; width *= 2 )
+  {
+    for( int start = 0; start < count; start += 2 * width )
+    {
+      int middle = MojoMin( start + width, count );
+      int end = MojoMin( start + 2 * width, count );
+      int left = start;
+      int right = middle;
+      int out = start;
+      while( left < middle && right < end )
+      {
+        // Take from the right only if strictly less. This keeps the sort stable.
+        if( less( source[ right ], source[ left ] ) )
+        {
+          target[ out++ ] = source[ right++ ];
+        }
+        else
+        {
+          target[ out++ ] = source[ left++ ];
+        }
+      }
+      while( left < middle )
+      {
+        target[ out++ ] = source[ left++ ];
+      }
+      while( right < end )
+      {
+        target[ out++ ] = source[ right++ ];
+      }
+    }
+    value_T* swap = source;
+    source = target;
+    target = swap;
+  }
+
+  for( int i = 0; i < count; ++i )
+  {
+    ValueAt( i ) = source[ i ];
+  }
+  DestructAndFree( source, count );
+  DestructAndFree( target, count );
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+MojoStatus MojoArray< value_T >::ToSet( MojoSet< value_T >* set ) const
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  return set->FromArray( this );
+}
+
+template< typename value_T >
+MojoStatus MojoArray< value_T >::Permute( const SortEntry* entries )
+{
+  // Values are copied serially: copying may touch shared state, such as the reference counts of MojoId.
+  value_T* new_buffer = AllocAndConstruct( m_BufferCount );
+  if( !new_buffer )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  for( int i = 0; i < m_ActiveCount; ++i )
+  {
+    new_buffer[ i ] = ValueAt( entries[ i ].m_Index );
+  }
+  DestructAndFree( m_Buffer, m_BufferCount );
+  m_Buffer = new_buffer;
+  m_StartIndex = 0;
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+void MojoArray< value_T >::RunJobs( void ( *function )( void* context, int index ), RadixContext* context )
+{
+  if( context->m_JobCount > 1 )
+  {
+    MojoJobs::GetDefault()->Run( function, context, context->m_JobCount );
+  }
+  else
+  {
+    function( context, 0 );
+  }
+}
+
+template< typename value_T >
+void MojoArray< value_T >::RadixFill( void* context, int job )
+{
+  RadixContext* radix = ( RadixContext* )context;
+  int begin = ( int )( ( int64_t )radix->m_Count * job / radix->m_JobCount );
+  int end = ( int )( ( int64_t )radix->m_Count * ( job + 1 ) / radix->m_JobCount );
+  for( int i = begin; i < end; ++i )
+  {
+    radix->m_Source[ i ].m_Hash = radix->m_Array->ValueAt( i ).GetHash();
+    radix->m_Source[ i ].m_Index = i;
+  }
+}
+
+template< typename value_T >
+void MojoArray< value_T >::RadixCount( void* context, int job )
+{
+  RadixContext* radix = ( RadixContext* )context;
+  int begin = ( int )( ( int64_t )radix->m_Count * job / radix->m_JobCount );
+  int end = ( int )( ( int64_t )radix->m_Count * ( job + 1 ) / radix->m_JobCount );
+  int* counts = radix->m_Offsets[ job ];
+  for( int digit = 0; digit < 256; ++digit )
+  {
+    counts[ digit ] = 0;
+  }
+  for( int i = begin; i < end; ++i )
+  {
+    counts[ ( radix->m_Source[ i ].m_Hash >> radix->m_Shift ) & 0xFF ] += 1;
+  }
+}
+
+template< typename value_T >
+void MojoArray< value_T >::RadixScatter( void* context, int job )
+{
+  RadixContext* radix = ( RadixContext* )context;
+  int begin = ( int )( ( int64_t )radix->m_Count * job / radix->m_JobCount );
+  int end = ( int )( ( int64_t )radix->m_Count * ( job + 1 ) / radix->m_JobCount );
+  int* offsets = radix->m_Offsets[ job ];
+  for( int i = begin; i < end; ++i )
+  {
+    const SortEntry& entry = radix->m_Source[ i ];
+    radix->m_Target[ offsets[ ( entry.m_Hash >> radix->m_Shift ) & 0xFF ]++ ] = entry;
   }
-  return more;
 }
 
 template< typename value_T >
@@ -0,0 +1,613 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoUtil.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+
+/**
+ \class MojoBitSet
+ \ingroup group_container
+ A set of dense integer-like keys, stored as one bit per key. Contains() is a single bit test, and intersections,
+ unions and differences of bitsets are computed 64 keys at a time. MojoIntersection, MojoUnion and MojoDifference
+ take that path when enumerating, if all their inputs are bitsets.
+
+ Memory use is proportional to the largest key, not to the number of keys, so use this for ordinals and small
+ ranges only. Use MojoSet for sparse keys.
+ Also implements the MojoAbstractSet interface.
+ \see MojoForEachKey
+ \tparam key_T Key type. Must convert to and from int, like MojoHashable< int >. Keys must be positive:
+ 0 is the Null key, and is rejected by Insert().
+ */
+template< typename key_T >
+class MojoBitSet final : public MojoAbstractSet< key_T >
+{
+public:
+
+  /**
+   Default constructor. You must call Create() before the set is ready for use.
+   */
+  MojoBitSet()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the set. Will also be used for internal memory allocation.
+   \param[in] ordinal_count Make room for keys below this value up front. The set grows as needed on Insert().
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoBitSet( const char* name, int ordinal_count = 0, MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, ordinal_count, alloc );
+  }
+
+  /**
+   Create after default constructor or Destroy().
+   \param[in] name The name of the set. Will also be used for internal memory allocation.
+   \param[in] ordinal_count Make room for keys below this value up front. The set grows as needed on Insert().
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, int ordinal_count = 0, MojoAlloc* alloc = NULL );
+
+  /**
+   Remove all keys and free all allocated buffers.
+   */
+  void Destroy();
+
+  /**
+   Remove all keys. Memory is kept.
+   */
+  MojoStatus Clear();
+
+  /**
+   Insert key into set. If key already exists in set, does nothing.
+   \param[in] key Key to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( const key_T& key );
+
+  /**
+   Remove key from the set.
+   \param[in] key Key to remove.
+   \return Status code. kMojoStatus_NotFound if the key was not in the set.
+   */
+  MojoStatus Remove( const key_T& key );
+
+  /**
+   Test presence of a key.
+   */
+  virtual bool Contains( const key_T& key ) const override;
+
+  /**
+   Test presence of a block of keys, one bit test each. See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
+
+  /**
+   Keep only the keys that are also in other. Computed a word at a time.
+   \param[in] other Set to intersect with.
+   \return Status code.
+   */
+  MojoStatus And( const MojoBitSet& other );
+
+  /**
+   Add all keys that are in other. Computed a word at a time.
+   \param[in] other Set to unite with.
+   \return Status code.
+   */
+  MojoStatus Or( const MojoBitSet& other );
+
+  /**
+   Remove all keys that are in other. Computed a word at a time.
+   \param[in] other Set to subtract.
+   \return Status code.
+   */
+  MojoStatus AndNot( const MojoBitSet& other );
+
+  /**
+   Return set status state. This is the only way to find out if something went wrong in the default constructor.
+   If Create() was used, the returned status code will be the same.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  /**
+   Get number of keys in the set.
+   */
+  int GetCount() const { return m_ActiveCount; }
+
+  /**
+   Return name of the set.
+   */
+  const char* GetName() const { return m_Name; }
+
+  /**
+   Get index of first key. This is used for the ForEach... macros. It must be declared public to work with the
+   macros, but should be considered private.
+   \private
+   */
+  int _GetFirstIndex() const { return _GetNextIndex( -1 ); }
+
+  /**
+   Get index of next key. This is used for the ForEach... macros. It must be declared public to work with the
+   macros, but should be considered private.
+   \private
+   */
+  int _GetNextIndex( int index ) const;
+
+  /**
+   Verify that index is in range. This is used for the ForEach... macros. It must be declared public to work with
+   the macros, but should be considered private.
+   \private
+   */
+  bool _IsIndexValid( int index ) const { return index >= 0 && index < m_WordCount * 64; }
+
+  /**
+   Get key at a specific index. This is used for the ForEach... macros. It must be declared public to work with the
+   macros, but should be considered private.
+   \private
+   */
+  key_T _GetKeyAt( int index ) const { return key_T( index ); }
+
+  virtual bool Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override { return m_ActiveCount; }
+  /** \private */
+  virtual int _GetChangeCount() const override { return m_ChangeCount; }
+  /** \private */
+  virtual bool _GetWords( const uint64_t** words, int* word_count ) const override;
+  /** \private */
+  virtual bool _EnumerateWords( const uint64_t* words, int word_count, int first_word,
+                                const MojoCollector< key_T >& collector,
+                                const MojoAbstractSet< key_T >* limit ) const override;
+
+  /**
+   Destructor.
+   */
+  ~MojoBitSet();
+
+private:
+  const char*         m_Name;
+  MojoAlloc*          m_Alloc;
+  uint64_t*           m_Words;
+  int                 m_WordCount;
+  int                 m_ActiveCount;
+  int                 m_ChangeCount;
+  MojoStatus          m_Status;
+
+  void Init();
+  MojoStatus Reserve( int word_count );
+  void UpdateCount();
+  static int64_t GetOrdinal( const key_T& key ) { return ( int64_t )key; }
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+void MojoBitSet< key_T >::Init()
+{
+  m_Name = NULL;
+  m_Alloc = NULL;
+  m_Words = NULL;
+  m_WordCount = 0;
+  m_ActiveCount = 0;
+  m_ChangeCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::Create( const char* name, int ordinal_count, MojoAlloc* alloc )
+{
+  if( !alloc )
+  {
+    alloc = MojoAlloc::GetDefault();
+  }
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else if( ordinal_count < 0 )
+  {
+    m_Status = kMojoStatus_InvalidArguments;
+  }
+  else
+  {
+    m_Name = name;
+    m_Alloc = alloc;
+    m_Status = kMojoStatus_Ok;
+    m_Status = Reserve( MojoMaskWordCount( ordinal_count ) );
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoBitSet< key_T >::~MojoBitSet()
+{
+  Destroy();
+}
+
+template< typename key_T >
+void MojoBitSet< key_T >::Destroy()
+{
+  if( m_Alloc && m_Words )
+  {
+    m_Alloc->FreeAligned( m_Words );
+  }
+  Init();
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::Clear()
+{
+  if( !m_Status )
+  {
+    for( int i = 0; i < m_WordCount; ++i )
+    {
+      m_Words[ i ] = 0;
+    }
+    m_ActiveCount = 0;
+    m_ChangeCount += 1;
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::Reserve( int word_count )
+{
+  if( word_count <= m_WordCount )
+  {
+    return kMojoStatus_Ok;
+  }
+  // Grow by at least half, so inserting ascending keys does not reallocate every 64 keys.
+  word_count = word_count > m_WordCount + m_WordCount / 2 ? word_count : m_WordCount + m_WordCount / 2;
+  uint64_t* words = ( uint64_t* )m_Alloc->AllocateAligned( word_count * sizeof( uint64_t ), kMojoCacheLineSize,
+                                                           m_Name );
+  if( !words )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  if( m_Words )
+  {
+    memcpy( words, m_Words, m_WordCount * sizeof( uint64_t ) );
+    m_Alloc->FreeAligned( m_Words );
+    m_Alloc->NotifyResize( m_Name );
+  }
+  memset( words + m_WordCount, 0, ( word_count - m_WordCount ) * sizeof( uint64_t ) );
+  m_Words = words;
+  m_WordCount = word_count;
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::Insert( const key_T& key )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    int64_t ordinal = GetOrdinal( key );
+    if( ordinal <= 0 || ordinal >= INT_MAX - 63 )
+    {
+      status = kMojoStatus_InvalidArguments;
+    }
+    else
+    {
+      status = Reserve( ( int )( ordinal >> 6 ) + 1 );
+      if( !status )
+      {
+        uint64_t bit = ( uint64_t )1 << ( ordinal & 63 );
+        uint64_t& word = m_Words[ ordinal >> 6 ];
+        if( !( word & bit ) )
+        {
+          word |= bit;
+          m_ActiveCount += 1;
+          m_ChangeCount += 1;
+        }
+      }
+    }
+  }
+  return status;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::Remove( const key_T& key )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( !Contains( key ) )
+  {
+    return kMojoStatus_NotFound;
+  }
+  int64_t ordinal = GetOrdinal( key );
+  m_Words[ ordinal >> 6 ] &= ~( ( uint64_t )1 << ( ordinal & 63 ) );
+  m_ActiveCount -= 1;
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T >
+bool MojoBitSet< key_T >::Contains( const key_T& key ) const
+{
+  int64_t ordinal = GetOrdinal( key );
+  return ordinal > 0 && ordinal < ( int64_t )m_WordCount * 64 &&
+         ( ( m_Words[ ordinal >> 6 ] >> ( ordinal & 63 ) ) & 1 ) != 0;
+}
+
+template< typename key_T >
+void MojoBitSet< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  for( int i = 0; i < count; ++i )
+  {
+    if( MojoMaskTest( mask, i ) && !MojoBitSet::Contains( keys[ i ] ) )
+    {
+      MojoMaskClear( mask, i );
+    }
+  }
+}
+
+template< typename key_T >
+void MojoBitSet< key_T >::UpdateCount()
+{
+  int count = 0;
+  for( int i = 0; i < m_WordCount; ++i )
+  {
+    count += MojoPopCount( m_Words[ i ] );
+  }
+  m_ActiveCount = count;
+  m_ChangeCount += 1;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::And( const MojoBitSet& other )
+{
+  if( !m_Status )
+  {
+    int common_count = MojoMin( m_WordCount, other.m_WordCount );
+    uint64_t* words = m_Words;
+    const uint64_t* other_words = other.m_Words;
+    for( int i = 0; i < common_count; ++i )
+    {
+      words[ i ] &= other_words[ i ];
+    }
+    for( int i = common_count; i < m_WordCount; ++i )
+    {
+      words[ i ] = 0;
+    }
+    UpdateCount();
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::Or( const MojoBitSet& other )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    status = Reserve( other.m_WordCount );
+    if( !status )
+    {
+      uint64_t* words = m_Words;
+      const uint64_t* other_words = other.m_Words;
+      for( int i = 0; i < other.m_WordCount; ++i )
+      {
+        words[ i ] |= other_words[ i ];
+      }
+      UpdateCount();
+    }
+  }
+  return status;
+}
+
+template< typename key_T >
+MojoStatus MojoBitSet< key_T >::AndNot( const MojoBitSet& other )
+{
+  if( !m_Status )
+  {
+    int common_count = MojoMin( m_WordCount, other.m_WordCount );
+    uint64_t* words = m_Words;
+    const uint64_t* other_words = other.m_Words;
+    for( int i = 0; i < common_count; ++i )
+    {
+      words[ i ] &= ~other_words[ i ];
+    }
+    UpdateCount();
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+int MojoBitSet< key_T >::_GetNextIndex( int index ) const
+{
+  index += 1;
+  int word_index = index >> 6;
+  if( word_index >= m_WordCount )
+  {
+    return -1;
+  }
+  uint64_t word = m_Words[ word_index ] & ( ~( uint64_t )0 << ( index & 63 ) );
+  while( !word )
+  {
+    if( ++word_index >= m_WordCount )
+    {
+      return -1;
+    }
+    word = m_Words[ word_index ];
+  }
+  return word_index * 64 + MojoCountTrailingZeros( word );
+}
+
+template< typename key_T >
+bool MojoBitSet< key_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                    const MojoAbstractSet< key_T >* limit ) const
+{
+  return _EnumerateWords( m_Words, m_WordCount, 0, collector, limit );
+}
+
+template< typename key_T >
+bool MojoBitSet< key_T >::_GetWords( const uint64_t** words, int* word_count ) const
+{
+  if( m_Status )
+  {
+    return false;
+  }
+  *words = m_Words;
+  *word_count = m_WordCount;
+  return true;
+}
+
+template< typename key_T >
+bool MojoBitSet< key_T >::_EnumerateWords( const uint64_t* words, int word_count, int first_word,
+                                          const MojoCollector< key_T >& collector,
+                                          const MojoAbstractSet< key_T >* limit ) const
+{
+  MojoEnumerationBatch< key_T > batch( collector, limit );
+  for( int i = 0; i < word_count; ++i )
+  {
+    uint64_t word = words[ i ];
+    int base = ( first_word + i ) * 64;
+    while( word )
+    {
+      if( !batch.Add( key_T( base + MojoCountTrailingZeros( word ) ) ) )
+      {
+        return false;
+      }
+      word &= word - 1;
+    }
+  }
+  return batch.Flush();
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+/**
+ Enumerate the intersection, union or difference of sets that all return words from _GetWords(). The words are
+ combined a block at a time, without touching individual keys, and the first set turns the bits back into keys.
+ Used by MojoIntersection, MojoUnion and MojoDifference.
+ \param[in] kind kMojoSetKind_Intersection, kMojoSetKind_Union or kMojoSetKind_Difference.
+ \param[in] sets Input sets.
+ \param[in] set_count Number of input sets.
+ \param[in] collector Receives the keys.
+ \param[in] limit Limit set, or NULL.
+ \param[out] more Return value of Enumerate().
+ \return False if any input is not a bitmap, in which case nothing was enumerated.
+ \private
+ */
+template< typename key_T >
+bool MojoEnumerateWords( MojoSetKind kind, const MojoAbstractSet< key_T >* const* sets, int set_count,
+                         const MojoCollector< key_T >& collector, const MojoAbstractSet< key_T >* limit,
+                         bool* more )
+{
+  if( !set_count )
+  {
+    return false;
+  }
+  const uint64_t* words[ kMojoInputSetMax ];
+  int word_counts[ kMojoInputSetMax ] = {};
+  for( int i = 0; i < set_count; ++i )
+  {
+    if( !sets[ i ]->_GetWords( &words[ i ], &word_counts[ i ] ) )
+    {
+      return false;
+    }
+  }
+  int total_count = word_counts[ 0 ];
+  for( int i = 1; i < set_count; ++i )
+  {
+    if( kind == kMojoSetKind_Intersection )
+    {
+      total_count = MojoMin( total_count, word_counts[ i ] );
+    }
+    else if( kind == kMojoSetKind_Union && word_counts[ i ] > total_count )
+    {
+      total_count = word_counts[ i ];
+    }
+  }
+
+  uint64_t block[ kMojoBatchSize ];
+  *more = true;
+  for( int first = 0; *more && first < total_count; first += kMojoBatchSize )
+  {
+    int count = MojoMin( total_count - first, kMojoBatchSize );
+    int own_count = MojoMin( word_counts[ 0 ] - first, count );
+    for( int w = 0; w < count; ++w )
+    {
+      block[ w ] = w < own_count ? words[ 0 ][ first + w ] : 0;
+    }
+    for( int i = 1; i < set_count; ++i )
+    {
+      const uint64_t* input = words[ i ] + first;
+      int input_count = MojoMin( word_counts[ i ] - first, count );
+      if( kind == kMojoSetKind_Intersection )
+      {
+        for( int w = 0; w < count; ++w )
+        {
+          block[ w ] &= input[ w ];
+        }
+      }
+      else if( kind == kMojoSetKind_Union )
+      {
+        for( int w = 0; w < input_count; ++w )
+        {
+          block[ w ] |= input[ w ];
+        }
+      }
+      else
+      {
+        for( int w = 0; w < input_count; ++w )
+        {
+          block[ w ] &= ~input[ w ];
+        }
+      }
+    }
+    *more = sets[ 0 ]->_EnumerateWords( block, count, first, collector, limit );
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
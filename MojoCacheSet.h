@@ -28,8 +28,10 @@
 
 #pragma once
 
+#include "MojoConstants.h"
 #include "MojoAbstractSet.h"
 #include "MojoSet.h"
+#include "MojoArray.h"
 #include "MojoStatus.h"
 
 class MojoAlloc;
@@ -50,6 +52,11 @@ struct MojoConfig;
  concern, MojoCacheSet can help. A cache set is initialized with a pointer to a set to be cached. When \ref
  MojoCacheSet::Update() is called, it will enumerate the input set into its internal set. This internal set is
  used when the MojoCacheSet is accessed through Contains() and Enumerate().
+
+ If every leaf of the input expression keeps a change log (see MojoConfig::m_ChangeLogCount), Update() does not
+ rebuild. A key can only enter or leave the expression if it was inserted into or removed from a leaf, so Update()
+ collects those keys from the logs, and tests just those against the input set. It falls back to a full rebuild
+ if a log has overflowed, or if there are more changed keys than the input set has to enumerate.
  */
 template< typename key_T >
 class MojoCacheSet final : public MojoAbstractSet< key_T >
@@ -57,7 +64,9 @@ class MojoCacheSet final : public MojoAbstractSet< key_T >
 public:
 
   MojoCacheSet()
-  {}
+  {
+    Init();
+  }
 
   /**
    Initializing constructor. No need to call Create().
@@ -107,6 +116,12 @@ public:
    */
   void Update();
 
+  /**
+   Get number of times Update() rebuilt the internal set from scratch, rather than applying the changes from the
+   change logs of the input expression.
+   */
+  int GetRebuildCount() const { return m_RebuildCount; }
+
   /**
    Access to internal MojoSet.
    \private
@@ -136,8 +151,19 @@ private:
   const MojoAbstractSet< key_T >* m_SetToCache;
   MojoSet< key_T >                m_CachedSet;
   int                             m_ChangeCount;
+  bool                            m_IsBuilt;
+  int                             m_RebuildCount;
+  // Leaves of the input expression, and their change log positions as of the last update. -1 if not all leaves
+  // keep a change log.
+  int                             m_LeafCount;
+  const MojoAbstractSet< key_T >* m_Leaves[ kMojoCacheLeafMax ];
+  uint64_t                        m_LogPositions[ kMojoCacheLeafMax ];
+  MojoArray< key_T >              m_ChangedKeys;
 
   void                            Init();
+  void                            Rebuild();
+  bool                            ApplyChanges();
+  bool                            AddLeaves( const MojoAbstractSet< key_T >* set );
 };
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -150,6 +176,11 @@ MojoStatus MojoCacheSet< key_T >::Create( const char* name, MojoAbstractSet< key
 {
   m_Name = name;
   m_SetToCache = set_to_cache;
+  if( !fixed_array_count )
+  {
+    // A cache that must not allocate never collects changes, and always rebuilds.
+    m_ChangedKeys.Create( name, key_T(), config, alloc );
+  }
   return m_CachedSet.Create( name, config, alloc, fixed_array, fixed_array_count );
 }
 
@@ -182,12 +213,109 @@ template< typename key_T >
 void MojoCacheSet< key_T >::Update()
 {
   int change_count = m_SetToCache->_GetChangeCount();
-  if( m_ChangeCount != change_count )
+  if( !m_IsBuilt || m_ChangeCount != change_count )
   {
     m_ChangeCount = change_count;
-    m_CachedSet.Clear();
-    m_SetToCache->Enumerate( MojoSetCollector< key_T >( &m_CachedSet ) );
+    if( !m_IsBuilt || !ApplyChanges() )
+    {
+      Rebuild();
+    }
+  }
+}
+
+template< typename key_T >
+void MojoCacheSet< key_T >::Rebuild()
+{
+  m_IsBuilt = true;
+  m_RebuildCount += 1;
+  m_CachedSet.Clear();
+  m_SetToCache->Enumerate( MojoSetCollector< key_T >( &m_CachedSet ) );
+
+  m_LeafCount = 0;
+  if( m_ChangedKeys.GetStatus() || !AddLeaves( m_SetToCache ) )
+  {
+    m_LeafCount = -1;
+  }
+  for( int i = 0; i < m_LeafCount; ++i )
+  {
+    m_Leaves[ i ]->_GetChangeLogPosition( &m_LogPositions[ i ] );
+  }
+}
+
+template< typename key_T >
+bool MojoCacheSet< key_T >::AddLeaves( const MojoAbstractSet< key_T >* set )
+{
+  if( set->_GetKind() != kMojoSetKind_Leaf )
+  {
+    for( int i = 0; i < set->_GetInputCount(); ++i )
+    {
+      if( !AddLeaves( set->_GetInput( i ) ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  uint64_t position;
+  if( !set->_GetChangeLogPosition( &position ) )
+  {
+    return false;
+  }
+  for( int i = 0; i < m_LeafCount; ++i )
+  {
+    if( m_Leaves[ i ] == set )
+    {
+      return true;
+    }
+  }
+  if( m_LeafCount == kMojoCacheLeafMax )
+  {
+    return false;
+  }
+  m_Leaves[ m_LeafCount++ ] = set;
+  return true;
+}
+
+template< typename key_T >
+bool MojoCacheSet< key_T >::ApplyChanges()
+{
+  if( m_LeafCount < 0 )
+  {
+    return false;
+  }
+  m_ChangedKeys.Clear();
+  MojoArrayCollector< key_T > collector( &m_ChangedKeys );
+  for( int i = 0; i < m_LeafCount; ++i )
+  {
+    if( !m_Leaves[ i ]->_GetChangesSince( m_LogPositions[ i ], collector ) )
+    {
+      return false;
+    }
+  }
+  if( m_ChangedKeys.GetCount() > m_SetToCache->_GetEnumerationCost() )
+  {
+    return false;
+  }
+
+  // Test each changed key against the whole expression. For an intersection, say, that probes the other inputs.
+  for( int i = 0; i < m_ChangedKeys.GetCount(); ++i )
+  {
+    key_T key = m_ChangedKeys[ i ];
+    if( m_SetToCache->Contains( key ) )
+    {
+      m_CachedSet.Insert( key );
+    }
+    else
+    {
+      m_CachedSet.Remove( key );
+    }
+  }
+  m_ChangedKeys.Clear();
+  for( int i = 0; i < m_LeafCount; ++i )
+  {
+    m_Leaves[ i ]->_GetChangeLogPosition( &m_LogPositions[ i ] );
   }
+  return true;
 }
 
 template< typename key_T >
@@ -217,6 +345,12 @@ key_T MojoCacheSet< key_T >::_GetKeyAt( int index ) const
 template< typename key_T >
 void MojoCacheSet< key_T >::Init()
 {
+  m_Name = NULL;
+  m_SetToCache = NULL;
+  m_ChangeCount = 0;
+  m_IsBuilt = false;
+  m_RebuildCount = 0;
+  m_LeafCount = -1;
 }
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -56,6 +56,24 @@ public:
    \return Normally true. Return false to abort collection.
    */
   virtual bool Push( const value_T& value ) const = 0;
+  /**
+   Add a block of elements to container. Enumerate() calls this with up to kMojoBatchSize elements at a time. The
+   default calls Push() for each element. Override to avoid a virtual call per element.
+   \param[in] values The elements to be added.
+   \param[in] count Number of elements.
+   \return Normally true. Return false to abort collection.
+   */
+  virtual bool PushBatch( const value_T* values, int count ) const
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      if( !Push( values[ i ] ) )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
 };
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -70,6 +70,10 @@ public:
    */
   MojoComplement& Add( const MojoAbstractSet< key_T >* s );
   virtual bool Contains( const key_T& key ) const override;
+  /**
+   Test a block of keys, one input at a time. See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
 
   virtual bool Enumerate( const MojoCollector< key_T >&, const MojoAbstractSet< key_T >* ) const override
   {
@@ -79,6 +83,12 @@ public:
   virtual int _GetEnumerationCost() const override;
   /** \private */
   virtual int _GetChangeCount() const override;
+  /** \private */
+  virtual MojoSetKind _GetKind() const override { return kMojoSetKind_Complement; }
+  /** \private */
+  virtual int _GetInputCount() const override { return m_SetCount; }
+  /** \private */
+  virtual const MojoAbstractSet< key_T >* _GetInput( int index ) const override { return m_Sets[ index ]; }
   
 private:
   const MojoAbstractSet< key_T >* m_Sets[ kMojoInputSetMax ];
@@ -127,6 +137,12 @@ inline bool MojoComplement< key_T >::Contains( const key_T& key ) const
   return true;
 }
 
+template< typename key_T >
+void MojoComplement< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  MojoExcludeBatch( m_Sets, m_SetCount, keys, count, mask );
+}
+
 template< typename key_T >
 int MojoComplement< key_T >::_GetEnumerationCost() const
 {
@@ -45,6 +45,20 @@ MojoConfig::MojoConfig( bool )
   m_BufferMinCount  = kMojoBufferMinCount;
   m_DynamicAlloc    = true;
   m_DynamicTable    = true;
+  m_MaxLoadPercent  = kMojoTableGrowThreshold;
+  m_MinLoadPercent  = kMojoTableShrinkThreshold;
+  m_ShrinkDelay     = 0;
+  m_ChangeLogCount  = 0;
+}
+
+bool MojoConfig::IsValid() const
+{
+  return m_BufferMinCount >= kMojoTableMinCount
+      && m_MaxLoadPercent < 100
+      && m_MinLoadPercent >= 0
+      && m_MinLoadPercent * 2 < m_MaxLoadPercent
+      && m_ShrinkDelay >= 0
+      && m_ChangeLogCount >= 0;
 }
 
 const MojoConfig* MojoConfig::s_Default = NULL;
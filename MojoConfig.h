@@ -44,8 +44,9 @@ struct MojoConfig
    */
   MojoConfig();
   /**
-   The initial number of entries, and also the minimum number of allocate entries. If table becomes smaller than
-   this, hang on to the memory.
+   The minimum number of allocated entries. If table becomes smaller than this, hang on to the memory. Containers
+   that use both m_DynamicAlloc and m_DynamicTable allocate nothing until the first insert, and then start out small.
+   Otherwise, this is also the initial number of entries.
   */
   int         m_BufferMinCount;
   /**
@@ -56,6 +57,33 @@ struct MojoConfig
    Control whether table size should be adjusted to optimize population density.
    */
   bool        m_DynamicTable;
+  /**
+   When population grows above this percentage, double table size. Must be less than 100, and more than twice
+   m_MinLoadPercent, so a table that was just halved doesn't immediately grow again.
+   */
+  int         m_MaxLoadPercent;
+  /**
+   When population falls below this percentage, halve table size. Set to 0 to never shrink the table until it is
+   cleared.
+   */
+  int         m_MinLoadPercent;
+  /**
+   Number of removals to wait before shrinking a table that has fallen below m_MinLoadPercent. If the table fills up
+   again before then, it is left alone. A delay of about the table size keeps a container that oscillates around a
+   size boundary from rehashing on every cycle.
+   */
+  int         m_ShrinkDelay;
+  /**
+   Number of inserted and removed keys a MojoSet remembers, so a MojoCacheSet that depends on it can update by
+   testing only the keys that changed. Once more keys have changed than the log holds, dependent caches rebuild
+   from scratch. Set to 0 to keep no log.
+   */
+  int         m_ChangeLogCount;
+
+  /**
+   Test whether the parameters make sense. Containers will fail to create with kMojoStatus_InvalidArguments if not.
+   */
+  bool IsValid() const;
   
   /**
    Get the current default config.
@@ -31,6 +31,7 @@
 /**
  \ingroup group_config
  Maximum number of sets that can be combined in a single MojoUnion, MojoIntersection, MojoDifference etc.
+ Also the maximum number of hops in a MojoJoinPath.
  */
 static const int kMojoInputSetMax = 20;
 
@@ -48,14 +49,124 @@ static const int kMojoBufferMinCount = 256;
 
 /**
  \ingroup group_config
- When population falls below this percentage, halve table size.
+ When using dynamic memory allocation and dynamic table sizing, containers don't allocate anything until the first
+ insert, and then start out with this number of entries.
+ */
+static const int kMojoBufferInitialCount = 8;
+
+/**
+ \ingroup group_config
+ When population falls below this percentage, halve table size. Default for MojoConfig::m_MinLoadPercent.
  */
 static const int kMojoTableShrinkThreshold = 25;
 
 /**
  \ingroup group_config
- When population grows above this percentage, double table size.
+ When population grows above this percentage, double table size. Default for MojoConfig::m_MaxLoadPercent.
  */
 static const int kMojoTableGrowThreshold = 80;
 
+/**
+ \ingroup group_config
+ Number of elements per segment in a MojoSegmentedArray. Must be a power of two. Insert() and Remove() in the
+ middle take time proportional to kMojoSegmentSize + count / kMojoSegmentSize, which is smallest for arrays of
+ about kMojoSegmentSize squared elements.
+ */
+static const int kMojoSegmentSize = 1024;
+
+/**
+ \ingroup group_config
+ Minimum number of elements per job when an operation is split up through MojoJobs. Smaller operations run
+ directly on the calling thread.
+ */
+static const int kMojoJobMinCount = 32768;
+
+/**
+ \ingroup group_config
+ Maximum number of jobs that an operation is split up into.
+ */
+static const int kMojoJobMax = 16;
+
+/**
+ \ingroup group_config
+ Assumed size of a cache line. Data that different threads write to is kept this far apart.
+ */
+static const int kMojoCacheLineSize = 64;
+
+/**
+ \ingroup group_config
+ Default size in bytes of the blocks that MojoArenaAlloc takes from its parent allocator.
+ */
+static const int kMojoArenaBlockSize = 64 * 1024;
+
+/**
+ \ingroup group_config
+ Largest allocation in bytes that MojoPoolAlloc serves from its size classes. Larger allocations go straight to the
+ parent allocator.
+ */
+static const int kMojoPoolMaxSize = 64 * 1024;
+
+/**
+ \ingroup group_config
+ Size in bytes of the slabs that MojoPoolAlloc takes from its parent allocator and cuts into blocks. Slabs are
+ aligned to this size. Must be a power of 2, and no smaller than kMojoPoolMaxSize.
+ */
+static const int kMojoPoolSlabSize = 64 * 1024;
+
+/**
+ \ingroup group_config
+ Number of bytes per size class that each thread keeps on its own free lists in MojoPoolAlloc. Blocks over this
+ go back to the shared depot, half the amount at a time.
+ */
+static const int kMojoPoolCacheSize = 32 * 1024;
+
+/**
+ \ingroup group_config
+ Smallest allocation in bytes that MojoHugePageAlloc maps directly from the operating system. This is also the
+ size of a huge page. Smaller allocations go to the fallback allocator.
+ */
+static const int kMojoHugePageSize = 2 * 1024 * 1024;
+
+/**
+ \ingroup group_config
+ MojoQueryPlan::Update() recompiles the plan when the enumeration cost of one of its input sets has grown or shrunk
+ by more than this factor since the plan was compiled.
+ */
+static const int kMojoQueryPlanCostRatio = 2;
+
+/**
+ \ingroup group_config
+ MojoIntersection and MojoUnion time every input on one in this many calls to Contains(), to learn which order to
+ test their inputs in. Must be a power of two.
+ */
+static const int kMojoProbeSampleInterval = 64;
+
+/**
+ \ingroup group_config
+ Number of samples MojoIntersection and MojoUnion take between reorderings of their inputs.
+ */
+static const int kMojoProbeReorderInterval = 32;
+
+/**
+ \ingroup group_config
+ Number of keys Enumerate() gathers before testing them against the limit set with
+ MojoAbstractSet::ContainsBatch() and pushing them with MojoCollector::PushBatch(). Must be a multiple of 64.
+ */
+static const int kMojoBatchSize = 256;
+
+/**
+ \ingroup group_config
+ Maximum number of distinct leaf sets in an expression that MojoCacheSet::Update() can follow change logs for.
+ Caches of larger expressions rebuild from scratch on every change.
+ */
+static const int kMojoCacheLeafMax = 16;
+
+/**
+ \ingroup group_config
+ Cost of inserting a key into a scratch set, in units of one Contains() test. MojoUnion::Enumerate() uses a scratch
+ set to skip keys it pushed already, rather than limiting each input by all inputs before it, when that is
+ cheaper by this measure.
+ */
+static const int kMojoUnionScratchCost = 4;
+
 // ---------------------------------------------------------------------------------------------------------------
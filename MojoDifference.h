@@ -31,6 +31,7 @@
 #include "MojoConstants.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
+#include "MojoBitSet.h"
 #include "MojoUtil.h"
 #include "MojoComplement.h"
 
@@ -71,12 +72,22 @@ public:
    */
   MojoDifference& Add( const MojoAbstractSet< key_T >* s );
   virtual bool Contains( const key_T& key ) const override;
+  /**
+   Test a block of keys, one input at a time. See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
   virtual bool Enumerate( const MojoCollector< key_T >& collector,
                          const MojoAbstractSet< key_T >* limit = NULL ) const override;
   /** \private */
   virtual int _GetEnumerationCost() const override;
   /** \private */
   virtual int _GetChangeCount() const override;
+  /** \private */
+  virtual MojoSetKind _GetKind() const override { return kMojoSetKind_Difference; }
+  /** \private */
+  virtual int _GetInputCount() const override { return m_SetCount; }
+  /** \private */
+  virtual const MojoAbstractSet< key_T >* _GetInput( int index ) const override { return m_Sets[ index ]; }
   
 private:
   const MojoAbstractSet< key_T >* m_Sets[ kMojoInputSetMax ];
@@ -130,6 +141,16 @@ inline bool MojoDifference< key_T >::Contains( const key_T& key ) const
   return true;
 }
 
+template< typename key_T >
+void MojoDifference< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  if( m_SetCount )
+  {
+    m_Sets[ 0 ]->ContainsBatch( keys, count, mask );
+    MojoExcludeBatch( m_Sets + 1, m_SetCount - 1, keys, count, mask );
+  }
+}
+
 template< typename key_T >
 inline int MojoDifference< key_T >::_GetEnumerationCost() const
 {
@@ -152,6 +173,10 @@ inline bool MojoDifference< key_T >::Enumerate( const MojoCollector< key_T >& co
                                                const MojoAbstractSet< key_T >* limit ) const
 {
   bool more = true;
+  if( MojoEnumerateWords( kMojoSetKind_Difference, m_Sets, m_SetCount, collector, limit, &more ) )
+  {
+    return more;
+  }
   if( limit )
   {
     MojoDifference< key_T > combined_limit;
@@ -33,6 +33,9 @@
 #include "MojoCollector.h"
 #include "MojoMultiMap.h"
 #include "MojoMap.h"
+#include "MojoOneToOne.h"
+#include "MojoOneToMany.h"
+#include "MojoManyToMany.h"
 
 // ---------------------------------------------------------------------------------------------------------------
 
@@ -41,6 +44,10 @@
  \ingroup group_function
  Contains all children of the keys in the input set. Input keys with no children have no effect.
  \image html Func-Inverse-Open-Shallow.png
+ Contains() does not need to enumerate the input set if an inverse map is available. Pass a relation, or pass the
+ inverse map explicitly. Without an inverse map, call BuildIndex() to build an inverse index from the map. The index
+ is used until the map changes. After that, Contains() enumerates the input set again until BuildIndex() is called.
+ Contains() only reads, so it may be called from more than one thread at a time.
  \note Enumeration may result in duplicate entries. Enumeration into a MojoSetCollector is recommended.
  */
 template< typename key_T, typename value_T >
@@ -67,9 +74,9 @@ class MojoFunction : public MojoAbstractSet< value_T >
     }
 
   private:
-    const MojoCollector< key_T >&         m_Collector;
+    const MojoCollector< value_T >&       m_Collector;
     const MojoMultiMap< key_T, value_T >* m_MultiMap;
-    const MojoAbstractSet< key_T >*       m_Limit;
+    const MojoAbstractSet< value_T >*     m_Limit;
   };
 
   class TestMultiCollector final : public MojoCollector< key_T >
@@ -121,9 +128,9 @@ class MojoFunction : public MojoAbstractSet< value_T >
     }
 
   private:
-    const MojoCollector< key_T >&     m_Collector;
+    const MojoCollector< value_T >&   m_Collector;
     const MojoMap< key_T, value_T >*  m_Map;
-    const MojoAbstractSet< key_T >*   m_Limit;
+    const MojoAbstractSet< value_T >* m_Limit;
   };
 
   class TestCollector final : public MojoCollector< key_T >
@@ -151,28 +158,202 @@ class MojoFunction : public MojoAbstractSet< value_T >
     const MojoMap< key_T, value_T >* m_Map;
   };
   
+  class IndexMultiCollector final : public MojoCollector< key_T >
+  {
+  public:
+    IndexMultiCollector( const MojoMultiMap< key_T, value_T >* multi_map, MojoMultiMap< value_T, key_T >* index )
+    : m_MultiMap( multi_map )
+    , m_Index( index )
+    {}
+
+    virtual bool Push( const key_T& key ) const override
+    {
+      const MojoSet< value_T >* values = m_MultiMap->Find( key );
+      if( values )
+      {
+        value_T value;
+        MojoForEachKey( *values, value )
+        {
+          m_Index->Insert( value, key );
+        }
+      }
+      return true;
+    }
+
+  private:
+    const MojoMultiMap< key_T, value_T >* m_MultiMap;
+    MojoMultiMap< value_T, key_T >*       m_Index;
+  };
+
+  class IndexCollector final : public MojoCollector< key_T >
+  {
+  public:
+    IndexCollector( const MojoMap< key_T, value_T >* map, MojoMultiMap< value_T, key_T >* index )
+    : m_Map( map )
+    , m_Index( index )
+    {}
+
+    virtual bool Push( const key_T& key ) const override
+    {
+      value_T value = m_Map->Find( key );
+      if( !value.IsHashNull() )
+      {
+        m_Index->Insert( value, key );
+      }
+      return true;
+    }
+
+  private:
+    const MojoMap< key_T, value_T >* m_Map;
+    MojoMultiMap< value_T, key_T >*  m_Index;
+  };
+
 public:
   MojoFunction()
-  : m_InputSet( NULL )
-  , m_MultiMap( NULL )
-  , m_Map( NULL )
-  {}
+  {
+    Init( NULL, NULL, NULL );
+  }
 
   MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, value_T >* multi_map )
-  : m_InputSet( input_set )
-  , m_MultiMap( multi_map )
-  , m_Map( NULL )
-  {}
+  {
+    Init( input_set, multi_map, NULL );
+  }
 
   MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoMap< key_T, value_T >* map )
-  : m_InputSet( input_set )
-  , m_MultiMap( NULL )
-  , m_Map( map )
-  {}
+  {
+    Init( input_set, NULL, map );
+  }
 
-  virtual bool Contains( const value_T& value ) const
+  /**
+   \param[in] input_set Keys to look up.
+   \param[in] multi_map Map from key to values.
+   \param[in] inverse_map Map from value to key. Must contain the same pairs as multi_map.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, value_T >* multi_map,
+               const MojoMap< value_T, key_T >* inverse_map )
+  {
+    Init( input_set, multi_map, NULL );
+    m_InverseMap = inverse_map;
+  }
+
+  /**
+   \param[in] input_set Keys to look up.
+   \param[in] multi_map Map from key to values.
+   \param[in] inverse_multi_map Map from value to keys. Must contain the same pairs as multi_map.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, value_T >* multi_map,
+               const MojoMultiMap< value_T, key_T >* inverse_multi_map )
+  {
+    Init( input_set, multi_map, NULL );
+    m_InverseMultiMap = inverse_multi_map;
+  }
+
+  /**
+   \param[in] input_set Keys to look up.
+   \param[in] map Map from key to value.
+   \param[in] inverse_map Map from value to key. Must contain the same pairs as map.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoMap< key_T, value_T >* map,
+               const MojoMap< value_T, key_T >* inverse_map )
   {
+    Init( input_set, NULL, map );
+    m_InverseMap = inverse_map;
+  }
+
+  /**
+   \param[in] input_set Keys to look up.
+   \param[in] map Map from key to value.
+   \param[in] inverse_multi_map Map from value to keys. Must contain the same pairs as map.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoMap< key_T, value_T >* map,
+               const MojoMultiMap< value_T, key_T >* inverse_multi_map )
+  {
+    Init( input_set, NULL, map );
+    m_InverseMultiMap = inverse_multi_map;
+  }
+
+  /**
+   Contains the children of the parents in the input set.
+   \param[in] input_set Parents.
+   \param[in] relation Relation to get children from.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoOneToOne< key_T, value_T >* relation )
+  {
+    Init( input_set, NULL, relation->GetParentToChildMap() );
+    m_InverseMap = relation->GetChildToParentMap();
+  }
+
+  /**
+   Contains the children of the parents in the input set.
+   \param[in] input_set Parents.
+   \param[in] relation Relation to get children from.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoOneToMany< key_T, value_T >* relation )
+  {
+    Init( input_set, relation->GetParentToChildMultiMap(), NULL );
+    m_InverseMap = relation->GetChildToParentMap();
+  }
+
+  /**
+   Contains the children of the parents in the input set.
+   \param[in] input_set Parents.
+   \param[in] relation Relation to get children from.
+   */
+  MojoFunction( const MojoAbstractSet< key_T >* input_set, const MojoManyToMany< key_T, value_T >* relation )
+  {
+    Init( input_set, relation->GetParentToChildMultiMap(), NULL );
+    m_InverseMultiMap = relation->GetChildToParentMultiMap();
+  }
+
+  /**
+   Build an inverse index from the map, so Contains() need not enumerate the input set. Only useful if no inverse
+   map was given. Call again after the map has changed: until then, Contains() ignores the index.
+   \return Status code.
+   */
+  MojoStatus BuildIndex()
+  {
+    m_IndexValid = false;
+    if( !m_MultiMap && !m_Map )
+    {
+      return kMojoStatus_NotInitialized;
+    }
+    if( m_Index.GetStatus() == kMojoStatus_NotInitialized )
+    {
+      m_Index.Create( "MojoFunction" );
+    }
+    else
+    {
+      m_Index.Clear();
+    }
     if( m_MultiMap )
+    {
+      m_MultiMap->Enumerate( IndexMultiCollector( m_MultiMap, &m_Index ) );
+    }
+    else
+    {
+      m_Map->Enumerate( IndexCollector( m_Map, &m_Index ) );
+    }
+    m_IndexChangeCount = _GetChangeCount();
+    m_IndexValid = ( m_Index.GetStatus() == kMojoStatus_Ok );
+    return m_Index.GetStatus();
+  }
+
+  virtual bool Contains( const value_T& value ) const
+  {
+    if( m_InverseMap )
+    {
+      key_T key = m_InverseMap->Find( value );
+      return !key.IsHashNull() && m_InputSet->Contains( key );
+    }
+    else if( m_InverseMultiMap )
+    {
+      return ContainsAny( m_InverseMultiMap->Find( value ) );
+    }
+    else if( m_IndexValid && m_IndexChangeCount == _GetChangeCount() )
+    {
+      return ContainsAny( m_Index.Find( value ) );
+    }
+    else if( m_MultiMap )
     {
       return !m_InputSet->Enumerate( TestMultiCollector( m_MultiMap, value ) );
     }
@@ -225,9 +406,44 @@ public:
 
 private:
 
-  const MojoAbstractSet< key_T >*       m_InputSet;
-  const MojoMultiMap< key_T, value_T >* m_MultiMap;
-  const MojoMap< key_T, value_T >*      m_Map;
+  const MojoAbstractSet< key_T >*         m_InputSet;
+  const MojoMultiMap< key_T, value_T >*   m_MultiMap;
+  const MojoMap< key_T, value_T >*        m_Map;
+  const MojoMap< value_T, key_T >*        m_InverseMap;
+  const MojoMultiMap< value_T, key_T >*   m_InverseMultiMap;
+
+  // Inverse index, built by BuildIndex() when no inverse map was given
+  MojoMultiMap< value_T, key_T >          m_Index;
+  int                                     m_IndexChangeCount;   // Change count of map the index refers to
+  bool                                    m_IndexValid;
+
+  void Init( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, value_T >* multi_map,
+            const MojoMap< key_T, value_T >* map )
+  {
+    m_InputSet = input_set;
+    m_MultiMap = multi_map;
+    m_Map = map;
+    m_InverseMap = NULL;
+    m_InverseMultiMap = NULL;
+    m_IndexChangeCount = 0;
+    m_IndexValid = false;
+  }
+
+  bool ContainsAny( const MojoSet< key_T >* keys ) const
+  {
+    if( keys )
+    {
+      key_T key;
+      MojoForEachKey( *keys, key )
+      {
+        if( m_InputSet->Contains( key ) )
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
 };
 
 // ---------------------------------------------------------------------------------------------------------------
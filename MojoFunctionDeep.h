@@ -28,10 +28,14 @@
 
 #pragma once
 
+// -- Standard Libs
+#include <atomic>
+
 #include "MojoConstants.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
 #include "MojoMultiMap.h"
+#include "MojoTraversal.h"
 
 // ---------------------------------------------------------------------------------------------------------------
 
@@ -40,71 +44,33 @@
  \ingroup group_function
  Contains all children of the keys in the input set. Input keys with no children have no effect.
  \image html Func-Inverse-Open-Shallow.png
- \note Enumeration may result in duplicate entries. Enumeration into a MojoSetCollector is recommended.
+ Over a MojoMultiMap, every child is visited once, no matter how many paths lead to it, and cycles are allowed.
+ The first Contains() or Enumerate() allocates a visited table that is reused for later calls. See MojoTraversal.
+ \note Enumeration over a MojoMap may result in duplicate entries. Enumeration into a MojoSetCollector is
+ recommended.
+ \note Contains() and Enumerate() may be called from more than one thread at a time, and from inside a collector or
+ limit of another call on the same object. A call that finds the visited table in use allocates one of its own.
  */
 template< typename key_T >
 class MojoFunctionDeep : public MojoAbstractSet< key_T >
 {
-  class EnumMultiCollector final : public MojoCollector< key_T >
-  {
-  public:
-    EnumMultiCollector( const MojoCollector< key_T >& collector, const MojoMultiMap< key_T, key_T >* multi_map,
-                  const MojoAbstractSet< key_T >* limit )
-    : m_Collector( collector )
-    , m_MultiMap( multi_map )
-    , m_Limit( limit )
-    {}
-
-    virtual bool Push( const key_T& key ) const override
-    {
-      const MojoSet< key_T >* values = m_MultiMap->Find( key );
-      if( !values )
-      {
-        return true;
-      }
-      if( !values->Enumerate( m_Collector, m_Limit ) )
-      {
-        return false;
-      }
-      // The recursive part:
-      return values->Enumerate( EnumMultiCollector( m_Collector, m_MultiMap, m_Limit ) );
-    }
-
-  private:
-    const MojoCollector< key_T >&       m_Collector;
-    const MojoMultiMap< key_T, key_T >* m_MultiMap;
-    const MojoAbstractSet< key_T >*     m_Limit;
-  };
-
-  class TestMultiCollector final : public MojoCollector< key_T >
+  class MatchCollector final : public MojoCollector< key_T >
   {
   public:
-    TestMultiCollector( const MojoMultiMap< key_T, key_T >* multi_map, const key_T& value )
+    MatchCollector( const key_T& value )
     : m_Value( value )
-    , m_MultiMap( multi_map )
     {}
 
     virtual bool Push( const key_T& key ) const override
     {
-      const MojoSet< key_T >* values = m_MultiMap->Find( key );
       // Must return _false_ if found, true if not found (keep searching)
-      if( !values )
-      {
-        return true;
-      }
-      if( values->Contains( m_Value ) )
-      {
-        return false;
-      }
-      // The recursive part:
-      return values->Enumerate( TestMultiCollector( m_MultiMap, m_Value ) );
+      return !( key == m_Value );
     }
 
   private:
     key_T m_Value;
-    const MojoMultiMap< key_T, key_T >* m_MultiMap;
   };
-  
+
   class EnumCollector final : public MojoCollector< key_T >
   {
   public:
@@ -168,23 +134,38 @@ class MojoFunctionDeep : public MojoAbstractSet< key_T >
   };
   
 public:
-  MojoFunctionDeep( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, key_T >* multi_map )
+  /**
+   \param[in] input_set Keys to start from.
+   \param[in] multi_map Map from parent to children.
+   \param[in] max_depth Maximum number of steps from the input set. 1 is equivalent to MojoFunction.
+   \param[in] order Order in which children are enumerated.
+   */
+  MojoFunctionDeep( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, key_T >* multi_map,
+                   int max_depth = INT_MAX, MojoTraversalOrder order = kMojoTraversalOrder_DepthFirst )
   : m_InputSet( input_set )
   , m_MultiMap( multi_map )
   , m_Map( NULL )
-  {}
+  , m_MaxDepth( max_depth )
+  , m_Order( order )
+  {
+    m_InUse.clear();
+  }
 
   MojoFunctionDeep( const MojoAbstractSet< key_T >* input_set, const MojoMap< key_T, key_T >* map )
   : m_InputSet( input_set )
   , m_MultiMap( NULL )
   , m_Map( map )
-  {}
+  , m_MaxDepth( INT_MAX )
+  , m_Order( kMojoTraversalOrder_DepthFirst )
+  {
+    m_InUse.clear();
+  }
 
   virtual bool Contains( const key_T& value ) const
   {
     if( m_MultiMap )
     {
-      return !m_InputSet->Enumerate( TestMultiCollector( m_MultiMap, value ) );
+      return !Traverse( MatchCollector( value ), NULL );
     }
     else if( m_Map )
     {
@@ -198,7 +179,7 @@ public:
   {
     if( m_MultiMap )
     {
-      return m_InputSet->Enumerate( EnumMultiCollector( collector, m_MultiMap, limit ) );
+      return Traverse( collector, limit );
     }
     else if( m_Map )
     {
@@ -238,6 +219,27 @@ private:
   const MojoAbstractSet< key_T >*     m_InputSet;
   const MojoMultiMap< key_T, key_T >* m_MultiMap;
   const MojoMap< key_T, key_T >*      m_Map;
+  int                                 m_MaxDepth;
+  MojoTraversalOrder                  m_Order;
+  mutable MojoTraversal< key_T >      m_Traversal;  // Scratch memory, created on first use
+  mutable std::atomic_flag            m_InUse;      // Set while a call uses m_Traversal
+
+  bool Traverse( const MojoCollector< key_T >& collector, const MojoAbstractSet< key_T >* limit ) const
+  {
+    if( m_InUse.test_and_set( std::memory_order_acquire ) )
+    {
+      // Another thread, or a call further up this thread's stack, is using the visited table and work list.
+      MojoTraversal< key_T > traversal( "MojoFunctionDeep" );
+      return traversal.Enumerate( m_InputSet, m_MultiMap, collector, limit, m_MaxDepth, m_Order );
+    }
+    if( m_Traversal.GetStatus() == kMojoStatus_NotInitialized )
+    {
+      m_Traversal.Create( "MojoFunctionDeep" );
+    }
+    bool more = m_Traversal.Enumerate( m_InputSet, m_MultiMap, collector, limit, m_MaxDepth, m_Order );
+    m_InUse.clear( std::memory_order_release );
+    return more;
+  }
 };
 
 // ---------------------------------------------------------------------------------------------------------------
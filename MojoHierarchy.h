@@ -0,0 +1,398 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Mojo
+#include "MojoStatus.h"
+#include "MojoConfig.h"
+#include "MojoAlloc.h"
+#include "MojoUtil.h"
+#include "MojoCollector.h"
+#include "MojoMap.h"
+#include "MojoArray.h"
+#include "MojoOneToMany.h"
+
+/**
+ \class MojoHierarchy
+ \ingroup group_container
+ Ancestor index for a MojoOneToMany that describes a hierarchy, such as a scene graph. Answers IsAncestorOf() and
+ GetDepth() in constant time, and FindLowestCommonAncestor() in logarithmic time.
+
+ Every node is numbered in depth-first order. A node's descendants are numbered consecutively after the node
+ itself, so ancestry is a comparison of two number ranges. Each node also stores a jump pointer to one of its
+ ancestors, chosen such that any ancestor can be reached in O(log depth) steps.
+
+ The index is rebuilt lazily. Any query that finds that the relation has changed since the last query will rebuild
+ the index first. Rebuilding is O(n), so it is best to batch structural changes between queries.
+
+ Nodes that are not reachable from a root, i.e. nodes that are part of a parent-child cycle, are not indexed.
+ \tparam key_T Key type of both parents and children. Must be hashable.
+ */
+template< typename key_T >
+class MojoHierarchy final
+{
+public:
+  /**
+   Default constructor. You must call Create() before the index is ready for use.
+   */
+  MojoHierarchy()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the index. Will also be used for internal memory allocation.
+   \param[in] relation The child-to-parent relation to index.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig
+   for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoHierarchy( const char* name, const MojoOneToMany< key_T, key_T >* relation, const MojoConfig* config = NULL,
+                MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, relation, config, alloc );
+  }
+
+  /**
+   Create after default constructor or Destroy().
+   \param[in] name The name of the index. Will also be used for internal memory allocation.
+   \param[in] relation The child-to-parent relation to index.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig
+   for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const MojoOneToMany< key_T, key_T >* relation,
+                    const MojoConfig* config = NULL, MojoAlloc* alloc = NULL );
+
+  /**
+   Release all resources.
+   */
+  void Destroy();
+
+  /**
+   If the relation has changed since the last update, rebuild the index. Otherwise do nothing.
+   All queries call this, so there is normally no need to call it yourself.
+   \return Status code.
+   */
+  MojoStatus Update();
+
+  /**
+   Test if one node is a proper ancestor of another.
+   \param[in] ancestor The presumed ancestor.
+   \param[in] descendant The presumed descendant.
+   \return true if `ancestor` is the parent of `descendant`, or the parent's parent, and so on. A node is not its
+   own ancestor.
+   */
+  bool IsAncestorOf( const key_T& ancestor, const key_T& descendant );
+
+  /**
+   Get distance from the root of the hierarchy.
+   \param[in] key Node to look for.
+   \return 0 for a root, 1 for a child of a root, and so on. -1 if the node is not in the hierarchy.
+   */
+  int GetDepth( const key_T& key );
+
+  /**
+   Find the deepest node that is an ancestor of both nodes, or one of the nodes itself.
+   \param[in] a First node.
+   \param[in] b Second node.
+   \return The lowest common ancestor. If `a` is an ancestor of `b`, this is `a`. If the nodes are not in the same
+   tree, a Null key is returned.
+   */
+  key_T FindLowestCommonAncestor( const key_T& a, const key_T& b );
+
+  /**
+   Return status state.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  /**
+   Return name of the index.
+   \return Given name.
+   */
+  const char* GetName() const { return m_Name; }
+
+  ~MojoHierarchy();
+
+private:
+  struct Entry
+  {
+    Entry()
+    : m_Enter( -1 )
+    , m_Exit( -1 )
+    , m_Depth( -1 )
+    {}
+
+    key_T   m_Parent;   // Null for roots
+    key_T   m_Jump;     // Ancestor to skip to. Self for roots.
+    int     m_Enter;    // Depth-first number of this node
+    int     m_Exit;     // Highest depth-first number in this subtree
+    int     m_Depth;
+  };
+
+  class RootCollector final : public MojoCollector< key_T >
+  {
+  public:
+    RootCollector( const MojoOneToMany< key_T, key_T >* relation, MojoArray< key_T >* roots )
+    : m_Relation( relation )
+    , m_Roots( roots )
+    {}
+    virtual bool Push( const key_T& key ) const override
+    {
+      if( !m_Relation->ContainsChild( key ) )
+      {
+        m_Roots->Push( key );
+      }
+      return true;
+    }
+  private:
+    const MojoOneToMany< key_T, key_T >*  m_Relation;
+    MojoArray< key_T >*                   m_Roots;
+  };
+
+  const char*                           m_Name;
+  MojoAlloc*                            m_Alloc;
+  MojoConfig                            m_Config;
+  const MojoOneToMany< key_T, key_T >*  m_Relation;
+  MojoMap< key_T, Entry >               m_Entries;
+  MojoArray< key_T >                    m_Order;  // Nodes in depth-first order
+  int                                   m_ChangeCount;
+  MojoStatus                            m_Status;
+
+  void Init();
+  MojoStatus Rebuild();
+  static bool IsAncestorOrSelf( const Entry& ancestor, const Entry& descendant );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+void MojoHierarchy< key_T >::Init()
+{
+  m_Name = NULL;
+  m_Alloc = NULL;
+  m_Relation = NULL;
+  m_ChangeCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T >
+MojoStatus MojoHierarchy< key_T >::Create( const char* name, const MojoOneToMany< key_T, key_T >* relation,
+                                         const MojoConfig* config, MojoAlloc* alloc )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else if( !relation )
+  {
+    m_Status = kMojoStatus_InvalidArguments;
+  }
+  else
+  {
+    m_Name = name;
+    m_Alloc = alloc ? alloc : MojoAlloc::GetDefault();
+    m_Config = config ? *config : *MojoConfig::GetDefault();
+    m_Relation = relation;
+    m_Status = m_Entries.Create( name, Entry(), config, alloc );
+    if( !m_Status )
+    {
+      m_Status = m_Order.Create( name, key_T(), config, alloc );
+    }
+    if( !m_Status )
+    {
+      m_Status = Rebuild();
+    }
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoHierarchy< key_T >::~MojoHierarchy()
+{
+  Destroy();
+}
+
+template< typename key_T >
+void MojoHierarchy< key_T >::Destroy()
+{
+  m_Entries.Destroy();
+  m_Order.Destroy();
+  Init();
+}
+
+template< typename key_T >
+MojoStatus MojoHierarchy< key_T >::Update()
+{
+  if( !m_Status && m_ChangeCount != m_Relation->_GetChangeCount() )
+  {
+    return Rebuild();
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoStatus MojoHierarchy< key_T >::Rebuild()
+{
+  m_ChangeCount = m_Relation->_GetChangeCount();
+  m_Entries.Clear();
+  m_Order.Clear();
+
+  // Roots are parents without a parent of their own. Collect them first, then walk each tree depth-first with an
+  // explicit stack, so deep hierarchies can't overflow the call stack.
+  MojoArray< key_T > stack( __FUNCTION__, key_T(), &m_Config, m_Alloc );
+  m_Relation->GetParentToChildMultiMap()->Enumerate( RootCollector( m_Relation, &stack ) );
+
+  for( int i = 0; i < stack.GetCount(); ++i )
+  {
+    Entry entry;
+    entry.m_Jump = stack[ i ];
+    entry.m_Depth = 0;
+    m_Entries.Insert( stack[ i ], entry );
+  }
+
+  while( stack.GetCount() )
+  {
+    key_T key = stack.Pop();
+    Entry* entry = m_Entries.FindForImmediateChange( key );
+    entry->m_Enter = m_Order.GetCount();
+    entry->m_Exit = entry->m_Enter;
+    Entry parent = *entry;
+    m_Order.Push( key );
+
+    const MojoSet< key_T >* children = m_Relation->FindChildren( key );
+    if( children )
+    {
+      // Jump pointer construction as per Myers, "An applicative random-access stack". If the parent's jump and
+      // its jump's jump span equal distances, skip over both. Otherwise jump to the parent.
+      Entry parent_jump = m_Entries.Find( parent.m_Jump );
+      Entry parent_jump_jump = m_Entries.Find( parent_jump.m_Jump );
+      bool skip = ( parent.m_Depth - parent_jump.m_Depth == parent_jump.m_Depth - parent_jump_jump.m_Depth );
+
+      key_T child;
+      MojoForEachKey( *children, child )
+      {
+        Entry child_entry;
+        child_entry.m_Parent = key;
+        child_entry.m_Jump = skip ? parent_jump.m_Jump : key;
+        child_entry.m_Depth = parent.m_Depth + 1;
+        m_Entries.Insert( child, child_entry );
+        stack.Push( child );
+      }
+    }
+  }
+
+  // Propagate subtree ranges up. Children always come after their parent in depth-first order.
+  for( int i = m_Order.GetCount() - 1; i >= 0; --i )
+  {
+    Entry entry = m_Entries.Find( m_Order[ i ] );
+    if( !entry.m_Parent.IsHashNull() )
+    {
+      Entry* parent = m_Entries.FindForImmediateChange( entry.m_Parent );
+      parent->m_Exit = MojoMax( parent->m_Exit, entry.m_Exit );
+    }
+  }
+
+  MojoStatus status = m_Entries.GetStatus();
+  return status ? status : m_Order.GetStatus();
+}
+
+template< typename key_T >
+bool MojoHierarchy< key_T >::IsAncestorOrSelf( const Entry& ancestor, const Entry& descendant )
+{
+  return ancestor.m_Enter >= 0 && ancestor.m_Enter <= descendant.m_Enter && descendant.m_Enter <= ancestor.m_Exit;
+}
+
+template< typename key_T >
+bool MojoHierarchy< key_T >::IsAncestorOf( const key_T& ancestor, const key_T& descendant )
+{
+  if( Update() )
+  {
+    return false;
+  }
+  Entry a = m_Entries.Find( ancestor );
+  Entry d = m_Entries.Find( descendant );
+  return a.m_Enter != d.m_Enter && IsAncestorOrSelf( a, d );
+}
+
+template< typename key_T >
+int MojoHierarchy< key_T >::GetDepth( const key_T& key )
+{
+  if( Update() )
+  {
+    return -1;
+  }
+  return m_Entries.Find( key ).m_Depth;
+}
+
+template< typename key_T >
+key_T MojoHierarchy< key_T >::FindLowestCommonAncestor( const key_T& a, const key_T& b )
+{
+  if( Update() )
+  {
+    return key_T();
+  }
+  Entry entry_a = m_Entries.Find( a );
+  Entry entry_b = m_Entries.Find( b );
+  if( entry_a.m_Enter < 0 || entry_b.m_Enter < 0 )
+  {
+    return key_T();
+  }
+
+  // Climb from a until we reach an ancestor of b. Take the jump whenever it does not overshoot.
+  key_T key = a;
+  while( !IsAncestorOrSelf( entry_a, entry_b ) )
+  {
+    if( entry_a.m_Parent.IsHashNull() )
+    {
+      return key_T(); // Reached root of a different tree
+    }
+    Entry jump = m_Entries.Find( entry_a.m_Jump );
+    if( !IsAncestorOrSelf( jump, entry_b ) )
+    {
+      key = entry_a.m_Jump;
+      entry_a = jump;
+    }
+    else
+    {
+      key = entry_a.m_Parent;
+      entry_a = m_Entries.Find( key );
+    }
+  }
+  return key;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
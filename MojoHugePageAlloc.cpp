@@ -0,0 +1,211 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Standard Libs
+#include <stddef.h>
+#include <stdint.h>
+#if defined( __linux__ )
+#include <sys/mman.h>
+#endif
+
+#include "MojoHugePageAlloc.h"
+
+// Every block is preceded by a header. For mapped blocks, the header is at the end of the first cache line of the
+// mapping, so the block itself starts on a cache line.
+struct Header
+{
+  size_t  m_MappedSize;   // 0 for blocks from the fallback allocator
+  size_t  m_ByteCount;
+};
+static const size_t kHeaderSize = 16;
+static const size_t kMappedOffset = 64;
+static const size_t kHugePageSize = kMojoHugePageSize;
+static_assert( sizeof( Header ) <= kHeaderSize, "Header does not fit" );
+
+static Header* GetHeader( void* p )
+{
+  return ( Header* )( ( char* )p - kHeaderSize );
+}
+
+static size_t RoundUp( size_t byte_count, size_t alignment )
+{
+  return ( byte_count + alignment - 1 ) / alignment * alignment;
+}
+
+MojoHugePageAlloc::MojoHugePageAlloc( MojoAlloc* fallback, bool explicit_huge_pages )
+{
+  m_Fallback = fallback ? fallback : MojoAlloc::GetDefault();
+  m_ExplicitHugePages = explicit_huge_pages;
+  m_MappedByteCount.store( 0 );
+}
+
+void* MojoHugePageAlloc::Allocate( size_t byte_count, const char* name )
+{
+#if defined( __linux__ )
+  if( byte_count >= kHugePageSize )
+  {
+    size_t mapped_size = RoundUp( byte_count + kMappedOffset, kHugePageSize );
+    char* base = ( char* )Map( mapped_size );
+    if( !base )
+    {
+      return NULL;
+    }
+    char* p = base + kMappedOffset;
+    GetHeader( p )->m_MappedSize = mapped_size;
+    GetHeader( p )->m_ByteCount = byte_count;
+    return p;
+  }
+#endif
+  char* block = ( char* )m_Fallback->Allocate( byte_count + kHeaderSize, name );
+  if( !block )
+  {
+    return NULL;
+  }
+  char* p = block + kHeaderSize;
+  GetHeader( p )->m_MappedSize = 0;
+  GetHeader( p )->m_ByteCount = byte_count;
+  return p;
+}
+
+void MojoHugePageAlloc::Free( void* p )
+{
+  if( !p )
+  {
+    return;
+  }
+  Header* header = GetHeader( p );
+#if defined( __linux__ )
+  if( header->m_MappedSize )
+  {
+    size_t mapped_size = header->m_MappedSize;
+    munmap( ( char* )p - kMappedOffset, mapped_size );
+    m_MappedByteCount.fetch_sub( mapped_size, std::memory_order_relaxed );
+    return;
+  }
+#endif
+  m_Fallback->Free( header );
+}
+
+void* MojoHugePageAlloc::Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name )
+{
+  if( !p )
+  {
+    return NULL;
+  }
+  Header* header = GetHeader( p );
+#if defined( __linux__ )
+  if( header->m_MappedSize )
+  {
+    if( new_byte_count < kHugePageSize )
+    {
+      // Let the caller move it to the fallback allocator.
+      return NULL;
+    }
+    char* base = ( char* )p - kMappedOffset;
+    size_t mapped_size = header->m_MappedSize;
+    size_t new_mapped_size = RoundUp( new_byte_count + kMappedOffset, kHugePageSize );
+    if( new_mapped_size <= mapped_size )
+    {
+      // Shrink in place. Keep the address range, but give the pages past the new end back.
+      if( new_mapped_size < mapped_size )
+      {
+        madvise( base + new_mapped_size, mapped_size - new_mapped_size, MADV_DONTNEED );
+      }
+      header->m_ByteCount = new_byte_count;
+      return p;
+    }
+    // Grow. The kernel moves the pages if the range can't be extended where it is.
+    char* new_base = ( char* )mremap( base, mapped_size, new_mapped_size, MREMAP_MAYMOVE );
+    if( new_base == MAP_FAILED )
+    {
+      return NULL;
+    }
+    madvise( new_base, new_mapped_size, MADV_HUGEPAGE );
+    m_MappedByteCount.fetch_add( new_mapped_size - mapped_size, std::memory_order_relaxed );
+    char* new_p = new_base + kMappedOffset;
+    GetHeader( new_p )->m_MappedSize = new_mapped_size;
+    GetHeader( new_p )->m_ByteCount = new_byte_count;
+    return new_p;
+  }
+#endif
+  if( new_byte_count >= kHugePageSize )
+  {
+    // Let the caller move it to a mapped block.
+    return NULL;
+  }
+  char* block = ( char* )m_Fallback->Reallocate( header, old_byte_count + kHeaderSize, new_byte_count + kHeaderSize,
+                                                  name );
+  if( !block )
+  {
+    return NULL;
+  }
+  char* new_p = block + kHeaderSize;
+  GetHeader( new_p )->m_ByteCount = new_byte_count;
+  return new_p;
+}
+
+void* MojoHugePageAlloc::Map( size_t mapped_size )
+{
+#if defined( __linux__ )
+  if( m_ExplicitHugePages )
+  {
+    void* base = mmap( NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if( base != MAP_FAILED )
+    {
+      m_MappedByteCount.fetch_add( mapped_size, std::memory_order_relaxed );
+      return base;
+    }
+  }
+
+  // Map one huge page extra, so the block can be aligned to a huge page boundary. Then unmap the excess on both
+  // ends. Transparent huge pages are only used for aligned ranges.
+  size_t reserve_size = mapped_size + kHugePageSize;
+  char* reserve = ( char* )mmap( NULL, reserve_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if( reserve == MAP_FAILED )
+  {
+    return NULL;
+  }
+  char* base = ( char* )RoundUp( ( uintptr_t )reserve, kHugePageSize );
+  if( base > reserve )
+  {
+    munmap( reserve, base - reserve );
+  }
+  char* reserve_end = reserve + reserve_size;
+  if( reserve_end > base + mapped_size )
+  {
+    munmap( base + mapped_size, reserve_end - ( base + mapped_size ) );
+  }
+  madvise( base, mapped_size, MADV_HUGEPAGE );
+  m_MappedByteCount.fetch_add( mapped_size, std::memory_order_relaxed );
+  return base;
+#else
+  return NULL;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stddef.h>
+#include <atomic>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoAlloc.h"
+
+/**
+ \class MojoHugePageAlloc
+ \ingroup group_config
+ An allocator that maps large blocks directly from the operating system, backed by huge pages.
+
+ A lookup in a very large hash table touches a random page. With 4 KB pages, nearly every lookup in a table of
+ several GB misses the TLB. Backing the table with 2 MB pages makes the TLB cover 512 times as much memory.
+
+ Requests of kMojoHugePageSize bytes or more are mapped with mmap(), aligned to kMojoHugePageSize, and marked with
+ madvise( MADV_HUGEPAGE ) so the kernel backs them with transparent huge pages. If explicit huge pages are requested,
+ mmap( MAP_HUGETLB ) is tried first. That needs huge pages reserved by the system administrator. Smaller requests
+ go to the fallback allocator.
+
+ Reallocate() shrinks a mapped block in place, and hands the pages past the new end back to the operating system
+ with madvise( MADV_DONTNEED ). It grows a mapped block with mremap(), which moves pages without copying them.
+ Freeing a mapped block unmaps it.
+
+ On platforms other than Linux, all requests go to the fallback allocator.
+ */
+class MojoHugePageAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Constructor.
+   \param[in] fallback Allocator for requests smaller than kMojoHugePageSize. If omitted, the global default at the
+   time of construction will be used. See documentation for MojoAlloc for details on how to set the global default.
+   \param[in] explicit_huge_pages Try mmap( MAP_HUGETLB ) before transparent huge pages.
+   */
+  MojoHugePageAlloc( MojoAlloc* fallback = NULL, bool explicit_huge_pages = false );
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  virtual void  Free( void* p ) override;
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name ) override;
+
+  /**
+   Get the number of bytes currently mapped from the operating system. Pages released with MADV_DONTNEED are
+   still counted.
+   \return Number of bytes.
+   */
+  size_t GetMappedByteCount() const { return m_MappedByteCount.load( std::memory_order_relaxed ); }
+
+private:
+  MojoAlloc*              m_Fallback;
+  bool                    m_ExplicitHugePages;
+  std::atomic< size_t >   m_MappedByteCount;
+
+  void* Map( size_t mapped_size );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
@@ -237,4 +237,23 @@ inline MojoId::~MojoId()
   SetNull();
 }
 
+/**
+ \class MojoIdLessByString
+ \ingroup group_id
+ Function object that orders MojoId alphabetically by string. Null sorts as the empty string.
+ \code
+ ids.SortBy( MojoIdLessByString() );
+ \endcode
+ */
+class MojoIdLessByString
+{
+public:
+  bool operator()( const MojoId& a, const MojoId& b ) const
+  {
+    const char* a_string = a.AsCString();
+    const char* b_string = b.AsCString();
+    return strcmp( a_string ? a_string : "", b_string ? b_string : "" ) < 0;
+  }
+};
+
 // ---------------------------------------------------------------------------------------------------------------
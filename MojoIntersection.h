@@ -31,7 +31,10 @@
 #include "MojoConstants.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
+#include "MojoBitSet.h"
+#include "MojoSortedSet.h"
 #include "MojoUtil.h"
+#include "MojoProbeOrder.h"
 
 /**
  \class MojoIntersection
@@ -43,6 +46,10 @@
 
  `S = S1 ∩ S2 ∩ S3 ...`
 
+ Contains() tests the inputs that are most likely to rule a key out first, as learned from earlier calls. See
+ MojoProbeOrder. Contains() may be called from several threads at once. The order is learned with atomic
+ operations, so each call does write to the intersection, but does not race.
+
  \image html Set-Intersection.png
  */
 template< typename key_T >
@@ -69,16 +76,30 @@ public:
    */
   MojoIntersection& Add( const MojoAbstractSet< key_T >* s );
   virtual bool Contains( const key_T& key ) const override;
+  /**
+   Test a block of keys against each input in probe order, stopping once no key is left. One key per block is
+   sampled, so the probe order keeps learning. See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
   virtual bool Enumerate( const MojoCollector< key_T >& collector,
                          const MojoAbstractSet< key_T >* limit = NULL ) const override;
   /** \private */
   virtual int _GetEnumerationCost() const override;
   /** \private */
   virtual int _GetChangeCount() const override;
+  /** \private */
+  virtual MojoSetKind _GetKind() const override { return kMojoSetKind_Intersection; }
+  /** \private */
+  virtual int _GetInputCount() const override { return m_SetCount; }
+  /** \private */
+  virtual const MojoAbstractSet< key_T >* _GetInput( int index ) const override { return m_Sets[ index ]; }
   
 private:
   const MojoAbstractSet< key_T >* m_Sets[ kMojoInputSetMax ];
   int                       m_SetCount;
+  mutable MojoProbeOrder    m_ProbeOrder;
+
+  bool ContainsSampled( const key_T& key ) const;
 };
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -90,6 +111,7 @@ MojoIntersection< key_T >::MojoIntersection( const MojoAbstractSet< key_T >* s1,
                                              const MojoAbstractSet< key_T >* s3,
                                              const MojoAbstractSet< key_T >* s4 )
 : m_SetCount( 0 )
+, m_ProbeOrder( false )
 {
   Add( s1 );
   Add( s2 );
@@ -105,6 +127,7 @@ inline MojoIntersection< key_T >& MojoIntersection< key_T >::Add( const MojoAbst
     if( m_SetCount < kMojoInputSetMax )
     {
       m_Sets[ m_SetCount++ ] = s;
+      m_ProbeOrder.Add();
     }
   }
   return *this;
@@ -113,14 +136,57 @@ inline MojoIntersection< key_T >& MojoIntersection< key_T >::Add( const MojoAbst
 template< typename key_T >
 inline bool MojoIntersection< key_T >::Contains( const key_T& key ) const
 {
+  if( m_ProbeOrder.IsSampleDue() )
+  {
+    return ContainsSampled( key );
+  }
+  MojoProbeOrder::Iterator order( m_ProbeOrder );
   for( int i = 0; i < m_SetCount; ++i )
   {
-    if( !m_Sets[ i ]->Contains( key ) )
+    if( !m_Sets[ order.Next() ]->Contains( key ) )
       return false;
   }
   return true;
 }
 
+template< typename key_T >
+bool MojoIntersection< key_T >::ContainsSampled( const key_T& key ) const
+{
+  // Test and time every input, to learn which inputs fail most often for the time they take.
+  bool result = true;
+  for( int i = 0; i < m_SetCount; ++i )
+  {
+    uint64_t start = MojoProbeOrder::GetTicks();
+    bool passed = m_Sets[ i ]->Contains( key );
+    m_ProbeOrder.Record( i, passed, MojoProbeOrder::GetTicks() - start );
+    result = result && passed;
+  }
+  m_ProbeOrder.EndSample();
+  return result;
+}
+
+template< typename key_T >
+void MojoIntersection< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  for( int i = 0; i < count; ++i )
+  {
+    if( MojoMaskTest( mask, i ) )
+    {
+      // If another thread is sampling, the key is tested along with the others.
+      if( m_ProbeOrder.BeginSample() && !ContainsSampled( keys[ i ] ) )
+      {
+        MojoMaskClear( mask, i );
+      }
+      break;
+    }
+  }
+  MojoProbeOrder::Iterator order( m_ProbeOrder );
+  for( int i = 0; i < m_SetCount && !MojoMaskIsEmpty( mask, count ); ++i )
+  {
+    m_Sets[ order.Next() ]->ContainsBatch( keys, count, mask );
+  }
+}
+
 template< typename key_T >
 inline int MojoIntersection< key_T >::_GetEnumerationCost() const
 {
@@ -152,6 +218,15 @@ template< typename key_T >
 inline bool MojoIntersection< key_T >::Enumerate( const MojoCollector< key_T >& collector,
                                                  const MojoAbstractSet< key_T >* limit ) const
 {
+  bool more = true;
+  if( MojoEnumerateWords( kMojoSetKind_Intersection, m_Sets, m_SetCount, collector, limit, &more ) )
+  {
+    return more;
+  }
+  if( MojoEnumerateSorted( m_Sets, m_SetCount, collector, limit, &more ) )
+  {
+    return more;
+  }
   MojoIntersection< key_T > combined_limit;
   
   const MojoAbstractSet< key_T >* smaller = m_Sets[ 0 ];
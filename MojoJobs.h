@@ -0,0 +1,70 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+/**
+ \interface MojoJobs
+ \ingroup group_config
+ Interface to forward parallel work to your own job system.
+ Large operations, such as sorting a large MojoArray, split their work into jobs and hand them to MojoJobs::Run().
+ The internal default implementation runs all jobs one after the other on the calling thread.
+ */
+class MojoJobs
+{
+public:
+  virtual ~MojoJobs() {}
+  /**
+   Run a number of jobs, possibly in parallel, and wait for all of them to finish.
+   \param[in] function Function to call once for each job. Receives the context pointer and the job index.
+   \param[in] context Passed to each call of the function.
+   \param[in] count Number of jobs. Job indices range from 0 to count - 1.
+   */
+  virtual void Run( void ( *function )( void* context, int index ), void* context, int count ) = 0;
+
+  /**
+   Get global default job system.
+   Operations that split up their work will call MojoJobs::GetDefault().
+   You may change the job system that is returned here by setting it through SetDefault().
+   \return The global default job system.
+   */
+  static MojoJobs* GetDefault();
+
+  /**
+   Set global default job system.
+   This will set the job system returned by MojoJobs::GetDefault().
+   \param[in] jobs The new global default job system. If NULL, the internal job system will be used instead. This
+   runs all jobs on the calling thread.
+   */
+  static void SetDefault( MojoJobs* jobs );
+
+private:
+  static MojoJobs* s_Default;
+};
+
+// ---------------------------------------------------------------------------------------------------------------
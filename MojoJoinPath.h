@@ -0,0 +1,513 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "MojoConstants.h"
+#include "MojoUtil.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoSet.h"
+#include "MojoMap.h"
+#include "MojoMultiMap.h"
+#include "MojoOneToOne.h"
+#include "MojoOneToMany.h"
+#include "MojoManyToMany.h"
+
+/**
+ \class MojoJoinPath
+ \ingroup group_function
+ Follows a sequence of maps, starting from the keys in the input set. Equivalent to nested MojoFunction sets:
+
+ `MojoJoinPath( S ).Add( A ).Add( B ).Add( C )` contains the same keys as
+ `MojoFunction( MojoFunction( MojoFunction( S, A ), B ), C )`
+
+ The difference is in evaluation. Each hop is evaluated in full into a temporary set before the next hop starts,
+ so keys that are reached along several paths are followed only once.
+
+ Enumerate() goes forward. For each hop, it either looks up every key of the frontier in the map, or goes over
+ the keys of the map and tests them against the frontier, whichever is smaller.
+
+ Contains() works from both ends. It starts forward from the input set and backward from the key, and each step
+ extends the side that is cheaper to extend, until the two sides meet. A backward step is cheap if an inverse map
+ is given for the hop. Without one, it takes a scan of the map. Inverse maps are included automatically when a
+ relation is added.
+ \note Enumeration does not produce duplicate entries.
+ */
+template< typename key_T >
+class MojoJoinPath final : public MojoAbstractSet< key_T >
+{
+public:
+  /**
+   Constructor. Add hops by calling Add(). Without hops, the join path contains the same keys as the input set.
+   \param[in] input_set Keys to start from.
+   */
+  MojoJoinPath( const MojoAbstractSet< key_T >* input_set = NULL );
+
+  /**
+   Add a hop that follows a map.
+   \param[in] map Map from key to value.
+   \param[in] inverse_map Optional map from value to key. Must contain the same pairs as map.
+   \return *this, for convenient chaining:
+   \code
+   my_set.Add( &map1 ).Add( &map2 ).Add( &map3 );
+   \endcode
+   */
+  MojoJoinPath& Add( const MojoMap< key_T, key_T >* map, const MojoMap< key_T, key_T >* inverse_map = NULL );
+
+  /**
+   Add a hop that follows a map.
+   \param[in] map Map from key to value.
+   \param[in] inverse_multi_map Map from value to keys. Must contain the same pairs as map.
+   \return *this, for convenient chaining.
+   */
+  MojoJoinPath& Add( const MojoMap< key_T, key_T >* map, const MojoMultiMap< key_T, key_T >* inverse_multi_map );
+
+  /**
+   Add a hop that follows a multimap.
+   \param[in] multi_map Map from key to values.
+   \param[in] inverse_map Optional map from value to key. Must contain the same pairs as multi_map.
+   \return *this, for convenient chaining.
+   */
+  MojoJoinPath& Add( const MojoMultiMap< key_T, key_T >* multi_map,
+                    const MojoMap< key_T, key_T >* inverse_map = NULL );
+
+  /**
+   Add a hop that follows a multimap.
+   \param[in] multi_map Map from key to values.
+   \param[in] inverse_multi_map Map from value to keys. Must contain the same pairs as multi_map.
+   \return *this, for convenient chaining.
+   */
+  MojoJoinPath& Add( const MojoMultiMap< key_T, key_T >* multi_map,
+                    const MojoMultiMap< key_T, key_T >* inverse_multi_map );
+
+  /**
+   Add a hop from parent to child.
+   \param[in] relation The relation to follow.
+   \return *this, for convenient chaining.
+   */
+  MojoJoinPath& Add( const MojoOneToOne< key_T, key_T >* relation );
+
+  /**
+   Add a hop from parent to children.
+   \param[in] relation The relation to follow.
+   \return *this, for convenient chaining.
+   */
+  MojoJoinPath& Add( const MojoOneToMany< key_T, key_T >* relation );
+
+  /**
+   Add a hop from parents to children.
+   \param[in] relation The relation to follow.
+   \return *this, for convenient chaining.
+   */
+  MojoJoinPath& Add( const MojoManyToMany< key_T, key_T >* relation );
+
+  virtual bool Contains( const key_T& key ) const override;
+  virtual bool Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+
+private:
+  struct Hop
+  {
+    const MojoMap< key_T, key_T >*      m_Map;
+    const MojoMultiMap< key_T, key_T >* m_MultiMap;
+    const MojoMap< key_T, key_T >*      m_InverseMap;
+    const MojoMultiMap< key_T, key_T >* m_InverseMultiMap;
+
+    const MojoAbstractSet< key_T >* GetKeys() const
+    {
+      return m_Map ? ( const MojoAbstractSet< key_T >* )m_Map : ( const MojoAbstractSet< key_T >* )m_MultiMap;
+    }
+  };
+
+  // Inserts the values of each key into the output set
+  class ForwardCollector final : public MojoCollector< key_T >
+  {
+  public:
+    ForwardCollector( const Hop* hop, MojoSet< key_T >* output )
+    : m_Hop( hop )
+    , m_Output( output )
+    {}
+
+    virtual bool Push( const key_T& key ) const override
+    {
+      if( m_Hop->m_Map )
+      {
+        key_T value = m_Hop->m_Map->Find( key );
+        if( !value.IsHashNull() )
+        {
+          m_Output->Insert( value );
+        }
+      }
+      else
+      {
+        const MojoSet< key_T >* values = m_Hop->m_MultiMap->Find( key );
+        if( values )
+        {
+          key_T value;
+          MojoForEachKey( *values, value )
+          {
+            m_Output->Insert( value );
+          }
+        }
+      }
+      return true;
+    }
+
+  private:
+    const Hop*        m_Hop;
+    MojoSet< key_T >* m_Output;
+  };
+
+  // Inserts each key into the output set if any of its values is in the frontier
+  class BackwardScanCollector final : public MojoCollector< key_T >
+  {
+  public:
+    BackwardScanCollector( const Hop* hop, const MojoSet< key_T >* frontier, MojoSet< key_T >* output )
+    : m_Hop( hop )
+    , m_Frontier( frontier )
+    , m_Output( output )
+    {}
+
+    virtual bool Push( const key_T& key ) const override
+    {
+      if( m_Hop->m_Map )
+      {
+        if( m_Frontier->Contains( m_Hop->m_Map->Find( key ) ) )
+        {
+          m_Output->Insert( key );
+        }
+      }
+      else
+      {
+        const MojoSet< key_T >* values = m_Hop->m_MultiMap->Find( key );
+        if( values && !MojoAreDisjoint< key_T >( values, m_Frontier ) )
+        {
+          m_Output->Insert( key );
+        }
+      }
+      return true;
+    }
+
+  private:
+    const Hop*              m_Hop;
+    const MojoSet< key_T >* m_Frontier;
+    MojoSet< key_T >*       m_Output;
+  };
+
+  const MojoAbstractSet< key_T >* m_InputSet;
+  Hop                             m_Hops[ kMojoInputSetMax ];
+  int                             m_HopCount;
+
+  MojoJoinPath& AddHop( const MojoMap< key_T, key_T >* map, const MojoMultiMap< key_T, key_T >* multi_map,
+                       const MojoMap< key_T, key_T >* inverse_map,
+                       const MojoMultiMap< key_T, key_T >* inverse_multi_map );
+  static void Reset( MojoSet< key_T >* set );
+  static int GetForwardCost( const Hop& hop, const MojoAbstractSet< key_T >* frontier );
+  static int GetBackwardCost( const Hop& hop, const MojoSet< key_T >* frontier );
+  static void StepForward( const Hop& hop, const MojoAbstractSet< key_T >* frontier, MojoSet< key_T >* output );
+  static void StepBackward( const Hop& hop, const MojoSet< key_T >* frontier, MojoSet< key_T >* output );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+MojoJoinPath< key_T >::MojoJoinPath( const MojoAbstractSet< key_T >* input_set )
+: m_InputSet( input_set )
+, m_HopCount( 0 )
+{
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::AddHop( const MojoMap< key_T, key_T >* map,
+                                                    const MojoMultiMap< key_T, key_T >* multi_map,
+                                                    const MojoMap< key_T, key_T >* inverse_map,
+                                                    const MojoMultiMap< key_T, key_T >* inverse_multi_map )
+{
+  if( map || multi_map )
+  {
+    if( m_HopCount < kMojoInputSetMax )
+    {
+      Hop& hop = m_Hops[ m_HopCount++ ];
+      hop.m_Map = map;
+      hop.m_MultiMap = multi_map;
+      hop.m_InverseMap = inverse_map;
+      hop.m_InverseMultiMap = inverse_multi_map;
+    }
+  }
+  return *this;
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoMap< key_T, key_T >* map,
+                                                 const MojoMap< key_T, key_T >* inverse_map )
+{
+  return AddHop( map, NULL, inverse_map, NULL );
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoMap< key_T, key_T >* map,
+                                                 const MojoMultiMap< key_T, key_T >* inverse_multi_map )
+{
+  return AddHop( map, NULL, NULL, inverse_multi_map );
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoMultiMap< key_T, key_T >* multi_map,
+                                                 const MojoMap< key_T, key_T >* inverse_map )
+{
+  return AddHop( NULL, multi_map, inverse_map, NULL );
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoMultiMap< key_T, key_T >* multi_map,
+                                                 const MojoMultiMap< key_T, key_T >* inverse_multi_map )
+{
+  return AddHop( NULL, multi_map, NULL, inverse_multi_map );
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoOneToOne< key_T, key_T >* relation )
+{
+  return AddHop( relation->GetParentToChildMap(), NULL, relation->GetChildToParentMap(), NULL );
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoOneToMany< key_T, key_T >* relation )
+{
+  return AddHop( NULL, relation->GetParentToChildMultiMap(), relation->GetChildToParentMap(), NULL );
+}
+
+template< typename key_T >
+MojoJoinPath< key_T >& MojoJoinPath< key_T >::Add( const MojoManyToMany< key_T, key_T >* relation )
+{
+  return AddHop( NULL, relation->GetParentToChildMultiMap(), NULL, relation->GetChildToParentMultiMap() );
+}
+
+template< typename key_T >
+void MojoJoinPath< key_T >::Reset( MojoSet< key_T >* set )
+{
+  if( set->GetStatus() == kMojoStatus_NotInitialized )
+  {
+    set->Create( "MojoJoinPath" );
+  }
+  else
+  {
+    set->Clear();
+  }
+}
+
+template< typename key_T >
+int MojoJoinPath< key_T >::GetForwardCost( const Hop& hop, const MojoAbstractSet< key_T >* frontier )
+{
+  return MojoMin( frontier->_GetEnumerationCost(), hop.GetKeys()->_GetEnumerationCost() );
+}
+
+template< typename key_T >
+int MojoJoinPath< key_T >::GetBackwardCost( const Hop& hop, const MojoSet< key_T >* frontier )
+{
+  if( hop.m_InverseMap || hop.m_InverseMultiMap )
+  {
+    return frontier->GetCount();
+  }
+  return hop.GetKeys()->_GetEnumerationCost();
+}
+
+template< typename key_T >
+void MojoJoinPath< key_T >::StepForward( const Hop& hop, const MojoAbstractSet< key_T >* frontier,
+                                         MojoSet< key_T >* output )
+{
+  const MojoAbstractSet< key_T >* keys = hop.GetKeys();
+  if( frontier->_GetEnumerationCost() <= keys->_GetEnumerationCost() )
+  {
+    frontier->Enumerate( ForwardCollector( &hop, output ), keys );
+  }
+  else
+  {
+    keys->Enumerate( ForwardCollector( &hop, output ), frontier );
+  }
+}
+
+template< typename key_T >
+void MojoJoinPath< key_T >::StepBackward( const Hop& hop, const MojoSet< key_T >* frontier,
+                                          MojoSet< key_T >* output )
+{
+  key_T value;
+  if( hop.m_InverseMap )
+  {
+    MojoForEachKey( *frontier, value )
+    {
+      key_T key = hop.m_InverseMap->Find( value );
+      if( !key.IsHashNull() )
+      {
+        output->Insert( key );
+      }
+    }
+  }
+  else if( hop.m_InverseMultiMap )
+  {
+    MojoForEachKey( *frontier, value )
+    {
+      const MojoSet< key_T >* keys = hop.m_InverseMultiMap->Find( value );
+      if( keys )
+      {
+        key_T key;
+        MojoForEachKey( *keys, key )
+        {
+          output->Insert( key );
+        }
+      }
+    }
+  }
+  else
+  {
+    hop.GetKeys()->Enumerate( BackwardScanCollector( &hop, frontier, output ) );
+  }
+}
+
+template< typename key_T >
+bool MojoJoinPath< key_T >::Contains( const key_T& key ) const
+{
+  if( !m_InputSet )
+  {
+    return false;
+  }
+
+  // Walk backward without temporary sets as long as each hop leads back to a single key. This is the common case
+  // for a chain of child-to-parent lookups.
+  int last = m_HopCount;
+  key_T single = key;
+  while( last > 0 && m_Hops[ last - 1 ].m_InverseMap )
+  {
+    single = m_Hops[ last - 1 ].m_InverseMap->Find( single );
+    if( single.IsHashNull() )
+    {
+      return false;
+    }
+    last -= 1;
+  }
+  if( last == 0 )
+  {
+    return m_InputSet->Contains( single );
+  }
+
+  // Extend forward from the input set, or backward from the key, whichever is cheaper. Stop when the two meet.
+  MojoSet< key_T > forward_sets[ 2 ];
+  MojoSet< key_T > backward_sets[ 2 ];
+  const MojoAbstractSet< key_T >* forward = m_InputSet;
+  MojoSet< key_T >* backward = &backward_sets[ 0 ];
+  Reset( backward );
+  backward->Insert( single );
+
+  int first = 0;
+  int forward_step = 0;
+  int backward_step = 1;
+  while( first < last )
+  {
+    const Hop& forward_hop = m_Hops[ first ];
+    const Hop& backward_hop = m_Hops[ last - 1 ];
+    if( GetForwardCost( forward_hop, forward ) <= GetBackwardCost( backward_hop, backward ) )
+    {
+      MojoSet< key_T >* output = &forward_sets[ forward_step++ & 1 ];
+      Reset( output );
+      StepForward( forward_hop, forward, output );
+      forward = output;
+      first += 1;
+      if( !output->GetCount() )
+      {
+        return false;
+      }
+    }
+    else
+    {
+      MojoSet< key_T >* output = &backward_sets[ backward_step++ & 1 ];
+      Reset( output );
+      StepBackward( backward_hop, backward, output );
+      backward = output;
+      last -= 1;
+      if( !output->GetCount() )
+      {
+        return false;
+      }
+    }
+  }
+  return !MojoAreDisjoint< key_T >( forward, backward );
+}
+
+template< typename key_T >
+bool MojoJoinPath< key_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                       const MojoAbstractSet< key_T >* limit ) const
+{
+  if( !m_InputSet )
+  {
+    return true;
+  }
+
+  MojoSet< key_T > sets[ 2 ];
+  const MojoAbstractSet< key_T >* frontier = m_InputSet;
+  for( int i = 0; i < m_HopCount; ++i )
+  {
+    MojoSet< key_T >* output = &sets[ i & 1 ];
+    Reset( output );
+    StepForward( m_Hops[ i ], frontier, output );
+    frontier = output;
+    if( !output->GetCount() )
+    {
+      return true;
+    }
+  }
+  return frontier->Enumerate( collector, limit );
+}
+
+template< typename key_T >
+int MojoJoinPath< key_T >::_GetEnumerationCost() const
+{
+  if( m_HopCount )
+  {
+    return m_Hops[ m_HopCount - 1 ].GetKeys()->_GetEnumerationCost();
+  }
+  return m_InputSet ? m_InputSet->_GetEnumerationCost() : 0;
+}
+
+template< typename key_T >
+int MojoJoinPath< key_T >::_GetChangeCount() const
+{
+  int change_count = m_InputSet ? m_InputSet->_GetChangeCount() : 0;
+  for( int i = 0; i < m_HopCount; ++i )
+  {
+    change_count += m_Hops[ i ].GetKeys()->_GetChangeCount();
+  }
+  return change_count;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
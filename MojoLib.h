@@ -33,7 +33,12 @@
 #include "MojoStatus.h"
 #include "MojoUtil.h"
 #include "MojoAlloc.h"
+#include "MojoArenaAlloc.h"
+#include "MojoPoolAlloc.h"
+#include "MojoTelemetryAlloc.h"
+#include "MojoHugePageAlloc.h"
 #include "MojoConfig.h"
+#include "MojoJobs.h"
 #include "MojoSet.h"
 
 // -- Containers
@@ -42,10 +47,15 @@
 #include "MojoSet.h"
 #include "MojoMap.h"
 #include "MojoMultiMap.h"
+#include "MojoBitSet.h"
+#include "MojoSortedSet.h"
 #include "MojoArray.h"
+#include "MojoSegmentedArray.h"
+#include "MojoRingQueue.h"
 #include "MojoManyToMany.h"
 #include "MojoOneToMany.h"
 #include "MojoOneToOne.h"
+#include "MojoHierarchy.h"
 
 // -- Id
 #include "MojoId.h"
@@ -58,9 +68,13 @@
 #include "MojoUnion.h"
 #include "MojoDifference.h"
 #include "MojoComplement.h"
+#include "MojoProbeOrder.h"
+#include "MojoQueryPlan.h"
 
 // -- Set Functions
 #include "MojoFunction.h"
 #include "MojoFunctionDeep.h"
+#include "MojoTraversal.h"
+#include "MojoJoinPath.h"
 
 // ---------------------------------------------------------------------------------------------------------------
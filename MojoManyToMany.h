@@ -100,6 +100,18 @@ public:
    Remove all entries.
    */
   MojoStatus Clear();
+
+  /**
+   Start a batch of changes. Changes made until the matching EndBatch() take effect immediately, and are seen by
+   anything that depends on this container, but the tables will not shrink until EndBatch(). Batches may be nested.
+   */
+  void BeginBatch();
+
+  /**
+   End a batch of changes started by BeginBatch().
+   \return Status code.
+   */
+  MojoStatus EndBatch();
   
   /**
    Insert relation. If child key already exists in map, its parent will be replaced.
@@ -173,14 +185,14 @@ public:
   virtual ~MojoManyToMany();
 
   const MojoMultiMap< parent_key_T, child_key_T >* GetParentToChildMultiMap() const { return &m_ParentToChild; }
-  const MojoMultiMap< parent_key_T, child_key_T >* GetChildToParentMultiMap() const { return &m_ChildToParent; }
+  const MojoMultiMap< child_key_T, parent_key_T >* GetChildToParentMultiMap() const { return &m_ChildToParent; }
 
   int _GetChangeCount() const { return m_ChildToParent._GetChangeCount() + m_ParentToChild._GetChangeCount(); }
 
 private:
   
   const char*                               m_Name;
-  MojoMultiMap< parent_key_T, child_key_T > m_ChildToParent;  // A child may have only one parent
+  MojoMultiMap< child_key_T, parent_key_T > m_ChildToParent;  // A child may have multiple parents
   MojoMultiMap< parent_key_T, child_key_T > m_ParentToChild;  // A parent may have multiple children
 
   void Init();
@@ -240,6 +252,21 @@ MojoStatus MojoManyToMany< parent_key_T, child_key_T >::Clear()
   return status1 ? status1 : status2;
 }
 
+template< typename parent_key_T, typename child_key_T >
+void MojoManyToMany< parent_key_T, child_key_T >::BeginBatch()
+{
+  m_ParentToChild._BeginBatch();
+  m_ChildToParent._BeginBatch();
+}
+
+template< typename parent_key_T, typename child_key_T >
+MojoStatus MojoManyToMany< parent_key_T, child_key_T >::EndBatch()
+{
+  MojoStatus status1 = m_ParentToChild._EndBatch();
+  MojoStatus status2 = m_ChildToParent._EndBatch();
+  return status1 ? status1 : status2;
+}
+
 template< typename parent_key_T, typename child_key_T >
 MojoStatus MojoManyToMany< parent_key_T, child_key_T >::InsertParentChild( const parent_key_T& parent, const child_key_T& child )
 {
@@ -39,7 +39,6 @@
 #include "MojoAlloc.h"
 #include "MojoConfig.h"
 #include "MojoUtil.h"
-#include "MojoArray.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
 #include "MojoKeyValue.h"
@@ -156,6 +155,12 @@ public:
    */
   virtual bool Contains( const key_T& key ) const override;
 
+  /**
+   Test presence of a block of keys. The table slots for all keys are prefetched before any is probed.
+   See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
+
   /**
    Square bracket operator is an alias for Find()
    */
@@ -174,6 +179,12 @@ public:
    */
   int GetCount() const;
 
+  /**
+   Get number of times the table was resized since creation. Useful to verify that a load factor policy set in
+   MojoConfig keeps the table from growing and shrinking over and over.
+   */
+  int GetResizeCount() const { return m_ResizeCount; }
+
   /**
    Return name of the map.
    \return Given name.
@@ -229,6 +240,19 @@ public:
   /** \private */
   virtual int _GetChangeCount() const override;
 
+  /**
+   Start a batch of changes. Until the matching _EndBatch(), the table will not shrink. Changes take effect, and are
+   counted by _GetChangeCount(), as they are made. Batches may be nested. Used by the relation containers.
+   \private
+   */
+  void _BeginBatch();
+
+  /**
+   End a batch of changes. The table is shrunk to fit.
+   \private
+   */
+  MojoStatus _EndBatch();
+
   virtual ~MojoMap();
 
 private:
@@ -241,11 +265,16 @@ private:
   int                 m_BufferCount;     // Entries allocated
   int                 m_TableCount;     // Portion of the array currently used for hash table
   int                 m_ChangeCount;
+  int                 m_BatchDepth;
+  int                 m_ResizeCount;
+  int                 m_ShrinkWaitCount;  // Removals seen while below minimum load
   MojoStatus          m_Status;
   MojoConfig          m_Config;
 
   void Init();
+  bool AllocatesOnDemand() const { return m_Alloc && m_Config.m_DynamicAlloc && m_Config.m_DynamicTable; }
   int FindEmptyOrMatching( const key_T& key ) const;
+  int FindEmptyOrMatchingFrom( const key_T& key, int start_index ) const;
   int FindEmpty( const key_T& key ) const;
   void Reinsert( int index );
   value_T RemoveOne( const key_T& key );
@@ -272,6 +301,9 @@ void MojoMap< key_T, value_T >::Init()
   m_BufferCount = 0;
   m_ActiveCount = 0;
   m_ChangeCount = 0;
+  m_BatchDepth = 0;
+  m_ResizeCount = 0;
+  m_ShrinkWaitCount = 0;
   m_Status = kMojoStatus_NotInitialized;
 }
 
@@ -298,7 +330,7 @@ MojoStatus MojoMap< key_T, value_T >::Create( const char* name, const value_T& n
   {
     m_Status = kMojoStatus_DoubleInitialized;
   }
-  else if( config->m_BufferMinCount < kMojoTableMinCount )
+  else if( !config->IsValid() )
   {
     m_Status = kMojoStatus_InvalidArguments;
   }
@@ -319,6 +351,13 @@ MojoStatus MojoMap< key_T, value_T >::Create( const char* name, const value_T& n
       m_BufferCount           = fixed_array_count;
       // Note to self: fixed array is assumed to consist of constructed values. Don't call Construct() here.
     }
+    else if( AllocatesOnDemand() )
+    {
+      // Nothing is allocated until the first insert. Grow() takes care of that.
+      m_BufferCount           = 0;
+      m_Buffer                = NULL;
+      m_TableCount            = 0;
+    }
     else
     {
       m_BufferCount           = m_Config.m_BufferMinCount;
@@ -326,7 +365,7 @@ MojoStatus MojoMap< key_T, value_T >::Create( const char* name, const value_T& n
       m_TableCount            = m_Config.m_DynamicTable ? kMojoTableMinCount : m_BufferCount;
     }
     
-    m_Status = m_Buffer ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
+    m_Status = ( m_Buffer || AllocatesOnDemand() ) ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
   }
   return m_Status;
 }
@@ -350,12 +389,17 @@ void MojoMap< key_T, value_T >::Destroy()
 template< typename key_T, typename value_T >
 MojoStatus MojoMap< key_T, value_T >::Clear()
 {
+  m_ActiveCount = 0;
+  m_ChangeCount += 1;
   for( int i = 0; i < m_TableCount; ++i )
   {
     m_Buffer[ i ] = KeyValue();
   }
-  m_ActiveCount = 0;
-  m_ChangeCount += 1;
+  if( AllocatesOnDemand() )
+  {
+    // Keep the buffer for reuse, up to m_BufferMinCount entries of it. Without a buffer, there is nothing to keep.
+    return m_Buffer ? Resize( MojoMin( m_BufferCount, m_Config.m_BufferMinCount ) ) : m_Status;
+  }
   return Resize( m_Config.m_BufferMinCount );
 }
 
@@ -379,9 +423,10 @@ MojoStatus MojoMap< key_T, value_T >::Insert( const key_T& key, const value_T& v
         {
           m_Buffer[ index ].key = key;
           m_ActiveCount += 1;
-          m_ChangeCount += 1;
         }
         m_Buffer[ index ].value = value;
+        // Overwriting a value counts as a change too. MojoFunction depends on values.
+        m_ChangeCount += 1;
       }
     }
   }
@@ -411,7 +456,7 @@ value_T MojoMap< key_T, value_T >::Remove( const key_T& key )
 template< typename key_T, typename value_T >
 value_T MojoMap< key_T, value_T >::Find( const key_T& key ) const
 {
-  if( !m_Status && !key.IsHashNull() )
+  if( !m_Status && m_ActiveCount && !key.IsHashNull() )
   {
     int index = FindEmptyOrMatching( key );
     if( !m_Buffer[ index ].IsHashNull() )
@@ -425,7 +470,7 @@ value_T MojoMap< key_T, value_T >::Find( const key_T& key ) const
 template< typename key_T, typename value_T >
 value_T* MojoMap< key_T, value_T >::FindForImmediateChange( const key_T& key ) const
 {
-  if( !m_Status && !key.IsHashNull() )
+  if( !m_Status && m_ActiveCount && !key.IsHashNull() )
   {
     int index = FindEmptyOrMatching( key );
     if( !m_Buffer[ index ].IsHashNull() )
@@ -439,7 +484,7 @@ value_T* MojoMap< key_T, value_T >::FindForImmediateChange( const key_T& key ) c
 template< typename key_T, typename value_T >
 bool MojoMap< key_T, value_T >::Contains( const key_T& key ) const
 {
-  if( !m_Status && !key.IsHashNull() )
+  if( !m_Status && m_ActiveCount && !key.IsHashNull() )
   {
     int index = FindEmptyOrMatching( key );
     return !m_Buffer[ index ].IsHashNull();
@@ -447,6 +492,50 @@ bool MojoMap< key_T, value_T >::Contains( const key_T& key ) const
   return false;
 }
 
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  if( m_Status || !m_ActiveCount )
+  {
+    for( int i = 0; i < MojoMaskWordCount( count ); ++i )
+    {
+      mask[ i ] = 0;
+    }
+    return;
+  }
+  int start_indices[ kMojoBatchSize ];
+  for( int base = 0; base < count; base += kMojoBatchSize )
+  {
+    // Hash every key and prefetch its slot, so the cache misses overlap, then probe.
+    int n = MojoMin( count - base, kMojoBatchSize );
+    const key_T* block_keys = keys + base;
+    uint64_t* block_mask = mask + base / 64;
+    for( int i = 0; i < n; ++i )
+    {
+      if( MojoMaskTest( block_mask, i ) )
+      {
+        if( block_keys[ i ].IsHashNull() )
+        {
+          MojoMaskClear( block_mask, i );
+        }
+        else
+        {
+          start_indices[ i ] = ( int )( block_keys[ i ].GetHash() % m_TableCount );
+          MojoPrefetch( &m_Buffer[ start_indices[ i ] ] );
+        }
+      }
+    }
+    for( int i = 0; i < n; ++i )
+    {
+      if( MojoMaskTest( block_mask, i ) &&
+          m_Buffer[ FindEmptyOrMatchingFrom( block_keys[ i ], start_indices[ i ] ) ].IsHashNull() )
+      {
+        MojoMaskClear( block_mask, i );
+      }
+    }
+  }
+}
+
 template< typename key_T, typename value_T >
 int MojoMap< key_T, value_T >::GetCount() const
 {
@@ -497,7 +586,9 @@ value_T MojoMap< key_T, value_T >::_GetValueAt( int index ) const
 template< typename key_T, typename value_T >
 MojoKeyValue< key_T, value_T >* MojoMap< key_T, value_T >::AllocAndConstruct( int new_buffer_count )
 {
-  KeyValue* new_buffer = ( KeyValue* )m_Alloc->Allocate( new_buffer_count * sizeof( KeyValue ), m_Name );
+  // Tables start on a cache line, so a probe sequence touches as few cache lines as possible.
+  KeyValue* new_buffer = ( KeyValue* )m_Alloc->AllocateAligned( new_buffer_count * sizeof( KeyValue ),
+                                                                kMojoCacheLineSize, m_Name );
   if( new_buffer )
   {
     for( int i = 0; i < new_buffer_count; ++i )
@@ -513,11 +604,17 @@ void MojoMap< key_T, value_T >::DestructAndFree( KeyValue* old_buffer, int old_b
 {
   if( old_buffer )
   {
-    for( int i = 0; i < old_buffer_count; ++i )
+    if( !MojoIsTriviallyDestructible< KeyValue >::value )
+    {
+      for( int i = 0; i < old_buffer_count; ++i )
+      {
+        old_buffer[ i ].~KeyValue();
+      }
+    }
+    if( !m_Alloc->IsArena() )
     {
-      old_buffer[ i ].~KeyValue();
+      m_Alloc->FreeAligned( old_buffer );
     }
-    m_Alloc->Free( old_buffer );
   }
 }
 
@@ -566,6 +663,10 @@ MojoStatus MojoMap< key_T, value_T >::Resize( int new_table_count )
   {
     return m_Status;
   }
+  if( m_TableCount && new_table_count != m_TableCount )
+  {
+    m_ResizeCount += 1;
+  }
   
   bool must_realloc = ( new_table_count > m_BufferCount ) ||
   ( m_BufferCount > m_Config.m_BufferMinCount && m_Config.m_DynamicAlloc );
@@ -595,6 +696,10 @@ MojoStatus MojoMap< key_T, value_T >::Resize( int new_table_count )
     m_ActiveCount = 0;
     CopyTable( old_buffer, old_table_count );
     DestructAndFree( old_buffer, old_table_count );
+    if( old_buffer )
+    {
+      m_Alloc->NotifyResize( m_Name );
+    }
   }
   else
   {
@@ -614,7 +719,12 @@ MojoStatus MojoMap< key_T, value_T >::Resize( int new_table_count )
 template< typename key_T, typename value_T >
 int MojoMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key ) const
 {
-  int start_index = key.GetHash() % m_TableCount;
+  return FindEmptyOrMatchingFrom( key, ( int )( key.GetHash() % m_TableCount ) );
+}
+
+template< typename key_T, typename value_T >
+int MojoMap< key_T, value_T >::FindEmptyOrMatchingFrom( const key_T& key, int start_index ) const
+{
 
   // Look forward to the end of the key array
   for( int i = start_index; i < m_TableCount; ++i )
@@ -681,7 +791,7 @@ void MojoMap< key_T, value_T >::Reinsert( int index )
 template< typename key_T, typename value_T >
 value_T MojoMap< key_T, value_T >::RemoveOne( const key_T& key )
 {
-  if( key.IsHashNull() )
+  if( key.IsHashNull() || !m_ActiveCount )
   {
     return m_NotFoundValue;
   }
@@ -723,8 +833,13 @@ value_T MojoMap< key_T, value_T >::RemoveOne( const key_T& key )
 template< typename key_T, typename value_T >
 MojoStatus MojoMap< key_T, value_T >::Grow()
 {
+  if( !m_TableCount )
+  {
+    // First insert into an empty container.
+    return Resize( kMojoBufferInitialCount );
+  }
   // Make more room if table is getting crowded
-  if( m_ActiveCount * 100 >= m_TableCount * kMojoTableGrowThreshold )
+  if( m_ActiveCount * 100 >= m_TableCount * m_Config.m_MaxLoadPercent )
   {
     int new_size = m_TableCount * 2;
     if( !m_Config.m_DynamicAlloc && m_TableCount < m_BufferCount )
@@ -740,39 +855,59 @@ MojoStatus MojoMap< key_T, value_T >::Grow()
 template< typename key_T, typename value_T >
 MojoStatus MojoMap< key_T, value_T >::Shrink()
 {
-  // Shrink if it's getting too empty
-  if( m_Config.m_DynamicTable && m_TableCount > kMojoTableMinCount
-     && m_ActiveCount * 100 < m_TableCount * kMojoTableShrinkThreshold )
+  // Shrink if it's getting too empty. Not during a batch: _EndBatch() will take care of it, possibly halving the
+  // table more than once.
+  if( m_BatchDepth )
+  {
+    return kMojoStatus_Ok;
+  }
+  int new_table_count = m_TableCount;
+  while( m_Config.m_DynamicTable && new_table_count > kMojoTableMinCount
+        && m_ActiveCount * 100 < new_table_count * m_Config.m_MinLoadPercent )
+  {
+    new_table_count /= 2;
+  }
+  if( new_table_count == m_TableCount )
   {
-    return Resize( m_TableCount / 2 );
+    m_ShrinkWaitCount = 0;
+  }
+  else if( ++m_ShrinkWaitCount > m_Config.m_ShrinkDelay )
+  {
+    m_ShrinkWaitCount = 0;
+    return Resize( new_table_count );
   }
   return kMojoStatus_Ok;
 }
 
 template< typename key_T, typename value_T >
-bool MojoMap< key_T, value_T >::Enumerate( const MojoCollector< key_T >& collector,
-                                          const MojoAbstractSet< key_T >* limit ) const
+void MojoMap< key_T, value_T >::_BeginBatch()
+{
+  m_BatchDepth += 1;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoMap< key_T, value_T >::_EndBatch()
 {
-  bool more = true;
-  if( limit )
+  if( m_BatchDepth > 0 && --m_BatchDepth == 0 )
   {
-    for( int i = _GetFirstIndex(); more && _IsIndexValid( i ); i = _GetNextIndex( i ) )
-    {
-      key_T key = _GetKeyAt( i );
-      if( limit->Contains( key ) )
-      {
-        more = collector.Push( key );
-      }
-    }
+    return Shrink();
   }
-  else
+  return m_Status;
+}
+
+template< typename key_T, typename value_T >
+bool MojoMap< key_T, value_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                          const MojoAbstractSet< key_T >* limit ) const
+{
+  MojoEnumerationBatch< key_T > batch( collector, limit );
+  for( int i = _GetFirstIndex(); _IsIndexValid( i ); i = _GetNextIndex( i ) )
   {
-    for( int i = _GetFirstIndex(); more && _IsIndexValid( i ); i = _GetNextIndex( i ) )
+    if( !batch.Add( _GetKeyAt( i ) ) )
     {
-      more = collector.Push( _GetKeyAt( i ) );
+      return false;
     }
   }
-  return more;
+  return batch.Flush();
 }
 
 template< typename key_T, typename value_T >
@@ -39,9 +39,11 @@
 
 #include "MojoConfig.h"
 #include "MojoUtil.h"
-#include "MojoArray.h"
 #include "MojoAbstractSet.h"
 #include "MojoKeyValue.h"
+#include "MojoSet.h"
+#include "MojoMap.h"
+#include "MojoArray.h"
 
 /**
  \class MojoMultiMap
@@ -190,6 +192,19 @@ public:
   virtual int _GetEnumerationCost() const override;
   /** \private */
   virtual int _GetChangeCount() const override;
+
+  /**
+   Start a batch of changes. See MojoMap::_BeginBatch(). The value set of each key is batched as well, from the
+   first change to it until the end of the batch.
+   \private
+   */
+  void _BeginBatch();
+
+  /**
+   End a batch of changes. See MojoMap::_EndBatch().
+   \private
+   */
+  MojoStatus _EndBatch();
   
   virtual ~MojoMultiMap();
 
@@ -200,12 +215,15 @@ private:
   value_T             m_NotFoundValue;
 
   MojoMap< key_T, MojoSet< value_T >* > m_Map;
+  MojoArray< key_T >  m_BatchedKeys;      // Keys of the value sets that are in a batch
 
   int                 m_ChangeCount;
+  int                 m_BatchDepth;
   MojoStatus          m_Status;
   MojoConfig          m_Config;
 
   void                Init();
+  void                BatchSet( const key_T& key, MojoSet< value_T >* set );
 };
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -217,6 +235,7 @@ void MojoMultiMap< key_T, value_T >::Init()
   m_Alloc = NULL;
   m_Name = NULL;
   m_ChangeCount = 0;
+  m_BatchDepth = 0;
   m_Status = kMojoStatus_NotInitialized;
 }
 
@@ -242,7 +261,7 @@ MojoStatus MojoMultiMap< key_T, value_T >::Create( const char* name, const value
   {
     m_Status = kMojoStatus_DoubleInitialized;
   }
-  else if( config->m_BufferMinCount < kMojoTableMinCount )
+  else if( !config->IsValid() )
   {
     m_Status = kMojoStatus_InvalidArguments;
   }
@@ -253,6 +272,10 @@ MojoStatus MojoMultiMap< key_T, value_T >::Create( const char* name, const value
     m_Config          = *config;
 
     m_Status = m_Map.Create( __FUNCTION__, NULL, config, alloc );
+    if( !m_Status )
+    {
+      m_Status = m_BatchedKeys.Create( __FUNCTION__, key_T(), config, alloc );
+    }
   }
   return m_Status;
 }
@@ -266,32 +289,48 @@ MojoMultiMap< key_T, value_T >::~MojoMultiMap()
 template< typename key_T, typename value_T >
 void MojoMultiMap< key_T, value_T >::Destroy()
 {
-  key_T key;
-  MojoForEachKey( m_Map, key )
+  // Sets in an arena need not be visited, unless their values need destruction.
+  if( !m_Alloc || !m_Alloc->IsArena() || !MojoIsTriviallyDestructible< value_T >::value )
   {
-    MojoSet< value_T >* set = m_Map.Find( key );
-    set->Destroy();
-    set->~MojoSet< value_T >();
-    m_Alloc->Free( set );
+    key_T key;
+    MojoForEachKey( m_Map, key )
+    {
+      MojoSet< value_T >* set = m_Map.Find( key );
+      set->Destroy();
+      set->~MojoSet< value_T >();
+      if( !m_Alloc->IsArena() )
+      {
+        m_Alloc->Free( set );
+      }
+    }
   }
 
   m_Map.Destroy();
+  m_BatchedKeys.Destroy();
   Init();
 }
 
 template< typename key_T, typename value_T >
 MojoStatus MojoMultiMap< key_T, value_T >::Clear()
 {
-  key_T key;
-  MojoForEachKey( m_Map, key )
+  // Sets in an arena need not be visited, unless their values need destruction.
+  if( !m_Alloc || !m_Alloc->IsArena() || !MojoIsTriviallyDestructible< value_T >::value )
   {
-    MojoSet< value_T >* set = m_Map.Find( key );
-    set->Destroy();
-    set->~MojoSet< value_T >();
-    m_Alloc->Free( set );
+    key_T key;
+    MojoForEachKey( m_Map, key )
+    {
+      MojoSet< value_T >* set = m_Map.Find( key );
+      set->Destroy();
+      set->~MojoSet< value_T >();
+      if( !m_Alloc->IsArena() )
+      {
+        m_Alloc->Free( set );
+      }
+    }
   }
 
   m_ChangeCount += 1;
+  m_BatchedKeys.Clear();
   return m_Map.Clear();
 }
 
@@ -325,6 +364,7 @@ MojoStatus MojoMultiMap< key_T, value_T >::Insert( const key_T& key, const value
       if( set )
       {
         m_ChangeCount += 1;
+        BatchSet( key, set );
         set->Insert( value );
       }
     }
@@ -347,7 +387,10 @@ MojoStatus MojoMultiMap< key_T, value_T >::Remove( const key_T& key )
       m_ChangeCount += 1;
       set->Destroy();
       set->~MojoSet< value_T >();
-      m_Alloc->Free( set );
+      if( !m_Alloc->IsArena() )
+      {
+        m_Alloc->Free( set );
+      }
       return kMojoStatus_Ok;
     }
   }
@@ -367,6 +410,7 @@ MojoStatus MojoMultiMap< key_T, value_T >::Remove( const key_T& key, const value
     if( set )
     {
       m_ChangeCount += 1;
+      BatchSet( key, set );
       MojoStatus status = set->Remove( value );
       if( set->GetCount() == 0 )
       {
@@ -406,7 +450,7 @@ bool MojoMultiMap< key_T, value_T >::Contains( const key_T& key, const value_T&
     const MojoSet< value_T >* set = m_Map.Find( key );
     if( set )
     {
-      return set->Find( value );
+      return set->Contains( value );
     }
   }
   return false;
@@ -449,5 +493,44 @@ int MojoMultiMap< key_T, value_T >::_GetChangeCount() const
   return m_ChangeCount;
 }
 
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::_BeginBatch()
+{
+  m_BatchDepth += 1;
+  m_Map._BeginBatch();
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoMultiMap< key_T, value_T >::_EndBatch()
+{
+  MojoStatus status = kMojoStatus_Ok;
+  if( m_BatchDepth > 0 && --m_BatchDepth == 0 )
+  {
+    // A set may have been removed since, or removed and made again. Only the sets still in a batch are ended.
+    for( int i = 0; i < m_BatchedKeys.GetCount(); ++i )
+    {
+      MojoSet< value_T >* set = m_Map.Find( m_BatchedKeys[ i ] );
+      if( set && set->_IsInBatch() )
+      {
+        MojoStatus set_status = set->_EndBatch();
+        status = status ? status : set_status;
+      }
+    }
+    m_BatchedKeys.Clear();
+  }
+  MojoStatus map_status = m_Map._EndBatch();
+  return status ? status : map_status;
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::BatchSet( const key_T& key, MojoSet< value_T >* set )
+{
+  if( m_BatchDepth && !set->_IsInBatch() )
+  {
+    set->_BeginBatch();
+    m_BatchedKeys.Push( key );
+  }
+}
+
 // ---------------------------------------------------------------------------------------------------------------
 
@@ -100,6 +100,18 @@ public:
    Remove all entries.
    */
   MojoStatus Clear();
+
+  /**
+   Start a batch of changes. Changes made until the matching EndBatch() take effect immediately, and are seen by
+   anything that depends on this container, but the tables will not shrink until EndBatch(). Batches may be nested.
+   */
+  void BeginBatch();
+
+  /**
+   End a batch of changes started by BeginBatch().
+   \return Status code.
+   */
+  MojoStatus EndBatch();
   
   /**
    Insert relation. If child key already exists in map, its parent will be replaced.
@@ -173,14 +185,14 @@ public:
   virtual ~MojoOneToMany();
 
   const MojoMultiMap< parent_key_T, child_key_T >* GetParentToChildMultiMap() const { return &m_ParentToChild; }
-  const MojoMap< parent_key_T, child_key_T >* GetChildToParentMap()           const { return &m_ChildToParent; }
+  const MojoMap< child_key_T, parent_key_T >* GetChildToParentMap()           const { return &m_ChildToParent; }
 
   int _GetChangeCount() const { return m_ChildToParent._GetChangeCount() + m_ParentToChild._GetChangeCount(); }
 
 private:
   
   const char*                               m_Name;
-  MojoMap< parent_key_T, child_key_T >      m_ChildToParent;  // A child may have only one parent
+  MojoMap< child_key_T, parent_key_T >      m_ChildToParent;  // A child may have only one parent
   MojoMultiMap< parent_key_T, child_key_T > m_ParentToChild;  // A parent may have multiple children
 
   void Init();
@@ -240,6 +252,21 @@ MojoStatus MojoOneToMany< parent_key_T, child_key_T >::Clear()
   return status1 ? status1 : status2;
 }
 
+template< typename parent_key_T, typename child_key_T >
+void MojoOneToMany< parent_key_T, child_key_T >::BeginBatch()
+{
+  m_ParentToChild._BeginBatch();
+  m_ChildToParent._BeginBatch();
+}
+
+template< typename parent_key_T, typename child_key_T >
+MojoStatus MojoOneToMany< parent_key_T, child_key_T >::EndBatch()
+{
+  MojoStatus status1 = m_ParentToChild._EndBatch();
+  MojoStatus status2 = m_ChildToParent._EndBatch();
+  return status1 ? status1 : status2;
+}
+
 template< typename parent_key_T, typename child_key_T >
 MojoStatus MojoOneToMany< parent_key_T, child_key_T >::InsertParentChild( const parent_key_T& parent, const child_key_T& child )
 {
@@ -254,7 +281,16 @@ MojoStatus MojoOneToMany< parent_key_T, child_key_T >::InsertParentChild( const
   }
   else
   {
-    RemoveChild( child );
+    // Overwrite the child's parent in place, rather than removing and reinserting the child.
+    parent_key_T old_parent = m_ChildToParent.Find( child );
+    if( old_parent == parent )
+    {
+      return kMojoStatus_Ok;
+    }
+    if( !old_parent.IsHashNull() )
+    {
+      m_ParentToChild.Remove( old_parent, child );
+    }
     status = m_ChildToParent.Insert( child, parent );
     if( !status )
     {
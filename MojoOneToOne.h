@@ -100,6 +100,19 @@ public:
    Remove all entries.
    */
   MojoStatus Clear();
+
+  /**
+   Start a batch of changes. Changes made until the matching EndBatch() take effect immediately, but the tables
+   will not shrink, and the change count moves only once, at EndBatch(). A MojoCacheSet that depends on this
+   container will see a single change for the whole batch. Batches may be nested.
+   */
+  void BeginBatch();
+
+  /**
+   End a batch of changes started by BeginBatch().
+   \return Status code.
+   */
+  MojoStatus EndBatch();
   
   /**
    Insert relation. If child key already exists in map, its parent will be replaced.
@@ -173,7 +186,7 @@ public:
   virtual ~MojoOneToOne();
 
   const MojoMap< parent_key_T, child_key_T >* GetParentToChildMap() const { return &m_ParentToChild; }
-  const MojoMap< parent_key_T, child_key_T >* GetChildToParentMap() const { return &m_ChildToParent; }
+  const MojoMap< child_key_T, parent_key_T >* GetChildToParentMap() const { return &m_ChildToParent; }
 
   int _GetChangeCount() const { return m_ChildToParent._GetChangeCount() + m_ParentToChild._GetChangeCount(); }
 
@@ -240,6 +253,21 @@ MojoStatus MojoOneToOne< parent_key_T, child_key_T >::Clear()
   return status1 ? status1 : status2;
 }
 
+template< typename parent_key_T, typename child_key_T >
+void MojoOneToOne< parent_key_T, child_key_T >::BeginBatch()
+{
+  m_ParentToChild._BeginBatch();
+  m_ChildToParent._BeginBatch();
+}
+
+template< typename parent_key_T, typename child_key_T >
+MojoStatus MojoOneToOne< parent_key_T, child_key_T >::EndBatch()
+{
+  MojoStatus status1 = m_ParentToChild._EndBatch();
+  MojoStatus status2 = m_ChildToParent._EndBatch();
+  return status1 ? status1 : status2;
+}
+
 template< typename parent_key_T, typename child_key_T >
 MojoStatus MojoOneToOne< parent_key_T, child_key_T >::InsertParentChild( const parent_key_T& parent, const child_key_T& child )
 {
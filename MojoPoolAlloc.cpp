@@ -0,0 +1,506 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Standard Libs
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+
+#include "MojoPoolAlloc.h"
+
+// Smallest size class is 32 bytes.
+static const int kMinSizeShift = 5;
+
+// An entry in the region table holds the address of a region, the size class plus one, and a flag on the first
+// region of each slab.
+static const uintptr_t kRegionMask = ~( uintptr_t )( kMojoPoolSlabSize - 1 );
+static const uintptr_t kClassMask = 0xFF;
+static const uintptr_t kSlabStartFlag = 0x100;
+
+// Pools that have not been destroyed, so that a thread that ends knows which pools can take its blocks back.
+static std::atomic_flag s_LiveLock = ATOMIC_FLAG_INIT;
+static MojoPoolAlloc* s_LivePools = NULL;   // Guarded by s_LiveLock
+static uint64_t s_NextPoolId = 1;           // Guarded by s_LiveLock
+
+static void Lock( std::atomic_flag* lock )
+{
+  while( lock->test_and_set( std::memory_order_acquire ) )
+  {
+  }
+}
+
+static void Unlock( std::atomic_flag* lock )
+{
+  lock->clear( std::memory_order_release );
+}
+
+static int GetSizeClass( size_t byte_count )
+{
+  int size_class = 0;
+  while( ( ( size_t )1 << ( size_class + kMinSizeShift ) ) < byte_count )
+  {
+    size_class += 1;
+  }
+  return size_class;
+}
+
+// Number of blocks of a size class that a thread keeps before it returns half of them to the depot.
+static int GetCacheLimit( int size_class )
+{
+  int limit = kMojoPoolCacheSize >> ( size_class + kMinSizeShift );
+  return limit < 2 ? 2 : limit;
+}
+
+static size_t HashRegion( uintptr_t region )
+{
+  return ( size_t )( ( ( uint64_t )region / kMojoPoolSlabSize * 0x9E3779B97F4A7C15ull ) >> 32 );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+struct MojoPoolAlloc::ThreadCacheFlusher
+{
+  ThreadCacheFlusher( ThreadCache* caches, bool* is_flushed )
+  : m_Caches( caches )
+  , m_IsFlushed( is_flushed )
+  {}
+  ~ThreadCacheFlusher()
+  {
+    // Holding the lock keeps the pools alive until their blocks are back.
+    Lock( &s_LiveLock );
+    for( int i = 0; i < kThreadSlotCount; ++i )
+    {
+      ThreadCache* cache = &m_Caches[ i ];
+      if( cache->m_Pool && IsLive( cache->m_Pool, cache->m_PoolId ) )
+      {
+        for( int j = 0; j < kClassCount; ++j )
+        {
+          cache->m_Pool->ReturnToDepot( &cache->m_Free[ j ], j, cache->m_Free[ j ].m_Count );
+        }
+      }
+      cache->m_Pool = NULL;
+    }
+    Unlock( &s_LiveLock );
+    *m_IsFlushed = true;
+  }
+  ThreadCache*  m_Caches;
+  bool*         m_IsFlushed;
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+
+MojoPoolAlloc::MojoPoolAlloc( MojoAlloc* parent )
+{
+  m_Parent = parent ? parent : MojoAlloc::GetDefault();
+  m_Regions.store( NULL );
+  m_RegionCount = 0;
+  m_SlabByteCount.store( 0 );
+  m_ParentLock.clear();
+  m_DepotLock.clear();
+  for( int i = 0; i < kClassCount; ++i )
+  {
+    m_Depot[ i ].m_Head = NULL;
+    m_Depot[ i ].m_Count = 0;
+  }
+  Lock( &s_LiveLock );
+  m_Id = s_NextPoolId++;
+  m_NextLive = s_LivePools;
+  s_LivePools = this;
+  Unlock( &s_LiveLock );
+}
+
+MojoPoolAlloc::~MojoPoolAlloc()
+{
+  // Threads that end from now on leave this pool alone. Their free lists for it are dropped with the slabs.
+  Lock( &s_LiveLock );
+  MojoPoolAlloc** link = &s_LivePools;
+  while( *link != this )
+  {
+    link = &( *link )->m_NextLive;
+  }
+  *link = m_NextLive;
+  Unlock( &s_LiveLock );
+
+  RegionTable* table = m_Regions.load( std::memory_order_relaxed );
+  if( table )
+  {
+    for( size_t i = 0; i < table->m_Capacity; ++i )
+    {
+      uintptr_t entry = table->m_Entries[ i ].load( std::memory_order_relaxed );
+      if( entry & kSlabStartFlag )
+      {
+        m_Parent->FreeAligned( ( void* )( entry & kRegionMask ) );
+      }
+    }
+  }
+  while( table )
+  {
+    RegionTable* retired = table->m_Retired;
+    m_Parent->Free( table );
+    table = retired;
+  }
+}
+
+void* MojoPoolAlloc::Allocate( size_t byte_count, const char* name )
+{
+  if( byte_count > ( size_t )kMojoPoolMaxSize )
+  {
+    Lock( &m_ParentLock );
+    void* block = m_Parent->Allocate( byte_count, name );
+    Unlock( &m_ParentLock );
+    return block;
+  }
+
+  int size_class = GetSizeClass( byte_count );
+  ThreadCache* cache = GetThreadCache();
+  FreeList depot_only = { NULL, 0 };
+  FreeList* list = cache ? &cache->m_Free[ size_class ] : &depot_only;
+  Node* node = list->m_Head;
+  if( !node )
+  {
+    // Without free lists of its own, the thread goes to the depot for every block.
+    node = TakeFromDepot( list, size_class, cache ? GetCacheLimit( size_class ) / 2 : 1 );
+    if( !node )
+    {
+      return NULL;
+    }
+  }
+  list->m_Head = node->m_Next;
+  list->m_Count -= 1;
+  return node;
+}
+
+void MojoPoolAlloc::Free( void* p )
+{
+  if( !p )
+  {
+    return;
+  }
+  int size_class = FindSizeClass( p );
+  if( size_class < 0 )
+  {
+    Lock( &m_ParentLock );
+    m_Parent->Free( p );
+    Unlock( &m_ParentLock );
+    return;
+  }
+  FreeBlock( ( Node* )p, size_class );
+}
+
+void* MojoPoolAlloc::Reallocate( void* p, size_t, size_t new_byte_count, const char* )
+{
+  // The block can be reused if the new size falls in the same size class. Otherwise the caller allocates and copies.
+  if( p && new_byte_count <= ( size_t )kMojoPoolMaxSize )
+  {
+    int size_class = FindSizeClass( p );
+    if( size_class >= 0 && GetSizeClass( new_byte_count ) == size_class )
+    {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+void* MojoPoolAlloc::AllocateAligned( size_t byte_count, size_t alignment, const char* name )
+{
+  // A block is aligned to its size class, so a size class at least as large as the alignment is all it takes.
+  size_t size = byte_count > alignment ? byte_count : alignment;
+  if( size <= ( size_t )kMojoPoolMaxSize )
+  {
+    return Allocate( size, name );
+  }
+  Lock( &m_ParentLock );
+  void* block = m_Parent->AllocateAligned( byte_count, alignment, name );
+  Unlock( &m_ParentLock );
+  return block;
+}
+
+void MojoPoolAlloc::FreeAligned( void* p )
+{
+  if( !p )
+  {
+    return;
+  }
+  int size_class = FindSizeClass( p );
+  if( size_class < 0 )
+  {
+    Lock( &m_ParentLock );
+    m_Parent->FreeAligned( p );
+    Unlock( &m_ParentLock );
+    return;
+  }
+  FreeBlock( ( Node* )p, size_class );
+}
+
+bool MojoPoolAlloc::IsLive( const MojoPoolAlloc* pool, uint64_t pool_id )
+{
+  // Called with s_LiveLock locked. A new pool at the address of a destroyed one has a different id.
+  for( const MojoPoolAlloc* live = s_LivePools; live; live = live->m_NextLive )
+  {
+    if( live == pool )
+    {
+      return live->m_Id == pool_id;
+    }
+  }
+  return false;
+}
+
+int MojoPoolAlloc::FindSizeClass( const void* p ) const
+{
+  uintptr_t region = ( uintptr_t )p & kRegionMask;
+  const RegionTable* table = m_Regions.load( std::memory_order_acquire );
+  if( table )
+  {
+    size_t mask = table->m_Capacity - 1;
+    for( size_t i = HashRegion( region ) & mask; ; i = ( i + 1 ) & mask )
+    {
+      uintptr_t entry = table->m_Entries[ i ].load( std::memory_order_acquire );
+      if( !entry )
+      {
+        break;
+      }
+      if( ( entry & kRegionMask ) == region )
+      {
+        return ( int )( entry & kClassMask ) - 1;
+      }
+    }
+  }
+  return -1;
+}
+
+bool MojoPoolAlloc::AddSlab( char* slab, size_t slab_size, int size_class )
+{
+  // Called with m_ParentLock locked. The table is kept at most half full.
+  size_t region_count = slab_size / kMojoPoolSlabSize;
+  RegionTable* table = m_Regions.load( std::memory_order_relaxed );
+  if( !table || ( m_RegionCount + region_count ) * 2 > table->m_Capacity )
+  {
+    size_t capacity = table ? table->m_Capacity * 2 : 64;
+    while( ( m_RegionCount + region_count ) * 2 > capacity )
+    {
+      capacity *= 2;
+    }
+    RegionTable* grown = ( RegionTable* )m_Parent->Allocate( sizeof( RegionTable ) +
+                                                            ( capacity - 1 ) * sizeof( std::atomic< uintptr_t > ),
+                                                            "MojoPoolAlloc" );
+    if( !grown )
+    {
+      return false;
+    }
+    // The old table is kept until the pool is destroyed, as other threads may still be reading it.
+    grown->m_Retired = table;
+    grown->m_Capacity = capacity;
+    for( size_t i = 0; i < capacity; ++i )
+    {
+      new( &grown->m_Entries[ i ] ) std::atomic< uintptr_t >( 0 );
+    }
+    size_t old_capacity = table ? table->m_Capacity : 0;
+    for( size_t i = 0; i < old_capacity; ++i )
+    {
+      uintptr_t entry = table->m_Entries[ i ].load( std::memory_order_relaxed );
+      if( entry )
+      {
+        size_t j = HashRegion( entry & kRegionMask ) & ( capacity - 1 );
+        while( grown->m_Entries[ j ].load( std::memory_order_relaxed ) )
+        {
+          j = ( j + 1 ) & ( capacity - 1 );
+        }
+        grown->m_Entries[ j ].store( entry, std::memory_order_relaxed );
+      }
+    }
+    m_Regions.store( grown, std::memory_order_release );
+    table = grown;
+  }
+
+  for( size_t i = 0; i < region_count; ++i )
+  {
+    uintptr_t region = ( uintptr_t )slab + i * kMojoPoolSlabSize;
+    size_t j = HashRegion( region ) & ( table->m_Capacity - 1 );
+    while( table->m_Entries[ j ].load( std::memory_order_relaxed ) )
+    {
+      j = ( j + 1 ) & ( table->m_Capacity - 1 );
+    }
+    table->m_Entries[ j ].store( region | ( size_class + 1 ) | ( i ? 0 : kSlabStartFlag ), std::memory_order_release );
+  }
+  m_RegionCount += region_count;
+  return true;
+}
+
+MojoPoolAlloc::ThreadCache* MojoPoolAlloc::GetThreadCache()
+{
+  // The free lists are plain data, so they can still be looked at while the thread ends, after the flusher ran.
+  static thread_local ThreadCache t_Caches[ kThreadSlotCount ];
+  static thread_local bool t_IsFlushed = false;
+  static thread_local ThreadCacheFlusher t_Flusher( t_Caches, &t_IsFlushed );
+  if( t_IsFlushed )
+  {
+    return NULL;
+  }
+
+  ThreadCache* free_slot = NULL;
+  for( int i = 0; i < kThreadSlotCount; ++i )
+  {
+    if( t_Caches[ i ].m_PoolId == m_Id )
+    {
+      return &t_Caches[ i ];
+    }
+    if( !free_slot && !t_Caches[ i ].m_Pool )
+    {
+      free_slot = &t_Caches[ i ];
+    }
+  }
+  if( !free_slot )
+  {
+    // All slots are taken. Reclaim the slots of pools that are gone. Their blocks went with the pool.
+    Lock( &s_LiveLock );
+    for( int i = 0; i < kThreadSlotCount; ++i )
+    {
+      if( !IsLive( t_Caches[ i ].m_Pool, t_Caches[ i ].m_PoolId ) )
+      {
+        t_Caches[ i ].m_Pool = NULL;
+        free_slot = free_slot ? free_slot : &t_Caches[ i ];
+      }
+    }
+    Unlock( &s_LiveLock );
+    if( !free_slot )
+    {
+      return NULL;
+    }
+  }
+  memset( free_slot, 0, sizeof( ThreadCache ) );
+  free_slot->m_Pool = this;
+  free_slot->m_PoolId = m_Id;
+  return free_slot;
+}
+
+void MojoPoolAlloc::FreeBlock( Node* node, int size_class )
+{
+  ThreadCache* cache = GetThreadCache();
+  if( !cache )
+  {
+    FreeList depot_only = { node, 1 };
+    node->m_Next = NULL;
+    ReturnToDepot( &depot_only, size_class, 1 );
+    return;
+  }
+  FreeList* list = &cache->m_Free[ size_class ];
+  node->m_Next = list->m_Head;
+  list->m_Head = node;
+  list->m_Count += 1;
+  int limit = GetCacheLimit( size_class );
+  if( list->m_Count > limit )
+  {
+    ReturnToDepot( list, size_class, limit / 2 );
+  }
+}
+
+MojoPoolAlloc::Node* MojoPoolAlloc::TakeFromDepot( FreeList* list, int size_class, int count )
+{
+  Lock( &m_DepotLock );
+  FreeList* depot = &m_Depot[ size_class ];
+  if( depot->m_Head || Refill( size_class ) )
+  {
+    // Move the first count blocks over as one chain, so they keep their order.
+    Node* first = depot->m_Head;
+    Node* last = first;
+    int moved_count = 1;
+    while( moved_count < count && last->m_Next )
+    {
+      last = last->m_Next;
+      moved_count += 1;
+    }
+    depot->m_Head = last->m_Next;
+    depot->m_Count -= moved_count;
+    last->m_Next = list->m_Head;
+    list->m_Head = first;
+    list->m_Count += moved_count;
+  }
+  Unlock( &m_DepotLock );
+  return list->m_Head;
+}
+
+void MojoPoolAlloc::ReturnToDepot( FreeList* list, int size_class, int count )
+{
+  if( !list->m_Head || count <= 0 )
+  {
+    return;
+  }
+  Node* first = list->m_Head;
+  Node* last = first;
+  int moved_count = 1;
+  while( moved_count < count && last->m_Next )
+  {
+    last = last->m_Next;
+    moved_count += 1;
+  }
+  list->m_Head = last->m_Next;
+  list->m_Count -= moved_count;
+
+  Lock( &m_DepotLock );
+  FreeList* depot = &m_Depot[ size_class ];
+  last->m_Next = depot->m_Head;
+  depot->m_Head = first;
+  depot->m_Count += moved_count;
+  Unlock( &m_DepotLock );
+}
+
+bool MojoPoolAlloc::Refill( int size_class )
+{
+  // Called with m_DepotLock locked. Cut a new slab into blocks of the size class. Large classes get more than one
+  // region per slab, so a slab holds at least 4 blocks.
+  size_t block_size = ( size_t )1 << ( size_class + kMinSizeShift );
+  size_t slab_size = block_size * 4 > ( size_t )kMojoPoolSlabSize ? block_size * 4 : ( size_t )kMojoPoolSlabSize;
+
+  Lock( &m_ParentLock );
+  char* slab = ( char* )m_Parent->AllocateAligned( slab_size, kMojoPoolSlabSize, "MojoPoolAlloc" );
+  if( slab && !AddSlab( slab, slab_size, size_class ) )
+  {
+    m_Parent->FreeAligned( slab );
+    slab = NULL;
+  }
+  Unlock( &m_ParentLock );
+  if( !slab )
+  {
+    return false;
+  }
+  m_SlabByteCount.fetch_add( slab_size, std::memory_order_relaxed );
+
+  FreeList* depot = &m_Depot[ size_class ];
+  for( size_t offset = slab_size; offset > 0; )
+  {
+    offset -= block_size;
+    Node* node = ( Node* )( slab + offset );
+    node->m_Next = depot->m_Head;
+    depot->m_Head = node;
+    depot->m_Count += 1;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
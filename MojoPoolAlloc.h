@@ -0,0 +1,156 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoAlloc.h"
+
+/**
+ \class MojoPoolAlloc
+ \ingroup group_config
+ An allocator that recycles blocks of a small set of sizes.
+
+ Container buffers come in few sizes: the table sizes are powers of 2, and many objects share the same value type.
+ When tables grow and shrink, the same sizes are freed and allocated again and again. MojoPoolAlloc rounds every
+ request up to a power of 2 size class, from 32 bytes up to kMojoPoolMaxSize, and keeps a free list per size class.
+ A freed block goes onto its free list, and the next request of the same size class takes it back off.
+
+ New blocks are cut from slabs, taken from the parent allocator at an alignment of kMojoPoolSlabSize. The size class
+ of a block is found from its address, through a table of slabs, so blocks carry no header. A request of exactly a
+ power of 2 bytes fits its size class, and a block is aligned to its size class, so AllocateAligned() costs nothing
+ extra. Slabs are only returned to the parent when the pool is destroyed. Requests larger than kMojoPoolMaxSize go
+ straight to the parent.
+
+ The pool is thread safe. Each thread keeps its own free lists, up to kMojoPoolCacheSize bytes per size class, and
+ needs no lock for them. Surplus blocks go to a shared depot in batches, and an empty free list is refilled from
+ the depot in batches. A block freed on another thread goes to that thread's free lists, and moves back through
+ the depot. When a thread ends, its blocks go to the depot. Calls to the parent allocator are serialized, so the
+ parent need not be thread safe.
+
+ \code
+ MojoPoolAlloc pool;
+ MojoAlloc::SetDefault( &pool );
+ \endcode
+ */
+class MojoPoolAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Constructor. Does not allocate any memory.
+   \param[in] parent Allocator to take slabs from. If omitted, the global default at the time of construction will be
+   used. See documentation for MojoAlloc for details on how to set the global default.
+   */
+  MojoPoolAlloc( MojoAlloc* parent = NULL );
+
+  /**
+   Destructor returns all slabs to the parent allocator. All blocks must have been freed.
+   */
+  virtual ~MojoPoolAlloc();
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  virtual void  Free( void* p ) override;
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name ) override;
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* name ) override;
+  virtual void  FreeAligned( void* p ) override;
+
+  /**
+   Get the number of bytes taken from the parent allocator for slabs.
+   \return Number of bytes.
+   */
+  size_t GetSlabByteCount() const { return m_SlabByteCount.load( std::memory_order_relaxed ); }
+
+private:
+  enum
+  {
+    kClassCount = 12,     // 32 bytes up to 64 KB
+    kThreadSlotCount = 4, // Pools that one thread can keep free lists for
+  };
+
+  struct Node
+  {
+    Node*   m_Next;
+  };
+
+  struct FreeList
+  {
+    Node*   m_Head;
+    int     m_Count;
+  };
+
+  // Free lists of one thread for one pool. m_PoolId tells whether the slot is still in use by that pool.
+  struct ThreadCache
+  {
+    MojoPoolAlloc*  m_Pool;
+    uint64_t        m_PoolId;
+    FreeList        m_Free[ kClassCount ];
+  };
+
+  // Returns the blocks of a thread to the depots when the thread ends.
+  struct ThreadCacheFlusher;
+
+  // Open addressing table of slab regions, kMojoPoolSlabSize bytes each. Each entry holds the address of a region,
+  // and its size class in the low bits. Entries are only added, so it can be read without a lock.
+  struct RegionTable
+  {
+    RegionTable*                  m_Retired;    // Smaller table this one replaced
+    size_t                        m_Capacity;
+    std::atomic< uintptr_t >      m_Entries[ 1 ];
+  };
+
+  // Copying would return the slabs twice.
+  MojoPoolAlloc( const MojoPoolAlloc& );
+  MojoPoolAlloc& operator=( const MojoPoolAlloc& );
+
+  MojoAlloc*                    m_Parent;
+  uint64_t                      m_Id;             // Unique for the life of the process
+  MojoPoolAlloc*                m_NextLive;       // Guarded by the lock on the list of live pools
+  std::atomic< RegionTable* >   m_Regions;
+  size_t                        m_RegionCount;    // Guarded by m_ParentLock
+  std::atomic< size_t >         m_SlabByteCount;
+  std::atomic_flag              m_ParentLock;     // The parent allocator need not be thread safe
+  std::atomic_flag              m_DepotLock;
+  FreeList                      m_Depot[ kClassCount ];
+
+  static bool IsLive( const MojoPoolAlloc* pool, uint64_t pool_id );
+  int FindSizeClass( const void* p ) const;
+  bool AddSlab( char* slab, size_t slab_size, int size_class );
+  ThreadCache* GetThreadCache();
+  void FreeBlock( Node* node, int size_class );
+  Node* TakeFromDepot( FreeList* list, int size_class, int count );
+  void ReturnToDepot( FreeList* list, int size_class, int count );
+  bool Refill( int size_class );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,140 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Standard Libs
+#include <stdint.h>
+#include <chrono>
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+#include "MojoProbeOrder.h"
+
+MojoProbeOrder::MojoProbeOrder( bool stop_on_pass )
+: m_StopOnPass( stop_on_pass )
+, m_Count( 0 )
+, m_Order( 0 )
+, m_SampleCount( 0 )
+{
+  m_SampleLock.clear();
+}
+
+thread_local uint32_t MojoProbeOrder::t_SampleCountdown = kMojoProbeSampleInterval;
+thread_local uint32_t MojoProbeOrder::t_SampleSeed = 2463534242u;
+
+bool MojoProbeOrder::ResetCountdown()
+{
+  // Xorshift. The next sample is between half and one and a half intervals away.
+  t_SampleSeed ^= t_SampleSeed << 13;
+  t_SampleSeed ^= t_SampleSeed >> 17;
+  t_SampleSeed ^= t_SampleSeed << 5;
+  t_SampleCountdown = kMojoProbeSampleInterval / 2 + t_SampleSeed % kMojoProbeSampleInterval;
+  return true;
+}
+
+void MojoProbeOrder::Add()
+{
+  if( m_Count < kMojoInputSetMax )
+  {
+    m_Ranking[ m_Count ] = ( uint8_t )m_Count;
+    m_Passes[ m_Count ] = 0;
+    m_Ticks[ m_Count ] = 0;
+    m_Count += 1;
+    Publish();
+  }
+}
+
+void MojoProbeOrder::Record( int input, bool passed, uint64_t ticks )
+{
+  m_Passes[ input ] += passed;
+  m_Ticks[ input ] += ticks;
+}
+
+void MojoProbeOrder::EndSample()
+{
+  m_SampleCount += 1;
+  if( m_SampleCount >= kMojoProbeReorderInterval )
+  {
+    Reorder();
+  }
+  m_SampleLock.clear( std::memory_order_release );
+}
+
+void MojoProbeOrder::Reorder()
+{
+  // Expected time spent before a decisive test is smallest when inputs are sorted by time per decisive test.
+  // Adding one to both avoids dividing by zero, and keeps inputs that are never decisive in a stable order.
+  double rank[ kMojoInputSetMax ];
+  for( int i = 0; i < m_Count; ++i )
+  {
+    int decisive_count = m_StopOnPass ? m_Passes[ i ] : m_SampleCount - m_Passes[ i ];
+    rank[ i ] = ( double )( m_Ticks[ i ] + 1 ) / ( decisive_count + 1 );
+  }
+
+  // Insertion sort. There are never more than kMojoInputSetMax inputs.
+  for( int i = 1; i < m_Count; ++i )
+  {
+    uint8_t input = m_Ranking[ i ];
+    int j = i;
+    for( ; j > 0 && rank[ m_Ranking[ j - 1 ] ] > rank[ input ]; --j )
+    {
+      m_Ranking[ j ] = m_Ranking[ j - 1 ];
+    }
+    m_Ranking[ j ] = input;
+  }
+
+  // Halve the history, so recent samples weigh more.
+  for( int i = 0; i < m_Count; ++i )
+  {
+    m_Passes[ i ] /= 2;
+    m_Ticks[ i ] /= 2;
+  }
+  m_SampleCount /= 2;
+  Publish();
+}
+
+void MojoProbeOrder::Publish()
+{
+  uint64_t order = 0;
+  for( int i = 0; i < m_Count && i < kLeadMax; ++i )
+  {
+    order |= ( uint64_t )m_Ranking[ i ] << ( i * kLeadBits );
+  }
+  m_Order.store( order, std::memory_order_release );
+}
+
+uint64_t MojoProbeOrder::GetTicks()
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  return __rdtsc();
+#else
+  return ( uint64_t )std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------------------
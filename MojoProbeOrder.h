@@ -0,0 +1,186 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <atomic>
+
+// -- Mojo
+#include "MojoConstants.h"
+
+/**
+ \class MojoProbeOrder
+ \ingroup group_boolean
+ The order in which MojoIntersection and MojoUnion test their inputs in Contains().
+
+ An intersection can stop at the first input that does not contain the key, and a union at the first input that
+ does. Which inputs should go first depends on the data, not on the order in which they were added. On one in
+ kMojoProbeSampleInterval calls, the owner tests every input, and records for each whether it passed, and how long
+ it took. Once kMojoProbeReorderInterval samples are in, the inputs are sorted by time per decisive test, where a
+ decisive test is a fail for an intersection and a pass for a union. Then half the history is dropped, so older
+ samples count for less and less, and the order follows the data when it changes.
+
+ Contains() may be called from several threads at once. Calls are counted per thread, for all owners together, so
+ counting writes no shared memory. The distance between samples varies randomly around kMojoProbeSampleInterval,
+ so a thread that alternates between a few owners still samples each of them. One thread at a time takes samples
+ for an owner; a sample that is due while another thread is sampling is skipped. The new order is published with
+ a single atomic store: the first inputs of the order are packed into one 64-bit value, and the rest follow in
+ index order. An Iterator reads that value once, so it visits every input exactly once, even if the order changes
+ meanwhile.
+ \note Add() is not thread safe. Add all inputs before the owner is queried.
+ \private
+ */
+class MojoProbeOrder final
+{
+  enum
+  {
+    kLeadBits = 5,                  // Bits per input index in the packed order
+    kLeadMax = 64 / kLeadBits,      // Number of inputs in the packed order
+  };
+  static_assert( kMojoInputSetMax <= ( 1 << kLeadBits ), "Input index does not fit in packed order" );
+
+public:
+  /**
+   Constructor.
+   \param[in] stop_on_pass True for a union, which stops at the first pass. False for an intersection, which stops
+   at the first fail.
+   */
+  MojoProbeOrder( bool stop_on_pass );
+
+  /**
+   Append the next input, with index GetCount(), at the end of the order.
+   */
+  void Add();
+
+  /**
+   Get number of inputs.
+   */
+  int GetCount() const { return m_Count; }
+
+  /**
+   Visits every input once, in the order as it was when the iterator was made.
+   */
+  class Iterator final
+  {
+  public:
+    Iterator( const MojoProbeOrder& probe_order )
+    : m_Order( probe_order.m_Order.load( std::memory_order_acquire ) )
+    , m_LeadCount( probe_order.m_Count < kLeadMax ? probe_order.m_Count : kLeadMax )
+    , m_Position( 0 )
+    , m_Index( 0 )
+    , m_Visited( 0 )
+    {}
+
+    /**
+     Get index of the next input to test. Must not be called more than GetCount() times.
+     */
+    int Next()
+    {
+      int input;
+      if( m_Position < m_LeadCount )
+      {
+        input = ( int )( m_Order >> ( m_Position * kLeadBits ) ) & ( ( 1 << kLeadBits ) - 1 );
+      }
+      else
+      {
+        // Past the packed order, inputs follow in index order.
+        while( m_Visited & ( 1u << m_Index ) )
+        {
+          m_Index += 1;
+        }
+        input = m_Index;
+      }
+      m_Position += 1;
+      m_Visited |= 1u << input;
+      return input;
+    }
+
+  private:
+    uint64_t  m_Order;
+    int       m_LeadCount;
+    int       m_Position;
+    int       m_Index;
+    uint32_t  m_Visited;
+  };
+
+  /**
+   Count a call to Contains(), and find out if this call should be sampled. If so, the owner must test every
+   input, call Record() for each, and call EndSample().
+   */
+  bool IsSampleDue()
+  {
+    return --t_SampleCountdown == 0 && ResetCountdown() && BeginSample();
+  }
+
+  /**
+   Start a sample outside of the regular interval. Returns false if another thread is taking a sample. If it
+   returns true, the owner must test every input, call Record() for each, and call EndSample().
+   */
+  bool BeginSample() { return !m_SampleLock.test_and_set( std::memory_order_acquire ); }
+
+  /**
+   Record the outcome of one test during a sample.
+   \param[in] input Index of the input.
+   \param[in] passed Whether the input contained the key.
+   \param[in] ticks Time taken by the test, in GetTicks() units.
+   */
+  void Record( int input, bool passed, uint64_t ticks );
+
+  /**
+   Finish a sample. Reorders the inputs when enough samples are in.
+   */
+  void EndSample();
+
+  /**
+   Get a fast running time stamp, for timing tests. The unit is unspecified, but the same for all calls.
+   */
+  static uint64_t GetTicks();
+
+private:
+  bool                    m_StopOnPass;
+  int                     m_Count;
+  std::atomic_flag        m_SampleLock;
+  std::atomic< uint64_t > m_Order;        // Leading inputs of m_Ranking, packed
+
+  // Guarded by m_SampleLock
+  int       m_SampleCount;
+  uint8_t   m_Ranking[ kMojoInputSetMax ];
+  int       m_Passes[ kMojoInputSetMax ];
+  uint64_t  m_Ticks[ kMojoInputSetMax ];
+
+  static thread_local uint32_t t_SampleCountdown;  // Calls left until the next sample, on this thread
+  static thread_local uint32_t t_SampleSeed;
+
+  static bool ResetCountdown();
+  void Reorder();
+  void Publish();
+};
+
+// ---------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,654 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <limits.h>
+#include <new>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoArray.h"
+
+/**
+ \class MojoQueryPlan
+ \ingroup group_boolean
+ Compiled form of a set expression built from MojoIntersection, MojoUnion, MojoDifference and MojoComplement.
+
+ The boolean sets evaluate an expression by calling into their inputs, which call into their inputs, and so on, for
+ every key. A query plan walks the expression once, and compiles it into a flat list of tests against the leaf sets
+ of the expression. Nested intersections and nested unions are flattened, and complements are pushed down to the
+ leaves, so a test is never more than one virtual call deep. Tests are ordered by the enumeration cost of their
+ sets: for an intersection the smallest set is tested first, since it is the most likely to rule a key out. For
+ enumeration, the plan picks the cheapest set to drive from, and tests all others against the compiled list.
+
+ The plan stores pointers to the expression and its leaves, which must outlive the plan. Call Compile() after
+ changing the structure of the expression. Call Update() now and then to recompile when the sizes of the leaf sets
+ have shifted far enough to make a different order worthwhile.
+ \code
+ MojoIntersection< MojoId > expression( &motorized, &four_wheels, &string_filter );
+ MojoQueryPlan< MojoId > plan( "plan", &expression );
+ plan.Enumerate( MojoArrayCollector< MojoId >( &result ) );
+ \endcode
+ */
+template< typename key_T >
+class MojoQueryPlan final : public MojoAbstractSet< key_T >
+{
+public:
+  /**
+   Default constructor. You must call Create() before the plan is ready for use.
+   */
+  MojoQueryPlan()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the plan. Will also be used for internal memory allocation.
+   \param[in] expression The set expression to compile.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoQueryPlan( const char* name, const MojoAbstractSet< key_T >* expression, MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, expression, alloc );
+  }
+
+  /**
+   Create after default constructor or Destroy(). Compiles the expression.
+   \param[in] name The name of the plan. Will also be used for internal memory allocation.
+   \param[in] expression The set expression to compile.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const MojoAbstractSet< key_T >* expression, MojoAlloc* alloc = NULL );
+
+  /**
+   Free the compiled plan.
+   */
+  void Destroy();
+
+  /**
+   Compile the expression again. Needed after sets were added to any of the boolean sets in the expression.
+   \return Status code.
+   */
+  MojoStatus Compile();
+
+  /**
+   Recompile if the enumeration cost of any set in the plan has changed by more than a factor of
+   kMojoQueryPlanCostRatio since the last compile. Otherwise do nothing.
+   */
+  void Update();
+
+  /**
+   Return plan status state. This is the only way to find out if something went wrong in the default constructor.
+   If Create() was used, the returned status code will be the same.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  /**
+   Return name of the plan.
+   */
+  const char* GetName() const { return m_Name; }
+
+  /**
+   Get number of tests in the compiled plan.
+   */
+  int GetInstructionCount() const { return m_ProgramCount; }
+
+  /**
+   Get number of times the expression was compiled. Useful to verify that Update() doesn't recompile too often.
+   */
+  int GetCompileCount() const { return m_CompileCount; }
+
+  virtual bool Contains( const key_T& key ) const override;
+  virtual bool Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+
+  virtual ~MojoQueryPlan();
+
+private:
+  // Jump targets that end the program, with its result.
+  static const int kTrue  = -1;
+  static const int kFalse = -2;
+
+  // Test a key against a set, and continue at one of two places.
+  struct Instruction
+  {
+    const MojoAbstractSet< key_T >* m_Set;
+    int                             m_OnTrue;
+    int                             m_OnFalse;
+    Instruction() : m_Set( NULL ), m_OnTrue( kFalse ), m_OnFalse( kFalse ) {}
+    bool operator==( const Instruction& other ) const
+    {
+      return m_Set == other.m_Set && m_OnTrue == other.m_OnTrue && m_OnFalse == other.m_OnFalse;
+    }
+  };
+
+  // Input of a flattened intersection or union. Also used to remember the cost of each set at compile time.
+  struct Term
+  {
+    const MojoAbstractSet< key_T >* m_Set;
+    bool                            m_Negate;
+    int                             m_Cost;
+    Term() : m_Set( NULL ), m_Negate( false ), m_Cost( 0 ) {}
+    bool operator==( const Term& other ) const { return m_Set == other.m_Set && m_Negate == other.m_Negate; }
+  };
+
+  // Enumerate a set, keeping the keys that pass the program starting at m_Filter.
+  struct Step
+  {
+    const MojoAbstractSet< key_T >* m_Driver;
+    int                             m_Filter;
+    Step() : m_Driver( NULL ), m_Filter( kTrue ) {}
+    bool operator==( const Step& other ) const
+    {
+      return m_Driver == other.m_Driver && m_Filter == other.m_Filter;
+    }
+  };
+
+  // Passed as limit to the driving sets during enumeration.
+  class Filter final : public MojoAbstractSet< key_T >
+  {
+  public:
+    Filter( const MojoQueryPlan* plan, int entry, const MojoAbstractSet< key_T >* limit )
+    : m_Plan( plan ), m_Entry( entry ), m_Limit( limit )
+    {}
+    virtual bool Contains( const key_T& key ) const override
+    {
+      return m_Plan->Run( m_Entry, key ) && ( !m_Limit || m_Limit->Contains( key ) );
+    }
+    virtual bool Enumerate( const MojoCollector< key_T >&, const MojoAbstractSet< key_T >* ) const override
+    {
+      return false;
+    }
+    virtual int _GetEnumerationCost() const override { return INT_MAX; }
+    virtual int _GetChangeCount() const override { return 0; }
+  private:
+    const MojoQueryPlan*            m_Plan;
+    int                             m_Entry;
+    const MojoAbstractSet< key_T >* m_Limit;
+  };
+
+  enum Connective
+  {
+    kConnective_Leaf,
+    kConnective_And,
+    kConnective_Or
+  };
+
+  const char*                     m_Name;
+  MojoAlloc*                      m_Alloc;
+  const MojoAbstractSet< key_T >* m_Expression;
+  Instruction*                    m_Program;
+  int                             m_ProgramCount;
+  int                             m_Entry;
+  bool                            m_Enumerable;
+  MojoArray< Step >               m_Steps;
+  MojoArray< Term >               m_Leaves;
+  int                             m_CompileCount;
+  MojoStatus                      m_Status;
+
+  void Init();
+  void FreeProgram();
+  bool Run( int pc, const key_T& key ) const;
+  int Emit( MojoArray< Instruction >* code, const MojoAbstractSet< key_T >* set, bool negate, int on_true,
+           int on_false );
+  int EmitTerms( MojoArray< Instruction >* code, const MojoArray< Term >& terms, int count, bool is_and,
+                int on_true, int on_false );
+  void Gather( MojoArray< Term >* terms, const MojoAbstractSet< key_T >* set, bool negate, bool is_and );
+  void PlanEnumeration( MojoArray< Instruction >* code, int entry );
+  void AddLeaf( const MojoAbstractSet< key_T >* set );
+
+  static Connective GetConnective( const MojoAbstractSet< key_T >* set, bool negate );
+  static bool IsInputNegated( MojoSetKind kind, int index );
+  static bool AndTermLess( const Term& a, const Term& b );
+  static bool OrTermLess( const Term& a, const Term& b );
+  static bool IsCostShifted( int old_cost, int new_cost );
+  static int Relocate( int pc, int count ) { return pc < 0 ? pc : count - 1 - pc; }
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::Init()
+{
+  m_Name = NULL;
+  m_Alloc = NULL;
+  m_Expression = NULL;
+  m_Program = NULL;
+  m_ProgramCount = 0;
+  m_Entry = kFalse;
+  m_Enumerable = false;
+  m_CompileCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T >
+MojoStatus MojoQueryPlan< key_T >::Create( const char* name, const MojoAbstractSet< key_T >* expression,
+                                         MojoAlloc* alloc )
+{
+  if( !alloc )
+  {
+    alloc = MojoAlloc::GetDefault();
+  }
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else if( !expression )
+  {
+    m_Status = kMojoStatus_InvalidArguments;
+  }
+  else
+  {
+    m_Name = name;
+    m_Alloc = alloc;
+    m_Expression = expression;
+    m_Steps.Create( name, Step(), NULL, alloc );
+    m_Leaves.Create( name, Term(), NULL, alloc );
+    m_Status = kMojoStatus_Ok;
+    m_Status = Compile();
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoQueryPlan< key_T >::~MojoQueryPlan()
+{
+  Destroy();
+}
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::Destroy()
+{
+  FreeProgram();
+  m_Steps.Destroy();
+  m_Leaves.Destroy();
+  Init();
+}
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::FreeProgram()
+{
+  if( m_Program && !m_Alloc->IsArena() )
+  {
+    m_Alloc->Free( m_Program );
+  }
+  m_Program = NULL;
+  m_ProgramCount = 0;
+}
+
+template< typename key_T >
+MojoStatus MojoQueryPlan< key_T >::Compile()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+
+  m_Steps.Clear();
+  m_Leaves.Clear();
+  FreeProgram();
+  m_CompileCount += 1;
+
+  // The code is emitted back to front, so the continuation of every test is known when the test is emitted.
+  MojoArray< Instruction > code( m_Name, Instruction(), NULL, m_Alloc );
+  int entry = Emit( &code, m_Expression, false, kTrue, kFalse );
+  PlanEnumeration( &code, entry );
+
+  // Reverse into execution order.
+  int count = code.GetCount();
+  if( count )
+  {
+    m_Program = ( Instruction* )m_Alloc->Allocate( count * sizeof( Instruction ), m_Name );
+    if( !m_Program )
+    {
+      m_Status = kMojoStatus_CouldNotAlloc;
+      return m_Status;
+    }
+    for( int i = 0; i < count; ++i )
+    {
+      Instruction instruction = code[ i ];
+      instruction.m_OnTrue = Relocate( instruction.m_OnTrue, count );
+      instruction.m_OnFalse = Relocate( instruction.m_OnFalse, count );
+      new( m_Program + Relocate( i, count ) ) Instruction( instruction );
+    }
+  }
+  m_ProgramCount = count;
+  m_Entry = Relocate( entry, count );
+  for( int i = 0; i < m_Steps.GetCount(); ++i )
+  {
+    Step step = m_Steps[ i ];
+    step.m_Filter = Relocate( step.m_Filter, count );
+    m_Steps.SwapAt( i, step );
+  }
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::Update()
+{
+  if( !m_Status )
+  {
+    for( int i = 0; i < m_Leaves.GetCount(); ++i )
+    {
+      Term leaf = m_Leaves[ i ];
+      if( IsCostShifted( leaf.m_Cost, leaf.m_Set->_GetEnumerationCost() ) )
+      {
+        Compile();
+        return;
+      }
+    }
+  }
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::Run( int pc, const key_T& key ) const
+{
+  while( pc >= 0 )
+  {
+    const Instruction& instruction = m_Program[ pc ];
+    pc = instruction.m_Set->Contains( key ) ? instruction.m_OnTrue : instruction.m_OnFalse;
+  }
+  return pc == kTrue;
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::Contains( const key_T& key ) const
+{
+  return !m_Status && Run( m_Entry, key );
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                       const MojoAbstractSet< key_T >* limit ) const
+{
+  if( m_Status || !m_Enumerable )
+  {
+    return false;
+  }
+  bool more = true;
+  for( int i = 0; more && i < m_Steps.GetCount(); ++i )
+  {
+    Step step = m_Steps[ i ];
+    if( step.m_Filter == kTrue )
+    {
+      more = step.m_Driver->Enumerate( collector, limit );
+    }
+    else if( step.m_Filter != kFalse )
+    {
+      Filter filter( this, step.m_Filter, limit );
+      more = step.m_Driver->Enumerate( collector, &filter );
+    }
+  }
+  return more;
+}
+
+template< typename key_T >
+int MojoQueryPlan< key_T >::_GetEnumerationCost() const
+{
+  if( m_Status || !m_Enumerable )
+  {
+    return INT_MAX;
+  }
+  int cost = 0;
+  for( int i = 0; i < m_Steps.GetCount(); ++i )
+  {
+    // Note: take extra care not to exceed INT_MAX.
+    int temp = m_Steps[ i ].m_Driver->_GetEnumerationCost();
+    cost = ( cost < INT_MAX - temp ) ? cost + temp : INT_MAX;
+  }
+  return cost;
+}
+
+template< typename key_T >
+int MojoQueryPlan< key_T >::_GetChangeCount() const
+{
+  return m_Expression ? m_Expression->_GetChangeCount() : 0;
+}
+
+template< typename key_T >
+int MojoQueryPlan< key_T >::Emit( MojoArray< Instruction >* code, const MojoAbstractSet< key_T >* set, bool negate,
+                                 int on_true, int on_false )
+{
+  Connective connective = GetConnective( set, negate );
+  if( connective == kConnective_Leaf )
+  {
+    AddLeaf( set );
+    Instruction instruction;
+    instruction.m_Set = set;
+    instruction.m_OnTrue = negate ? on_false : on_true;
+    instruction.m_OnFalse = negate ? on_true : on_false;
+    code->Push( instruction );
+    return code->GetCount() - 1;
+  }
+
+  bool is_and = connective == kConnective_And;
+  MojoArray< Term > terms( m_Name, Term(), NULL, m_Alloc );
+  Gather( &terms, set, negate, is_and );
+  if( is_and )
+  {
+    terms.SortBy( AndTermLess );
+  }
+  else
+  {
+    terms.SortBy( OrTermLess );
+  }
+  return EmitTerms( code, terms, terms.GetCount(), is_and, on_true, on_false );
+}
+
+template< typename key_T >
+int MojoQueryPlan< key_T >::EmitTerms( MojoArray< Instruction >* code, const MojoArray< Term >& terms, int count,
+                                      bool is_and, int on_true, int on_false )
+{
+  // An intersection continues with the next term while terms pass, a union while they fail.
+  int next = is_and ? on_true : on_false;
+  for( int i = count - 1; i >= 0; --i )
+  {
+    Term term = terms[ i ];
+    if( is_and )
+    {
+      next = Emit( code, term.m_Set, term.m_Negate, next, on_false );
+    }
+    else
+    {
+      next = Emit( code, term.m_Set, term.m_Negate, on_true, next );
+    }
+  }
+  return next;
+}
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::Gather( MojoArray< Term >* terms, const MojoAbstractSet< key_T >* set, bool negate,
+                                    bool is_and )
+{
+  // Collect the inputs of nested sets that combine their inputs the same way.
+  MojoSetKind kind = set->_GetKind();
+  Connective connective = is_and ? kConnective_And : kConnective_Or;
+  for( int i = 0; i < set->_GetInputCount(); ++i )
+  {
+    Term term;
+    term.m_Set = set->_GetInput( i );
+    term.m_Negate = negate != IsInputNegated( kind, i );
+    if( GetConnective( term.m_Set, term.m_Negate ) == connective )
+    {
+      Gather( terms, term.m_Set, term.m_Negate, is_and );
+    }
+    else
+    {
+      term.m_Cost = term.m_Set->_GetEnumerationCost();
+      terms->Push( term );
+    }
+  }
+}
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::PlanEnumeration( MojoArray< Instruction >* code, int entry )
+{
+  m_Enumerable = false;
+  Connective connective = GetConnective( m_Expression, false );
+  if( connective == kConnective_Leaf )
+  {
+    Step step;
+    step.m_Driver = m_Expression;
+    m_Steps.Push( step );
+    m_Enumerable = m_Expression->_GetEnumerationCost() < INT_MAX;
+    return;
+  }
+
+  MojoArray< Term > terms( m_Name, Term(), NULL, m_Alloc );
+  Gather( &terms, m_Expression, false, connective == kConnective_And );
+  if( connective == kConnective_And )
+  {
+    // Drive from the cheapest set that can be enumerated, and test the rest.
+    terms.SortBy( AndTermLess );
+    if( terms.GetCount() && !terms[ 0 ].m_Negate && terms[ 0 ].m_Cost < INT_MAX )
+    {
+      Step step;
+      step.m_Driver = terms[ 0 ].m_Set;
+      terms.Remove( 0 );
+      if( GetConnective( step.m_Driver, false ) == kConnective_Leaf )
+      {
+        // The program for Contains() tests the same set first. Share the rest of it.
+        step.m_Filter = ( *code )[ entry ].m_OnTrue;
+      }
+      else
+      {
+        step.m_Filter = EmitTerms( code, terms, terms.GetCount(), true, kTrue, kFalse );
+      }
+      AddLeaf( step.m_Driver );
+      m_Steps.Push( step );
+      m_Enumerable = true;
+    }
+  }
+  else
+  {
+    // Drive from each set in turn, skipping keys that were already pushed from an earlier set.
+    terms.SortBy( OrTermLess );
+    MojoArray< Term > earlier( m_Name, Term(), NULL, m_Alloc );
+    m_Enumerable = true;
+    for( int i = 0; i < terms.GetCount(); ++i )
+    {
+      Term term = terms[ i ];
+      if( term.m_Negate || term.m_Cost == INT_MAX )
+      {
+        m_Steps.Clear();
+        m_Enumerable = false;
+        return;
+      }
+      Step step;
+      step.m_Driver = term.m_Set;
+      step.m_Filter = EmitTerms( code, earlier, earlier.GetCount(), true, kTrue, kFalse );
+      AddLeaf( step.m_Driver );
+      m_Steps.Push( step );
+      term.m_Negate = true;
+      earlier.Push( term );
+    }
+  }
+}
+
+template< typename key_T >
+void MojoQueryPlan< key_T >::AddLeaf( const MojoAbstractSet< key_T >* set )
+{
+  Term leaf;
+  leaf.m_Set = set;
+  leaf.m_Cost = set->_GetEnumerationCost();
+  m_Leaves.Push( leaf );
+}
+
+template< typename key_T >
+typename MojoQueryPlan< key_T >::Connective MojoQueryPlan< key_T >::GetConnective( const MojoAbstractSet< key_T >* set,
+                                                                                bool negate )
+{
+  // Negating a set swaps intersection and union, by De Morgan's laws.
+  switch( set->_GetKind() )
+  {
+    case kMojoSetKind_Intersection:
+    case kMojoSetKind_Difference:
+    case kMojoSetKind_Complement:
+      return negate ? kConnective_Or : kConnective_And;
+    case kMojoSetKind_Union:
+      return negate ? kConnective_And : kConnective_Or;
+    default:
+      return kConnective_Leaf;
+  }
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::IsInputNegated( MojoSetKind kind, int index )
+{
+  return ( kind == kMojoSetKind_Difference && index > 0 ) || kind == kMojoSetKind_Complement;
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::AndTermLess( const Term& a, const Term& b )
+{
+  // Test first what is most likely to fail: small sets, then the complements of large sets.
+  if( a.m_Negate != b.m_Negate )
+  {
+    return !a.m_Negate;
+  }
+  return a.m_Negate ? a.m_Cost > b.m_Cost : a.m_Cost < b.m_Cost;
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::OrTermLess( const Term& a, const Term& b )
+{
+  // Test first what is most likely to pass: large sets, then the complements of small sets.
+  if( a.m_Negate != b.m_Negate )
+  {
+    return !a.m_Negate;
+  }
+  return a.m_Negate ? a.m_Cost < b.m_Cost : a.m_Cost > b.m_Cost;
+}
+
+template< typename key_T >
+bool MojoQueryPlan< key_T >::IsCostShifted( int old_cost, int new_cost )
+{
+  int64_t a = ( int64_t )old_cost + 1;
+  int64_t b = ( int64_t )new_cost + 1;
+  return a > b * kMojoQueryPlanCostRatio || b > a * kMojoQueryPlanCostRatio;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
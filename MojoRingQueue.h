@@ -0,0 +1,434 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <atomic>
+#include <new>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoUtil.h"
+
+/**
+ \enum MojoRingQueueMode
+ \ingroup group_container
+ Which threads may use a MojoRingQueue.
+ */
+enum MojoRingQueueMode
+{
+  /// One thread pushes, one other thread pops.
+  kMojoRingQueueMode_SingleProducerSingleConsumer = 0,
+  /// Any number of threads push, any number of threads pop.
+  kMojoRingQueueMode_MultiProducerMultiConsumer,
+};
+
+/**
+ \class MojoRingQueue
+ \ingroup group_container
+ A bounded queue to pass values between threads without locks.
+
+ Values are kept in a ring buffer, like MojoArray. Unlike MojoArray, the capacity is fixed at Create(). It is rounded
+ up to a power of 2. The read and write positions only ever increase, and are masked to find the slot. Push() fails
+ when the queue is full, and Pop() fails when it is empty. Neither ever waits.
+
+ The read position and the write position are on separate cache lines, so producers and consumers don't slow each
+ other down. In single producer single consumer mode, each side also keeps a cached copy of the other side's
+ position, and only reads the shared one when the cached copy says the queue is full or empty. In multi producer
+ multi consumer mode, each slot has a sequence number that tells whether it is ready to be written or to be read,
+ and threads claim positions with compare-and-swap.
+
+ Create() and Destroy() are not thread safe.
+
+ \warning Values are copied on the thread that pushes and on the thread that pops. The reference counts of MojoId
+ are not thread safe. To pass ids, push MojoId::AsUint64(), and keep the MojoId alive on the producing thread, or
+ use MojoId::IncRefCount() and MojoId::DecRefCount() on the main thread.
+ \tparam value_T Value type. Must be default constructible and assignable.
+ */
+template< typename value_T >
+class MojoRingQueue final
+{
+public:
+  /**
+   Default constructor. You must call Create() before the queue is ready for use.
+   */
+  MojoRingQueue()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the queue. Will also be used for memory allocation.
+   \param[in] capacity Maximum number of values in the queue. Rounded up to a power of 2.
+   \param[in] mode Which threads may use the queue.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoRingQueue( const char* name, int capacity,
+                MojoRingQueueMode mode = kMojoRingQueueMode_SingleProducerSingleConsumer, MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, capacity, mode, alloc );
+  }
+
+  /**
+   Create after default constructor or Destroy().
+   \param[in] name The name of the queue. Will also be used for memory allocation.
+   \param[in] capacity Maximum number of values in the queue. Rounded up to a power of 2.
+   \param[in] mode Which threads may use the queue.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, int capacity,
+                    MojoRingQueueMode mode = kMojoRingQueueMode_SingleProducerSingleConsumer,
+                    MojoAlloc* alloc = NULL );
+
+  /**
+   Release all resources. Values still in the queue are destroyed.
+   */
+  void Destroy();
+
+  /**
+   Add a value at the end of the queue.
+   \param[in] value The value to add.
+   \return false if the queue is full, or not initialized.
+   */
+  bool Push( const value_T& value );
+
+  /**
+   Remove the value at the front of the queue.
+   \param[out] value Receives the value.
+   \return false if the queue is empty, or not initialized. The value is not changed.
+   */
+  bool Pop( value_T* value );
+
+  /**
+   Get the number of values in the queue. While other threads push and pop, this is only an estimate.
+   \return Number of values.
+   */
+  int GetCount() const;
+
+  /**
+   Get the maximum number of values in the queue.
+   \return Capacity, as rounded up by Create().
+   */
+  int GetCapacity() const { return ( int )( m_Mask + 1 ); }
+
+  /**
+   Return status state.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  /**
+   Return name of the queue.
+   \return The name.
+   */
+  const char* GetName() const { return m_Name; }
+
+  ~MojoRingQueue();
+
+private:
+  // Copying would share the buffers.
+  MojoRingQueue( const MojoRingQueue& );
+  MojoRingQueue& operator=( const MojoRingQueue& );
+
+  // Set by Create(). Read only while the queue is in use.
+  MojoAlloc*                m_Alloc;
+  const char*               m_Name;
+  value_T*                  m_Values;
+  std::atomic< uint64_t >*  m_Sequences;      // One per slot. Multi producer multi consumer mode only.
+  uint64_t                  m_Mask;           // Capacity - 1
+  MojoRingQueueMode         m_Mode;
+  MojoStatus                m_Status;
+
+  // Written by consumers.
+  alignas( kMojoCacheLineSize ) std::atomic< uint64_t > m_Head;
+  uint64_t                  m_CachedTail;     // Single consumer only
+
+  // Written by producers.
+  alignas( kMojoCacheLineSize ) std::atomic< uint64_t > m_Tail;
+  uint64_t                  m_CachedHead;     // Single producer only
+
+  void Init();
+  bool PushSingle( const value_T& value );
+  bool PopSingle( value_T* value );
+  bool PushMulti( const value_T& value );
+  bool PopMulti( value_T* value );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename value_T >
+void MojoRingQueue< value_T >::Init()
+{
+  m_Alloc = NULL;
+  m_Name = NULL;
+  m_Values = NULL;
+  m_Sequences = NULL;
+  m_Mask = 0;
+  m_Mode = kMojoRingQueueMode_SingleProducerSingleConsumer;
+  m_Status = kMojoStatus_NotInitialized;
+  m_Head.store( 0, std::memory_order_relaxed );
+  m_CachedTail = 0;
+  m_Tail.store( 0, std::memory_order_relaxed );
+  m_CachedHead = 0;
+}
+
+template< typename value_T >
+MojoStatus MojoRingQueue< value_T >::Create( const char* name, int capacity, MojoRingQueueMode mode,
+                                            MojoAlloc* alloc )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    return kMojoStatus_DoubleInitialized;
+  }
+  if( capacity < 1 || capacity > ( 1 << 30 ) )
+  {
+    m_Status = kMojoStatus_InvalidArguments;
+    return m_Status;
+  }
+  if( !alloc )
+  {
+    alloc = MojoAlloc::GetDefault();
+  }
+
+  uint64_t slot_count = 1;
+  while( slot_count < ( uint64_t )capacity )
+  {
+    slot_count *= 2;
+  }
+
+  m_Alloc = alloc;
+  m_Name = name;
+  m_Mode = mode;
+  m_Mask = slot_count - 1;
+
+  m_Values = ( value_T* )m_Alloc->Allocate( slot_count * sizeof( value_T ), m_Name );
+  if( m_Values )
+  {
+    for( uint64_t i = 0; i < slot_count; ++i )
+    {
+      new( m_Values + i ) value_T();
+    }
+  }
+  if( mode == kMojoRingQueueMode_MultiProducerMultiConsumer )
+  {
+    m_Sequences = ( std::atomic< uint64_t >* )m_Alloc->Allocate( slot_count * sizeof( std::atomic< uint64_t > ),
+                                                                m_Name );
+    if( m_Sequences )
+    {
+      // Slot i is ready to be written at position i.
+      for( uint64_t i = 0; i < slot_count; ++i )
+      {
+        new( m_Sequences + i ) std::atomic< uint64_t >( i );
+      }
+    }
+  }
+
+  bool ok = m_Values && ( m_Sequences || mode != kMojoRingQueueMode_MultiProducerMultiConsumer );
+  m_Status = ok ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
+  return m_Status;
+}
+
+template< typename value_T >
+MojoRingQueue< value_T >::~MojoRingQueue()
+{
+  Destroy();
+}
+
+template< typename value_T >
+void MojoRingQueue< value_T >::Destroy()
+{
+  if( m_Values && !MojoIsTriviallyDestructible< value_T >::value )
+  {
+    for( uint64_t i = 0; i <= m_Mask; ++i )
+    {
+      m_Values[ i ].~value_T();
+    }
+  }
+  if( m_Values && !m_Alloc->IsArena() )
+  {
+    m_Alloc->Free( m_Values );
+  }
+  if( m_Sequences && !m_Alloc->IsArena() )
+  {
+    m_Alloc->Free( m_Sequences );
+  }
+  Init();
+}
+
+template< typename value_T >
+bool MojoRingQueue< value_T >::Push( const value_T& value )
+{
+  if( m_Status )
+  {
+    return false;
+  }
+  if( m_Mode == kMojoRingQueueMode_MultiProducerMultiConsumer )
+  {
+    return PushMulti( value );
+  }
+  return PushSingle( value );
+}
+
+template< typename value_T >
+bool MojoRingQueue< value_T >::Pop( value_T* value )
+{
+  if( m_Status )
+  {
+    return false;
+  }
+  if( m_Mode == kMojoRingQueueMode_MultiProducerMultiConsumer )
+  {
+    return PopMulti( value );
+  }
+  return PopSingle( value );
+}
+
+template< typename value_T >
+int MojoRingQueue< value_T >::GetCount() const
+{
+  // Read head first. Tail can only move further ahead, so the difference is never negative.
+  uint64_t head = m_Head.load( std::memory_order_acquire );
+  uint64_t tail = m_Tail.load( std::memory_order_acquire );
+  uint64_t count = tail - head;
+  return ( int )( count > m_Mask + 1 ? m_Mask + 1 : count );
+}
+
+template< typename value_T >
+bool MojoRingQueue< value_T >::PushSingle( const value_T& value )
+{
+  uint64_t tail = m_Tail.load( std::memory_order_relaxed );
+  if( tail - m_CachedHead > m_Mask )
+  {
+    m_CachedHead = m_Head.load( std::memory_order_acquire );
+    if( tail - m_CachedHead > m_Mask )
+    {
+      return false;
+    }
+  }
+  m_Values[ tail & m_Mask ] = value;
+  m_Tail.store( tail + 1, std::memory_order_release );
+  return true;
+}
+
+template< typename value_T >
+bool MojoRingQueue< value_T >::PopSingle( value_T* value )
+{
+  uint64_t head = m_Head.load( std::memory_order_relaxed );
+  if( head == m_CachedTail )
+  {
+    m_CachedTail = m_Tail.load( std::memory_order_acquire );
+    if( head == m_CachedTail )
+    {
+      return false;
+    }
+  }
+  value_T& slot = m_Values[ head & m_Mask ];
+  *value = slot;
+  slot = value_T();
+  m_Head.store( head + 1, std::memory_order_release );
+  return true;
+}
+
+template< typename value_T >
+bool MojoRingQueue< value_T >::PushMulti( const value_T& value )
+{
+  uint64_t tail = m_Tail.load( std::memory_order_relaxed );
+  for( ;; )
+  {
+    uint64_t sequence = m_Sequences[ tail & m_Mask ].load( std::memory_order_acquire );
+    int64_t difference = ( int64_t )( sequence - tail );
+    if( difference == 0 )
+    {
+      // Slot is free. Claim the position. On failure, tail is updated to the current value.
+      if( m_Tail.compare_exchange_weak( tail, tail + 1, std::memory_order_relaxed ) )
+      {
+        break;
+      }
+    }
+    else if( difference < 0 )
+    {
+      // Slot still holds the value from one lap ago.
+      return false;
+    }
+    else
+    {
+      // Another producer claimed this position.
+      tail = m_Tail.load( std::memory_order_relaxed );
+    }
+  }
+  m_Values[ tail & m_Mask ] = value;
+  m_Sequences[ tail & m_Mask ].store( tail + 1, std::memory_order_release );
+  return true;
+}
+
+template< typename value_T >
+bool MojoRingQueue< value_T >::PopMulti( value_T* value )
+{
+  uint64_t head = m_Head.load( std::memory_order_relaxed );
+  for( ;; )
+  {
+    uint64_t sequence = m_Sequences[ head & m_Mask ].load( std::memory_order_acquire );
+    int64_t difference = ( int64_t )( sequence - ( head + 1 ) );
+    if( difference == 0 )
+    {
+      // Slot is written. Claim the position. On failure, head is updated to the current value.
+      if( m_Head.compare_exchange_weak( head, head + 1, std::memory_order_relaxed ) )
+      {
+        break;
+      }
+    }
+    else if( difference < 0 )
+    {
+      // Slot has not been written yet.
+      return false;
+    }
+    else
+    {
+      // Another consumer claimed this position.
+      head = m_Head.load( std::memory_order_relaxed );
+    }
+  }
+  value_T& slot = m_Values[ head & m_Mask ];
+  *value = slot;
+  slot = value_T();
+  // Ready to be written one lap later.
+  m_Sequences[ head & m_Mask ].store( head + m_Mask + 1, std::memory_order_release );
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
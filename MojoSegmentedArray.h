@@ -0,0 +1,733 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <limits.h>
+#include <new>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoStatus.h"
+#include "MojoConfig.h"
+#include "MojoAlloc.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoArray.h"
+
+/**
+ \class MojoSegmentedArray
+ \ingroup group_container
+ An array that can grow and shrink, with the same interface as MojoArray, for very long arrays.
+
+ Elements are stored in segments of kMojoSegmentSize elements, with a directory of segments. Growing at either
+ end adds a segment, and never copies existing elements. Insert() and Remove() in the middle shift elements
+ within one segment, then rotate each following segment by one position. That takes time proportional to
+ kMojoSegmentSize + count / kMojoSegmentSize, rather than count / 2 for MojoArray.
+
+ The address of an element does not change when elements are added or removed at either end. Insert() and
+ Remove() move the elements after the indicated position.
+ \note Memory is allocated a segment at a time. Use MojoArray for short arrays.
+ \tparam value_T Value type.
+ */
+template< typename value_T >
+class MojoSegmentedArray final : public MojoAbstractSet< value_T >
+{
+public:
+  /**
+   Default constructor does not allocate any memory. Array cannot be used until Create() has been called.
+   */
+  MojoSegmentedArray()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor prepares array for use.
+   \param[in] name The name of the array. This will be passed to the allocator.
+   \param[in] not_found_value Value to be returned if index was out of range.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig
+   for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoSegmentedArray( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                     MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, not_found_value, config, alloc );
+  }
+
+  /**
+   Prepare array for use.
+   \param[in] name The name of the array. This will be passed to the allocator.
+   \param[in] not_found_value Value to be returned if index was out of range.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig
+   for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code. Fails if dynamic allocation is disabled in the config.
+   */
+  MojoStatus Create( const char* name, const value_T& not_found_value = value_T(),
+                    const MojoConfig* config = NULL, MojoAlloc* alloc = NULL );
+
+  /**
+   Return array status state. This is the only way to find out if something went wrong in the default constructor.
+   If Create() was used, the returned status code will be the same.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  ~MojoSegmentedArray();
+
+  /**
+   Release all resources.
+   */
+  void Destroy();
+
+  /**
+   Remove all elements from the array.
+   */
+  MojoStatus Clear();
+
+  /**
+   Append value at the end of the array.
+   \param[in] value Value to append.
+   \return Status code.
+   */
+  MojoStatus Push( const value_T& value );
+
+  /**
+   Insert value at the front of the array.
+   This will be the new index 0, and all other elements move up by one position.
+   \param[in] value Value to insert.
+   \return Status code.
+   */
+  MojoStatus Unshift( const value_T& value );
+
+  /**
+   Remove value from the end of the array.
+   \return The removed value. If array was empty the not_found_value will be returned.
+   */
+  value_T Pop();
+
+  /**
+   Remove value from the front of the array.
+   The remaining elements move down by one position.
+   \return The removed value. If array was empty the not_found_value will be returned.
+   */
+  value_T Shift();
+
+  /**
+   Insert element at the indicated position.
+   Elements after the position will shift up by one.
+   \param[in] index The index into the array. May be equal to the count, to append.
+   If index is negative, it is from the end of the array. For example, -1 indicates the last element.
+   \param[in] value The value to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( int index, const value_T& value );
+
+  /**
+   Remove a single element from any point in the array.
+   The elements after will move down by one position.
+   \param[in] index The index into the array.
+   If index is negative, it is from the end of the array. For example, -1 indicates the last element.
+   \return The removed value. If index was out of range, the not_found_value will be returned.
+   */
+  value_T Remove( int index );
+
+  /**
+   Remove multiple elements from any point in the array.
+   The elements after will move down.
+   \param[in] index The index into the array.
+   If index is negative, it is from the end of the array. For example, -1 indicates the last element.
+   \param[in] count the number of elements to remove. If omitted, all elements from `index` to the end of the
+   array will be removed.
+   \return Status code.
+   */
+  MojoStatus RemoveRange( int index, int count = INT_MAX );
+
+  /**
+   Return the number of elements in the array.
+   \return The number of elements in the array.
+   */
+  int GetCount() const { return m_ActiveCount; }
+
+  /**
+   Return a single element.
+   \param[in] index Position in the array.
+   If index is negative, it is from the end of the array. For example, -1 indicates the last element.
+   \return The value at the indicated position. If index was out of range, the not_found_value is returned.
+   */
+  value_T GetAt( int index ) const;
+
+  /**
+   Alias for MojoSegmentedArray::GetAt()
+   */
+  value_T operator[]( int index ) const { return GetAt( index ); }
+
+  /**
+   Return a pointer to a single element. This allows you to change the value in its actual location. The pointer
+   remains valid until the element is removed, or until Insert() or Remove() is called for a position before it.
+   \param[in] index Position in the array.
+   If index is negative, it is from the end of the array. For example, -1 indicates the last element.
+   \return Pointer to the element. NULL if index was out of range.
+   */
+  value_T* GetPointerAt( int index ) const;
+
+  /**
+   Return the name given at creation.
+   \return The name.
+   */
+  const char* GetName() const { return m_Name; }
+
+  /**
+   Test presence of a value.
+   \param[in] value The value to look for.
+   \return true if value is present
+   \warning This is a performance hazard. The array is simply scanned.
+   */
+  virtual bool Contains( const value_T& value ) const override;
+
+  virtual bool Enumerate( const MojoCollector< value_T >& collector,
+                         const MojoAbstractSet< value_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+
+private:
+  struct Segment
+  {
+    int     m_Start;                        // Physical slot of the first logical slot. Segments are ring buffers.
+    value_T m_Values[ kMojoSegmentSize ];
+  };
+
+  MojoAlloc*            m_Alloc;
+  const char*           m_Name;
+  MojoArray< Segment* > m_Segments;
+  value_T               m_NotFoundValue;
+
+  int                   m_Offset;           // Position of element 0 in the first segment
+  int                   m_ActiveCount;
+  int                   m_ChangeCount;
+  MojoStatus            m_Status;
+
+  void Init();
+  MojoStatus AddSegment( bool at_front );
+  void RemoveSegment( bool at_front );
+  void FreeSegment( Segment* segment );
+
+  // Position counts from the start of the first segment, so element index is at position m_Offset + index.
+  value_T& At( int position ) const
+  {
+    return Slot( m_Segments.GetAt( position / kMojoSegmentSize ), position % kMojoSegmentSize );
+  }
+
+  static value_T& Slot( Segment* segment, int slot )
+  {
+    return segment->m_Values[ ( segment->m_Start + slot ) & ( kMojoSegmentSize - 1 ) ];
+  }
+
+  static void ClearSlot( value_T& value )
+  {
+    // Release whatever resources the old value held. Not needed for plain values, which are never read.
+    if( !MojoIsTriviallyCopyable< value_T >::value )
+    {
+      value = value_T();
+    }
+  }
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename value_T >
+void MojoSegmentedArray< value_T >::Init()
+{
+  m_Alloc = NULL;
+  m_Name = NULL;
+  m_Offset = 0;
+  m_ActiveCount = 0;
+  m_ChangeCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::Create( const char* name, const value_T& not_found_value,
+                                                 const MojoConfig* config, MojoAlloc* alloc )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    return m_Status = kMojoStatus_DoubleInitialized;
+  }
+  if( !config )
+  {
+    config = MojoConfig::GetDefault();
+  }
+  if( !alloc )
+  {
+    alloc = MojoAlloc::GetDefault();
+  }
+  if( !config->m_DynamicAlloc )
+  {
+    m_Status = kMojoStatus_InvalidArguments;
+  }
+  else
+  {
+    m_Name          = name;
+    m_Alloc         = alloc;
+    m_NotFoundValue = not_found_value;
+    m_Status        = m_Segments.Create( name, NULL, config, alloc );
+  }
+  return m_Status;
+}
+
+template< typename value_T >
+MojoSegmentedArray< value_T >::~MojoSegmentedArray()
+{
+  Destroy();
+}
+
+template< typename value_T >
+void MojoSegmentedArray< value_T >::Destroy()
+{
+  // Segments in an arena need not be visited, unless their values need destruction.
+  bool visit = m_Alloc && ( !m_Alloc->IsArena() || !MojoIsTriviallyDestructible< value_T >::value );
+  while( visit && m_Segments.GetCount() )
+  {
+    FreeSegment( m_Segments.Pop() );
+  }
+  m_Segments.Destroy();
+  Init();
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::Clear()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  while( m_Segments.GetCount() )
+  {
+    FreeSegment( m_Segments.Pop() );
+  }
+  m_Offset = 0;
+  m_ActiveCount = 0;
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::AddSegment( bool at_front )
+{
+  void* memory = m_Alloc->Allocate( sizeof( Segment ), m_Name );
+  if( !memory )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  Segment* segment = new( memory ) Segment;
+  segment->m_Start = 0;
+  MojoStatus status = at_front ? m_Segments.Unshift( segment ) : m_Segments.Push( segment );
+  if( status )
+  {
+    FreeSegment( segment );
+  }
+  return status;
+}
+
+template< typename value_T >
+void MojoSegmentedArray< value_T >::RemoveSegment( bool at_front )
+{
+  FreeSegment( at_front ? m_Segments.Shift() : m_Segments.Pop() );
+}
+
+template< typename value_T >
+void MojoSegmentedArray< value_T >::FreeSegment( Segment* segment )
+{
+  if( segment )
+  {
+    segment->~Segment();
+    if( !m_Alloc->IsArena() )
+    {
+      m_Alloc->Free( segment );
+    }
+  }
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::Push( const value_T& value )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    int position = m_Offset + m_ActiveCount;
+    if( position == m_Segments.GetCount() * kMojoSegmentSize )
+    {
+      status = AddSegment( false );
+    }
+    if( !status )
+    {
+      At( position ) = value;
+      m_ActiveCount += 1;
+      m_ChangeCount += 1;
+    }
+  }
+  return status;
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::Unshift( const value_T& value )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    if( m_Offset == 0 )
+    {
+      status = AddSegment( true );
+      if( !status )
+      {
+        m_Offset = kMojoSegmentSize;
+      }
+    }
+    if( !status )
+    {
+      m_Offset -= 1;
+      At( m_Offset ) = value;
+      m_ActiveCount += 1;
+      m_ChangeCount += 1;
+    }
+  }
+  return status;
+}
+
+template< typename value_T >
+value_T MojoSegmentedArray< value_T >::Pop()
+{
+  if( !m_ActiveCount || m_Status )
+  {
+    return m_NotFoundValue;
+  }
+  int position = m_Offset + m_ActiveCount - 1;
+  value_T& slot = At( position );
+  value_T value = slot;
+  ClearSlot( slot );
+  m_ActiveCount -= 1;
+  m_ChangeCount += 1;
+  if( position % kMojoSegmentSize == 0 )
+  {
+    // Last segment is now empty
+    RemoveSegment( false );
+    if( !m_Segments.GetCount() )
+    {
+      m_Offset = 0;
+    }
+  }
+  return value;
+}
+
+template< typename value_T >
+value_T MojoSegmentedArray< value_T >::Shift()
+{
+  if( !m_ActiveCount || m_Status )
+  {
+    return m_NotFoundValue;
+  }
+  value_T& slot = At( m_Offset );
+  value_T value = slot;
+  ClearSlot( slot );
+  m_Offset += 1;
+  m_ActiveCount -= 1;
+  m_ChangeCount += 1;
+  if( m_Offset == kMojoSegmentSize )
+  {
+    // First segment is now empty
+    RemoveSegment( true );
+    m_Offset = 0;
+  }
+  return value;
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::Insert( int index, const value_T& value )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  // Negative index means "from the end". Calculate positive equivalent.
+  if( index < 0 )
+  {
+    index += m_ActiveCount;
+  }
+  if( index < 0 || index > m_ActiveCount )
+  {
+    return kMojoStatus_IndexOutOfRange;
+  }
+  if( index == m_ActiveCount )
+  {
+    return Push( value );
+  }
+  if( index == 0 )
+  {
+    return Unshift( value );
+  }
+
+  // Position of the new last element. Make sure there is a segment for it.
+  int end = m_Offset + m_ActiveCount;
+  if( end == m_Segments.GetCount() * kMojoSegmentSize )
+  {
+    MojoStatus status = AddSegment( false );
+    if( status )
+    {
+      return status;
+    }
+  }
+
+  int position = m_Offset + index;
+  int first = position / kMojoSegmentSize;
+  int last = end / kMojoSegmentSize;
+
+  // Rotate the following segments up by one, carrying the last element of the previous segment into the first
+  // slot. Only the start index changes, nothing else is moved.
+  for( int i = last; i > first; --i )
+  {
+    Segment* segment = m_Segments.GetAt( i );
+    segment->m_Start = ( segment->m_Start - 1 ) & ( kMojoSegmentSize - 1 );
+    Slot( segment, 0 ) = Slot( m_Segments.GetAt( i - 1 ), kMojoSegmentSize - 1 );
+  }
+
+  // Shift up within the segment that receives the new value.
+  Segment* segment = m_Segments.GetAt( first );
+  int top = ( first == last ) ? end % kMojoSegmentSize : kMojoSegmentSize - 1;
+  for( int slot = top; slot > position % kMojoSegmentSize; --slot )
+  {
+    Slot( segment, slot ) = Slot( segment, slot - 1 );
+  }
+  Slot( segment, position % kMojoSegmentSize ) = value;
+
+  m_ActiveCount += 1;
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+value_T MojoSegmentedArray< value_T >::Remove( int index )
+{
+  if( m_Status )
+  {
+    return m_NotFoundValue;
+  }
+  // Negative index means "from the end". Calculate positive equivalent.
+  if( index < 0 )
+  {
+    index += m_ActiveCount;
+  }
+  if( index < 0 || index >= m_ActiveCount )
+  {
+    return m_NotFoundValue;
+  }
+  if( index == 0 )
+  {
+    return Shift();
+  }
+  if( index == m_ActiveCount - 1 )
+  {
+    return Pop();
+  }
+
+  // Position of the current last element.
+  int end = m_Offset + m_ActiveCount - 1;
+  int position = m_Offset + index;
+  int first = position / kMojoSegmentSize;
+  int last = end / kMojoSegmentSize;
+  value_T value = At( position );
+
+  // Shift down within the segment that loses the value.
+  Segment* segment = m_Segments.GetAt( first );
+  int top = ( first == last ) ? end % kMojoSegmentSize : kMojoSegmentSize - 1;
+  for( int slot = position % kMojoSegmentSize; slot < top; ++slot )
+  {
+    Slot( segment, slot ) = Slot( segment, slot + 1 );
+  }
+
+  // Carry the first element of each following segment into the last slot of the previous one, and rotate the
+  // segment down by one.
+  for( int i = first + 1; i <= last; ++i )
+  {
+    Segment* next = m_Segments.GetAt( i );
+    Slot( m_Segments.GetAt( i - 1 ), kMojoSegmentSize - 1 ) = Slot( next, 0 );
+    next->m_Start = ( next->m_Start + 1 ) & ( kMojoSegmentSize - 1 );
+  }
+
+  // If segments were rotated, the carried out copy of the first element of the last segment is now in its last slot.
+  if( first == last )
+  {
+    ClearSlot( At( end ) );
+  }
+  else
+  {
+    ClearSlot( Slot( m_Segments.GetAt( last ), kMojoSegmentSize - 1 ) );
+  }
+  m_ActiveCount -= 1;
+  m_ChangeCount += 1;
+  if( end % kMojoSegmentSize == 0 )
+  {
+    // Last segment is now empty
+    RemoveSegment( false );
+  }
+  return value;
+}
+
+template< typename value_T >
+MojoStatus MojoSegmentedArray< value_T >::RemoveRange( int index, int count )
+{
+  if( index >= m_ActiveCount || index < -m_ActiveCount )
+  {
+    return kMojoStatus_IndexOutOfRange;
+  }
+  // Calculate positive index.
+  index = ( index + m_ActiveCount ) % m_ActiveCount;
+  // count == INT_MAX means "to the end"
+  count = MojoMin( count, m_ActiveCount - index );
+  if( m_Status || count <= 0 )
+  {
+    return m_Status;
+  }
+
+  // Close the gap by moving whichever side of the range is shorter, then release the segments it vacated.
+  int tail = m_ActiveCount - index - count;
+  int end = m_Offset + m_ActiveCount;
+  if( tail <= index )
+  {
+    int position = m_Offset + index;
+    for( int i = 0; i < tail; ++i )
+    {
+      At( position + i ) = At( position + count + i );
+    }
+    m_ActiveCount -= count;
+    int segment_count = m_ActiveCount ? ( m_Offset + m_ActiveCount - 1 ) / kMojoSegmentSize + 1 : 0;
+    // Slots in released segments are destroyed with the segment.
+    for( int p = position + tail; p < MojoMin( end, segment_count * kMojoSegmentSize ); ++p )
+    {
+      ClearSlot( At( p ) );
+    }
+    while( m_Segments.GetCount() > segment_count )
+    {
+      RemoveSegment( false );
+    }
+    if( !m_ActiveCount )
+    {
+      m_Offset = 0;
+    }
+  }
+  else
+  {
+    for( int i = index - 1; i >= 0; --i )
+    {
+      At( m_Offset + count + i ) = At( m_Offset + i );
+    }
+    int released = ( m_Offset + count ) / kMojoSegmentSize;
+    for( int p = released * kMojoSegmentSize; p < m_Offset + count; ++p )
+    {
+      ClearSlot( At( p ) );
+    }
+    for( int i = 0; i < released; ++i )
+    {
+      RemoveSegment( true );
+    }
+    m_Offset = ( m_Offset + count ) % kMojoSegmentSize;
+    m_ActiveCount -= count;
+  }
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename value_T >
+value_T MojoSegmentedArray< value_T >::GetAt( int index ) const
+{
+  value_T* value = GetPointerAt( index );
+  return value ? *value : m_NotFoundValue;
+}
+
+template< typename value_T >
+value_T* MojoSegmentedArray< value_T >::GetPointerAt( int index ) const
+{
+  if( !m_Status && index < m_ActiveCount && index >= -m_ActiveCount )
+  {
+    index = ( index + m_ActiveCount ) % m_ActiveCount;
+    return &At( m_Offset + index );
+  }
+  return NULL;
+}
+
+template< typename value_T >
+bool MojoSegmentedArray< value_T >::Contains( const value_T& value ) const
+{
+  for( int i = 0; i < m_ActiveCount; ++i )
+  {
+    if( At( m_Offset + i ) == value )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+template< typename value_T >
+bool MojoSegmentedArray< value_T >::Enumerate( const MojoCollector< value_T >& collector,
+                                              const MojoAbstractSet< value_T >* limit ) const
+{
+  bool more = true;
+  for( int i = 0; more && i < m_ActiveCount; ++i )
+  {
+    const value_T& value = At( m_Offset + i );
+    if( !limit || limit->Contains( value ) )
+    {
+      more = collector.Push( value );
+    }
+  }
+  return more;
+}
+
+template< typename value_T >
+int MojoSegmentedArray< value_T >::_GetEnumerationCost() const
+{
+  return GetCount() / 2;
+}
+
+template< typename value_T >
+int MojoSegmentedArray< value_T >::_GetChangeCount() const
+{
+  return m_ChangeCount;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
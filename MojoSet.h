@@ -39,10 +39,11 @@
 #include "MojoAlloc.h"
 #include "MojoConfig.h"
 #include "MojoUtil.h"
-#include "MojoArray.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
 
+template< typename value_T > class MojoArray;
+
 /**
  \class MojoSet
  \ingroup group_container
@@ -114,6 +115,14 @@ public:
    */
   MojoStatus Insert( const key_T& key );
 
+  /**
+   Replace the contents of the set with the values in an array. The table is sized up front, so it does not have to
+   grow while the values are inserted. Duplicate values in the array are inserted once.
+   \param[in] array Array of values to insert.
+   \return Status code.
+   */
+  MojoStatus FromArray( const MojoArray< key_T >* array );
+
   /**
    Remove key from the set.
    */
@@ -124,6 +133,12 @@ public:
    */
   virtual bool Contains( const key_T& key ) const override;
 
+  /**
+   Test presence of a block of keys. The table slots for all keys are prefetched before any is probed.
+   See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
+
   /**
    Return table status state. This is the only way to find out if something went wrong in the default constructor.
    If Create() was used, the returned status code will be the same.
@@ -136,6 +151,12 @@ public:
    */
   int GetCount() const;
 
+  /**
+   Get number of times the table was resized since creation. Useful to verify that a load factor policy set in
+   MojoConfig keeps the table from growing and shrinking over and over.
+   */
+  int GetResizeCount() const { return m_ResizeCount; }
+
   /**
    Return name of the set.
    */
@@ -177,6 +198,29 @@ public:
   virtual int _GetEnumerationCost() const override;
   /** \private */
   virtual int _GetChangeCount() const override;
+  /** \private */
+  virtual bool _GetChangeLogPosition( uint64_t* position ) const override;
+  /** \private */
+  virtual bool _GetChangesSince( uint64_t position, const MojoCollector< key_T >& collector ) const override;
+
+  /**
+   Start a batch of changes. Until the matching _EndBatch(), the table will not shrink. Changes take effect, and are
+   counted by _GetChangeCount(), as they are made. Batches may be nested. Used by the relation containers.
+   \private
+   */
+  void _BeginBatch();
+
+  /**
+   End a batch of changes. The table is shrunk to fit.
+   \private
+   */
+  MojoStatus _EndBatch();
+
+  /**
+   Test whether a batch of changes is in progress. See _BeginBatch().
+   \private
+   */
+  bool _IsInBatch() const { return m_BatchDepth > 0; }
 
   virtual ~MojoSet();
 
@@ -189,13 +233,23 @@ private:
   int                 m_ActiveCount;    // Number of key/values assigned
   int                 m_TableCount;     // Portion of the array currently used for hash table
   int                 m_ChangeCount;
+  int                 m_BatchDepth;
+  int                 m_ResizeCount;
+  int                 m_ShrinkWaitCount;  // Removals seen while below minimum load
+  key_T*              m_ChangeLog;        // Ring of m_Config.m_ChangeLogCount inserted or removed keys
+  uint64_t            m_ChangeLogStart;   // Oldest log position that is still available
+  uint64_t            m_ChangeLogEnd;     // Number of changes logged so far
   MojoStatus          m_Status;
   MojoConfig          m_Config;
   
   void Init();
+  bool AllocatesOnDemand() const { return m_Alloc && m_Config.m_DynamicAlloc && m_Config.m_DynamicTable; }
   int FindEmptyOrMatching( const key_T& key ) const;
+  int FindEmptyOrMatchingFrom( const key_T& key, int start_index ) const;
   int FindEmpty( const key_T& key ) const;
   void Reinsert( int index );
+  void LogChange( const key_T& key );
+  void ForgetChanges();
   bool RemoveOne( const key_T& key );
   
   MojoStatus Shrink();
@@ -230,6 +284,14 @@ public:
     m_Set->Insert( value );
     return true;
   }
+  virtual bool PushBatch( const value_T* values, int count ) const override
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      m_Set->Insert( values[ i ] );
+    }
+    return true;
+  }
 private:
   MojoSet< value_T >* m_Set;
 };
@@ -244,6 +306,12 @@ void MojoSet< key_T >::Init()
   m_BufferCount = 0;
   m_ActiveCount = 0;
   m_ChangeCount = 0;
+  m_BatchDepth = 0;
+  m_ResizeCount = 0;
+  m_ShrinkWaitCount = 0;
+  m_ChangeLog = NULL;
+  m_ChangeLogStart = 0;
+  m_ChangeLogEnd = 0;
   m_Status = kMojoStatus_NotInitialized;
 }
 
@@ -269,7 +337,7 @@ MojoStatus MojoSet< key_T >::Create( const char* name, const MojoConfig* config,
   {
     m_Status = kMojoStatus_DoubleInitialized;
   }
-  else if( config->m_BufferMinCount < kMojoTableMinCount )
+  else if( !config->IsValid() )
   {
     m_Status = kMojoStatus_InvalidArguments;
   }
@@ -283,12 +351,20 @@ MojoStatus MojoSet< key_T >::Create( const char* name, const MojoConfig* config,
     {
       m_Config.m_DynamicAlloc = false;
       m_Config.m_BufferMinCount = fixed_array_count;
+      m_Config.m_ChangeLogCount = 0;
       m_Alloc                 = NULL; // Destroy relies on this to not free memory.
 
       m_Buffer                = fixed_array;
       m_BufferCount           = fixed_array_count;
       // Note to self: fixed array is assumed to consist of constructed values. Don't call Construct() here.
     }
+    else if( AllocatesOnDemand() )
+    {
+      // Nothing is allocated until the first insert. Grow() takes care of that.
+      m_BufferCount           = 0;
+      m_Buffer                = NULL;
+      m_TableCount            = 0;
+    }
     else
     {
       m_BufferCount           = m_Config.m_BufferMinCount;
@@ -296,7 +372,7 @@ MojoStatus MojoSet< key_T >::Create( const char* name, const MojoConfig* config,
       m_TableCount            = m_Config.m_DynamicTable ? kMojoTableMinCount : m_BufferCount;
     }
 
-    m_Status = m_Buffer ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
+    m_Status = ( m_Buffer || AllocatesOnDemand() ) ? kMojoStatus_Ok : kMojoStatus_CouldNotAlloc;
   }
   return m_Status;
 }
@@ -313,6 +389,7 @@ void MojoSet< key_T >::Destroy()
   if( m_Alloc )
   {
     DestructAndFree( m_Buffer, m_BufferCount );
+    DestructAndFree( m_ChangeLog, m_Config.m_ChangeLogCount );
   }
   Init();
 }
@@ -320,12 +397,18 @@ void MojoSet< key_T >::Destroy()
 template< typename key_T >
 MojoStatus MojoSet< key_T >::Clear()
 {
+  m_ActiveCount = 0;
+  m_ChangeCount += 1;
+  ForgetChanges();
   for( int i = 0; i < m_TableCount; ++i )
   {
     m_Buffer[ i ] = key_T();
   }
-  m_ActiveCount = 0;
-  m_ChangeCount += 1;
+  if( AllocatesOnDemand() )
+  {
+    // Keep the buffer for reuse, up to m_BufferMinCount entries of it. Without a buffer, there is nothing to keep.
+    return m_Buffer ? Resize( MojoMin( m_BufferCount, m_Config.m_BufferMinCount ) ) : m_Status;
+  }
   return Resize( m_Config.m_BufferMinCount );
 }
 
@@ -350,6 +433,7 @@ MojoStatus MojoSet< key_T >::Insert( const key_T& key )
           m_Buffer[ index ] = key;
           m_ActiveCount += 1;
           m_ChangeCount += 1;
+          LogChange( key );
         }
       }
     }
@@ -357,6 +441,41 @@ MojoStatus MojoSet< key_T >::Insert( const key_T& key )
   return status;
 }
 
+template< typename key_T >
+MojoStatus MojoSet< key_T >::FromArray( const MojoArray< key_T >* array )
+{
+  MojoStatus status = Clear();
+  if( !status )
+  {
+    _BeginBatch();
+    int count = array->GetCount();
+    int new_table_count = m_TableCount ? m_TableCount : kMojoBufferInitialCount;
+    while( m_Config.m_DynamicTable && count * 100 >= new_table_count * m_Config.m_MaxLoadPercent )
+    {
+      new_table_count *= 2;
+    }
+    if( count && new_table_count != m_TableCount )
+    {
+      status = Resize( new_table_count );
+    }
+    MojoSpan< const key_T > spans[ 2 ];
+    array->GetSpans( &spans[ 0 ], &spans[ 1 ] );
+    for( int s = 0; s < 2; ++s )
+    {
+      for( int i = 0; i < spans[ s ].m_Count && !status; ++i )
+      {
+        status = Insert( spans[ s ].m_Values[ i ] );
+      }
+    }
+    MojoStatus end_status = _EndBatch();
+    if( !status )
+    {
+      status = end_status;
+    }
+  }
+  return status;
+}
+
 template< typename key_T >
 MojoStatus MojoSet< key_T >::Remove( const key_T& key )
 {
@@ -369,6 +488,7 @@ MojoStatus MojoSet< key_T >::Remove( const key_T& key )
     if( RemoveOne( key ) )
     {
       m_ChangeCount += 1;
+      LogChange( key );
       Shrink();
       return kMojoStatus_Ok;
     }
@@ -379,7 +499,7 @@ MojoStatus MojoSet< key_T >::Remove( const key_T& key )
 template< typename key_T >
 bool MojoSet< key_T >::Contains( const key_T& key ) const
 {
-  if( !m_Status && !key.IsHashNull() )
+  if( !m_Status && m_ActiveCount && !key.IsHashNull() )
   {
     int index = FindEmptyOrMatching( key );
     return !m_Buffer[ index ].IsHashNull();
@@ -387,6 +507,50 @@ bool MojoSet< key_T >::Contains( const key_T& key ) const
   return false;
 }
 
+template< typename key_T >
+void MojoSet< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  if( m_Status || !m_ActiveCount )
+  {
+    for( int i = 0; i < MojoMaskWordCount( count ); ++i )
+    {
+      mask[ i ] = 0;
+    }
+    return;
+  }
+  int start_indices[ kMojoBatchSize ];
+  for( int base = 0; base < count; base += kMojoBatchSize )
+  {
+    // Hash every key and prefetch its slot, so the cache misses overlap, then probe.
+    int n = MojoMin( count - base, kMojoBatchSize );
+    const key_T* block_keys = keys + base;
+    uint64_t* block_mask = mask + base / 64;
+    for( int i = 0; i < n; ++i )
+    {
+      if( MojoMaskTest( block_mask, i ) )
+      {
+        if( block_keys[ i ].IsHashNull() )
+        {
+          MojoMaskClear( block_mask, i );
+        }
+        else
+        {
+          start_indices[ i ] = ( int )( block_keys[ i ].GetHash() % m_TableCount );
+          MojoPrefetch( &m_Buffer[ start_indices[ i ] ] );
+        }
+      }
+    }
+    for( int i = 0; i < n; ++i )
+    {
+      if( MojoMaskTest( block_mask, i ) &&
+          m_Buffer[ FindEmptyOrMatchingFrom( block_keys[ i ], start_indices[ i ] ) ].IsHashNull() )
+      {
+        MojoMaskClear( block_mask, i );
+      }
+    }
+  }
+}
+
 template< typename key_T >
 int MojoSet< key_T >::GetCount() const
 {
@@ -431,7 +595,9 @@ key_T MojoSet< key_T >::_GetKeyAt( int index ) const
 template< typename key_T >
 key_T* MojoSet< key_T >::AllocAndConstruct( int new_buffer_count )
 {
-  key_T* new_buffer = ( key_T* )m_Alloc->Allocate( new_buffer_count * sizeof( key_T ), m_Name );
+  // Tables start on a cache line, so a probe sequence touches as few cache lines as possible.
+  key_T* new_buffer = ( key_T* )m_Alloc->AllocateAligned( new_buffer_count * sizeof( key_T ), kMojoCacheLineSize,
+                                                          m_Name );
   if( new_buffer )
   {
     for( int i = 0; i < new_buffer_count; ++i )
@@ -447,11 +613,17 @@ void MojoSet< key_T >::DestructAndFree( key_T* old_buffer, int old_buffer_count
 {
   if( old_buffer )
   {
-    for( int i = 0; i < old_buffer_count; ++i )
+    if( !MojoIsTriviallyDestructible< key_T >::value )
+    {
+      for( int i = 0; i < old_buffer_count; ++i )
+      {
+        old_buffer[ i ].~key_T();
+      }
+    }
+    if( !m_Alloc->IsArena() )
     {
-      old_buffer[ i ].~key_T();
+      m_Alloc->FreeAligned( old_buffer );
     }
-    m_Alloc->Free( old_buffer );
   }
 }
 
@@ -500,6 +672,10 @@ MojoStatus MojoSet< key_T >::Resize( int new_table_count )
   {
     return m_Status;
   }
+  if( m_TableCount && new_table_count != m_TableCount )
+  {
+    m_ResizeCount += 1;
+  }
 
   bool must_realloc = ( new_table_count > m_BufferCount ) ||
                       ( m_BufferCount > m_Config.m_BufferMinCount && m_Config.m_DynamicAlloc );
@@ -529,6 +705,10 @@ MojoStatus MojoSet< key_T >::Resize( int new_table_count )
     m_ActiveCount = 0;
     CopyTable( old_buffer, old_table_count );
     DestructAndFree( old_buffer, old_table_count );
+    if( old_buffer )
+    {
+      m_Alloc->NotifyResize( m_Name );
+    }
   }
   else
   {
@@ -548,7 +728,12 @@ MojoStatus MojoSet< key_T >::Resize( int new_table_count )
 template< typename key_T >
 int MojoSet< key_T >::FindEmptyOrMatching( const key_T& key ) const
 {
-  int start_index = key.GetHash() % m_TableCount;
+  return FindEmptyOrMatchingFrom( key, ( int )( key.GetHash() % m_TableCount ) );
+}
+
+template< typename key_T >
+int MojoSet< key_T >::FindEmptyOrMatchingFrom( const key_T& key, int start_index ) const
+{
   
   // Look forward to the end of the key array
   for( int i = start_index; i < m_TableCount; ++i )
@@ -615,7 +800,7 @@ void MojoSet< key_T >::Reinsert( int index )
 template< typename key_T >
 bool MojoSet< key_T >::RemoveOne( const key_T& key )
 {
-  if( key.IsHashNull() )
+  if( key.IsHashNull() || !m_ActiveCount )
   {
     return false;
   }
@@ -655,8 +840,13 @@ bool MojoSet< key_T >::RemoveOne( const key_T& key )
 template< typename key_T >
 MojoStatus MojoSet< key_T >::Grow()
 {
+  if( !m_TableCount )
+  {
+    // First insert into an empty container.
+    return Resize( kMojoBufferInitialCount );
+  }
   // Make more room if table is getting crowded
-  if( m_ActiveCount * 100 >= m_TableCount * kMojoTableGrowThreshold )
+  if( m_ActiveCount * 100 >= m_TableCount * m_Config.m_MaxLoadPercent )
   {
     int new_size = m_TableCount * 2;
     if( !m_Config.m_DynamicAlloc && m_TableCount < m_BufferCount )
@@ -672,39 +862,59 @@ MojoStatus MojoSet< key_T >::Grow()
 template< typename key_T >
 MojoStatus MojoSet< key_T >::Shrink()
 {
-  // Shrink if it's getting too empty
-  if( m_Config.m_DynamicTable && m_TableCount > kMojoTableMinCount
-     && m_ActiveCount * 100 < m_TableCount * kMojoTableShrinkThreshold )
+  // Shrink if it's getting too empty. Not during a batch: _EndBatch() will take care of it, possibly halving the
+  // table more than once.
+  if( m_BatchDepth )
   {
-    return Resize( m_TableCount / 2 );
+    return kMojoStatus_Ok;
+  }
+  int new_table_count = m_TableCount;
+  while( m_Config.m_DynamicTable && new_table_count > kMojoTableMinCount
+        && m_ActiveCount * 100 < new_table_count * m_Config.m_MinLoadPercent )
+  {
+    new_table_count /= 2;
+  }
+  if( new_table_count == m_TableCount )
+  {
+    m_ShrinkWaitCount = 0;
+  }
+  else if( ++m_ShrinkWaitCount > m_Config.m_ShrinkDelay )
+  {
+    m_ShrinkWaitCount = 0;
+    return Resize( new_table_count );
   }
   return kMojoStatus_Ok;
 }
 
 template< typename key_T >
-bool MojoSet< key_T >::Enumerate( const MojoCollector< key_T >& collector,
-                                 const MojoAbstractSet< key_T >* limit ) const
+void MojoSet< key_T >::_BeginBatch()
+{
+  m_BatchDepth += 1;
+}
+
+template< typename key_T >
+MojoStatus MojoSet< key_T >::_EndBatch()
 {
-  bool more = true;
-  if( limit )
+  if( m_BatchDepth > 0 && --m_BatchDepth == 0 )
   {
-    for( int i = _GetFirstIndex(); more && _IsIndexValid( i ); i = _GetNextIndex( i ) )
-    {
-      key_T key = _GetKeyAt( i );
-      if( limit->Contains( key ) )
-      {
-        more = collector.Push( key );
-      }
-    }
+    return Shrink();
   }
-  else
+  return m_Status;
+}
+
+template< typename key_T >
+bool MojoSet< key_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                 const MojoAbstractSet< key_T >* limit ) const
+{
+  MojoEnumerationBatch< key_T > batch( collector, limit );
+  for( int i = _GetFirstIndex(); _IsIndexValid( i ); i = _GetNextIndex( i ) )
   {
-    for( int i = _GetFirstIndex(); more && _IsIndexValid( i ); i = _GetNextIndex( i ) )
+    if( !batch.Add( _GetKeyAt( i ) ) )
     {
-      more = collector.Push( _GetKeyAt( i ) );
+      return false;
     }
   }
-  return more;
+  return batch.Flush();
 }
 
 template< typename key_T >
@@ -719,6 +929,63 @@ int MojoSet< key_T >::_GetChangeCount() const
   return m_ChangeCount;
 }
 
+template< typename key_T >
+bool MojoSet< key_T >::_GetChangeLogPosition( uint64_t* position ) const
+{
+  if( m_Status || !m_Config.m_ChangeLogCount )
+  {
+    return false;
+  }
+  *position = m_ChangeLogEnd;
+  return true;
+}
+
+template< typename key_T >
+bool MojoSet< key_T >::_GetChangesSince( uint64_t position, const MojoCollector< key_T >& collector ) const
+{
+  // Compare by distance from the end, so the test still holds when the counters wrap around.
+  if( m_Status || !m_Config.m_ChangeLogCount || m_ChangeLogEnd - position > m_ChangeLogEnd - m_ChangeLogStart )
+  {
+    return false;
+  }
+  for( uint64_t i = position; i != m_ChangeLogEnd; ++i )
+  {
+    collector.Push( m_ChangeLog[ i % m_Config.m_ChangeLogCount ] );
+  }
+  return true;
+}
+
+template< typename key_T >
+void MojoSet< key_T >::LogChange( const key_T& key )
+{
+  if( m_Config.m_ChangeLogCount )
+  {
+    if( !m_ChangeLog )
+    {
+      m_ChangeLog = AllocAndConstruct( m_Config.m_ChangeLogCount );
+      if( !m_ChangeLog )
+      {
+        ForgetChanges();
+        return;
+      }
+    }
+    m_ChangeLog[ m_ChangeLogEnd % m_Config.m_ChangeLogCount ] = key;
+    m_ChangeLogEnd += 1;
+    if( m_ChangeLogEnd - m_ChangeLogStart > ( uint64_t )m_Config.m_ChangeLogCount )
+    {
+      m_ChangeLogStart = m_ChangeLogEnd - m_Config.m_ChangeLogCount;
+    }
+  }
+}
+
+template< typename key_T >
+void MojoSet< key_T >::ForgetChanges()
+{
+  // Skip a position, so that every position handed out so far is now out of reach.
+  m_ChangeLogEnd += 1;
+  m_ChangeLogStart = m_ChangeLogEnd;
+}
+
 // ---------------------------------------------------------------------------------------------------------------
 
 /**
@@ -0,0 +1,846 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <string.h>
+#include <new>
+
+// -- Mojo
+#include "MojoConstants.h"
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoUtil.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoArray.h"
+
+/**
+ \class MojoSortedSet
+ \ingroup group_container
+ A set of keys kept in a contiguous array, sorted by 64-bit hash. This is the layout of a posting list.
+
+ A point lookup is a binary search, so Contains() is slower than MojoSet. In exchange, two sorted sets are
+ intersected, united or subtracted by walking both arrays in order. SetToIntersection() and SetToDifference() gallop
+ through the larger set: they skip ahead in steps that double until they pass the key, then search back. That
+ costs O( m log( n / m ) ) for sets of m and n keys, instead of m random probes. MojoIntersection takes the same
+ path when enumerating, if all its inputs are sorted sets.
+
+ Insert() and Remove() move all keys that follow, so fill large sets with FromArray().
+ Also implements the MojoAbstractSet interface.
+ \see MojoForEachKey
+ \tparam key_T Key type. Must be hashable.
+ */
+template< typename key_T >
+class MojoSortedSet final : public MojoAbstractSet< key_T >
+{
+public:
+
+  /**
+   Default constructor. You must call Create() before the set is ready for use.
+   */
+  MojoSortedSet()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the set. Will also be used for internal memory allocation.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoSortedSet( const char* name, MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, alloc );
+  }
+
+  /**
+   Create after default constructor or Destroy().
+   \param[in] name The name of the set. Will also be used for internal memory allocation.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, MojoAlloc* alloc = NULL );
+
+  /**
+   Remove all keys and free all allocated buffers.
+   */
+  void Destroy();
+
+  /**
+   Remove all keys. Memory is kept.
+   */
+  MojoStatus Clear();
+
+  /**
+   Insert key into set. If key already exists in set, does nothing. Takes time proportional to the number of keys
+   that sort after it.
+   \param[in] key Key to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( const key_T& key );
+
+  /**
+   Remove key from the set. Takes time proportional to the number of keys that sort after it.
+   \param[in] key Key to remove.
+   \return Status code. kMojoStatus_NotFound if the key was not in the set.
+   */
+  MojoStatus Remove( const key_T& key );
+
+  /**
+   Replace the contents of the set with the values in an array. The values are radix sorted in one go, which is
+   much faster than inserting them one by one. Duplicate values in the array are inserted once.
+   \param[in] array Array of values to insert.
+   \return Status code.
+   */
+  MojoStatus FromArray( const MojoArray< key_T >* array );
+
+  /**
+   Replace the contents of the set with the keys that are in both a and b.
+   \param[in] a Set to intersect. Must not be this set.
+   \param[in] b Set to intersect. Must not be this set.
+   \return Status code.
+   */
+  MojoStatus SetToIntersection( const MojoSortedSet& a, const MojoSortedSet& b );
+
+  /**
+   Replace the contents of the set with the keys that are in a, or in b, or both.
+   \param[in] a Set to unite. Must not be this set.
+   \param[in] b Set to unite. Must not be this set.
+   \return Status code.
+   */
+  MojoStatus SetToUnion( const MojoSortedSet& a, const MojoSortedSet& b );
+
+  /**
+   Replace the contents of the set with the keys that are in a, and not in b.
+   \param[in] a Set to subtract from. Must not be this set.
+   \param[in] b Set to subtract. Must not be this set.
+   \return Status code.
+   */
+  MojoStatus SetToDifference( const MojoSortedSet& a, const MojoSortedSet& b );
+
+  /**
+   Test presence of a key.
+   */
+  virtual bool Contains( const key_T& key ) const override;
+
+  /**
+   Test presence of a block of keys. See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
+
+  /**
+   Return set status state. This is the only way to find out if something went wrong in the default constructor.
+   If Create() was used, the returned status code will be the same.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  /**
+   Get number of keys in the set.
+   */
+  int GetCount() const { return m_Count; }
+
+  /**
+   Return name of the set.
+   */
+  const char* GetName() const { return m_Name; }
+
+  /**
+   Get index of first key. This is used for the ForEach... macros. It must be declared public to work with the
+   macros, but should be considered private.
+   \private
+   */
+  int _GetFirstIndex() const { return 0; }
+
+  /**
+   Get index of next key. This is used for the ForEach... macros. It must be declared public to work with the
+   macros, but should be considered private.
+   \private
+   */
+  int _GetNextIndex( int index ) const { return index + 1; }
+
+  /**
+   Verify that index is in range. This is used for the ForEach... macros. It must be declared public to work with
+   the macros, but should be considered private.
+   \private
+   */
+  bool _IsIndexValid( int index ) const { return index >= 0 && index < m_Count; }
+
+  /**
+   Get key at a specific index. This is used for the ForEach... macros. It must be declared public to work with the
+   macros, but should be considered private.
+   \private
+   */
+  key_T _GetKeyAt( int index ) const { return m_Keys[ index ]; }
+
+  virtual bool Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override { return m_Count; }
+  /** \private */
+  virtual int _GetChangeCount() const override { return m_ChangeCount; }
+  /** \private */
+  virtual bool _GetSorted( const uint64_t** hashes, const key_T** keys, int* count ) const override;
+
+  /**
+   Destructor.
+   */
+  ~MojoSortedSet();
+
+private:
+  const char*         m_Name;
+  MojoAlloc*          m_Alloc;
+  uint64_t*           m_Hashes;
+  key_T*              m_Keys;
+  int                 m_Count;
+  int                 m_Capacity;
+  int                 m_ChangeCount;
+  MojoStatus          m_Status;
+
+  void Init();
+  MojoStatus Reserve( int capacity );
+  void Append( const key_T& key, uint64_t hash );
+  void Truncate( int count );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+
+/**
+ Find the first position at or after start where hashes[ position ] >= hash, by galloping: step ahead 1, 2, 4...
+ positions until past hash, then binary search the last step. Takes O( log( distance ) ) time.
+ \return The position, or count if there is none.
+ \private
+ */
+inline int MojoGallop( const uint64_t* hashes, int count, int start, uint64_t hash )
+{
+  if( start >= count || hashes[ start ] >= hash )
+  {
+    return start;
+  }
+  // hashes[ low ] < hash, always.
+  int low = start;
+  int step = 1;
+  int high = start + step;
+  while( high < count && hashes[ high ] < hash )
+  {
+    low = high;
+    step *= 2;
+    high = low + step;
+  }
+  if( high > count )
+  {
+    high = count;
+  }
+  // hashes[ high ] >= hash, or high == count.
+  while( high - low > 1 )
+  {
+    int middle = low + ( high - low ) / 2;
+    if( hashes[ middle ] < hash )
+    {
+      low = middle;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return high;
+}
+
+/**
+ Test if the run of equal hashes that starts at position contains key. Keys with equal hashes are not in any
+ particular order, so the run is scanned.
+ \private
+ */
+template< typename key_T >
+bool MojoSortedRunContains( const uint64_t* hashes, const key_T* keys, int count, int position, uint64_t hash,
+                            const key_T& key )
+{
+  for( int i = position; i < count && hashes[ i ] == hash; ++i )
+  {
+    if( keys[ i ] == key )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+void MojoSortedSet< key_T >::Init()
+{
+  m_Name = NULL;
+  m_Alloc = NULL;
+  m_Hashes = NULL;
+  m_Keys = NULL;
+  m_Count = 0;
+  m_Capacity = 0;
+  m_ChangeCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::Create( const char* name, MojoAlloc* alloc )
+{
+  if( !alloc )
+  {
+    alloc = MojoAlloc::GetDefault();
+  }
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else
+  {
+    m_Name = name;
+    m_Alloc = alloc;
+    m_Status = kMojoStatus_Ok;
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoSortedSet< key_T >::~MojoSortedSet()
+{
+  Destroy();
+}
+
+template< typename key_T >
+void MojoSortedSet< key_T >::Destroy()
+{
+  if( m_Alloc && m_Keys )
+  {
+    for( int i = 0; i < m_Capacity; ++i )
+    {
+      m_Keys[ i ].~key_T();
+    }
+    if( !m_Alloc->IsArena() )
+    {
+      m_Alloc->Free( m_Keys );
+      m_Alloc->FreeAligned( m_Hashes );
+    }
+  }
+  Init();
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::Clear()
+{
+  if( !m_Status )
+  {
+    Truncate( 0 );
+    m_ChangeCount += 1;
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+void MojoSortedSet< key_T >::Truncate( int count )
+{
+  // Release the keys past the new end, which may hold references.
+  for( int i = count; i < m_Count; ++i )
+  {
+    m_Keys[ i ] = key_T();
+  }
+  m_Count = count;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::Reserve( int capacity )
+{
+  if( capacity <= m_Capacity )
+  {
+    return kMojoStatus_Ok;
+  }
+  if( capacity < 2 * m_Capacity )
+  {
+    capacity = 2 * m_Capacity;
+  }
+  if( capacity < kMojoBufferInitialCount )
+  {
+    capacity = kMojoBufferInitialCount;
+  }
+  // Hashes are what merges and binary searches walk, so they start on a cache line.
+  uint64_t* hashes = ( uint64_t* )m_Alloc->AllocateAligned( capacity * sizeof( uint64_t ), kMojoCacheLineSize,
+                                                           m_Name );
+  key_T* keys = ( key_T* )m_Alloc->Allocate( capacity * sizeof( key_T ), m_Name );
+  if( !hashes || !keys )
+  {
+    if( hashes )
+    {
+      m_Alloc->FreeAligned( hashes );
+    }
+    if( keys )
+    {
+      m_Alloc->Free( keys );
+    }
+    return kMojoStatus_CouldNotAlloc;
+  }
+  for( int i = 0; i < capacity; ++i )
+  {
+    new( keys + i ) key_T( i < m_Count ? m_Keys[ i ] : key_T() );
+  }
+  if( m_Count )
+  {
+    memcpy( hashes, m_Hashes, m_Count * sizeof( uint64_t ) );
+  }
+  if( m_Keys )
+  {
+    for( int i = 0; i < m_Capacity; ++i )
+    {
+      m_Keys[ i ].~key_T();
+    }
+    if( !m_Alloc->IsArena() )
+    {
+      m_Alloc->Free( m_Keys );
+      m_Alloc->FreeAligned( m_Hashes );
+    }
+    m_Alloc->NotifyResize( m_Name );
+  }
+  m_Hashes = hashes;
+  m_Keys = keys;
+  m_Capacity = capacity;
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T >
+void MojoSortedSet< key_T >::Append( const key_T& key, uint64_t hash )
+{
+  m_Hashes[ m_Count ] = hash;
+  m_Keys[ m_Count ] = key;
+  m_Count += 1;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::Insert( const key_T& key )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    if( key.IsHashNull() )
+    {
+      status = kMojoStatus_InvalidArguments;
+    }
+    else
+    {
+      uint64_t hash = key.GetHash();
+      int position = MojoGallop( m_Hashes, m_Count, 0, hash );
+      if( !MojoSortedRunContains( m_Hashes, m_Keys, m_Count, position, hash, key ) )
+      {
+        status = Reserve( m_Count + 1 );
+        if( !status )
+        {
+          for( int i = m_Count; i > position; --i )
+          {
+            m_Keys[ i ] = m_Keys[ i - 1 ];
+          }
+          memmove( m_Hashes + position + 1, m_Hashes + position, ( m_Count - position ) * sizeof( uint64_t ) );
+          m_Hashes[ position ] = hash;
+          m_Keys[ position ] = key;
+          m_Count += 1;
+          m_ChangeCount += 1;
+        }
+      }
+    }
+  }
+  return status;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::Remove( const key_T& key )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  uint64_t hash = key.GetHash();
+  int position = MojoGallop( m_Hashes, m_Count, 0, hash );
+  while( position < m_Count && m_Hashes[ position ] == hash && !( m_Keys[ position ] == key ) )
+  {
+    position += 1;
+  }
+  if( position == m_Count || m_Hashes[ position ] != hash )
+  {
+    return kMojoStatus_NotFound;
+  }
+  for( int i = position + 1; i < m_Count; ++i )
+  {
+    m_Keys[ i - 1 ] = m_Keys[ i ];
+  }
+  memmove( m_Hashes + position, m_Hashes + position + 1, ( m_Count - position - 1 ) * sizeof( uint64_t ) );
+  Truncate( m_Count - 1 );
+  m_ChangeCount += 1;
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::FromArray( const MojoArray< key_T >* array )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  MojoArray< key_T > sorted( m_Name, key_T(), NULL, m_Alloc );
+  MojoStatus status = sorted.GetStatus();
+  for( int i = 0; !status && i < array->GetCount(); ++i )
+  {
+    status = sorted.Push( array->GetAt( i ) );
+  }
+  if( !status )
+  {
+    status = sorted.SortUnique();
+  }
+  if( !status )
+  {
+    status = Reserve( sorted.GetCount() );
+  }
+  if( !status )
+  {
+    Truncate( 0 );
+    for( int i = 0; i < sorted.GetCount(); ++i )
+    {
+      key_T key = sorted.GetAt( i );
+      if( !key.IsHashNull() )
+      {
+        Append( key, key.GetHash() );
+      }
+    }
+    m_ChangeCount += 1;
+  }
+  return status;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::SetToIntersection( const MojoSortedSet& a, const MojoSortedSet& b )
+{
+  if( m_Status || &a == this || &b == this )
+  {
+    return m_Status ? m_Status : kMojoStatus_InvalidArguments;
+  }
+  // Walk the smaller set, and gallop through the larger.
+  const MojoSortedSet& small = a.m_Count <= b.m_Count ? a : b;
+  const MojoSortedSet& large = a.m_Count <= b.m_Count ? b : a;
+  Truncate( 0 );
+  m_ChangeCount += 1;
+  MojoStatus status = Reserve( small.m_Count );
+  int position = 0;
+  for( int i = 0; !status && i < small.m_Count && position < large.m_Count; ++i )
+  {
+    uint64_t hash = small.m_Hashes[ i ];
+    position = MojoGallop( large.m_Hashes, large.m_Count, position, hash );
+    if( MojoSortedRunContains( large.m_Hashes, large.m_Keys, large.m_Count, position, hash, small.m_Keys[ i ] ) )
+    {
+      Append( small.m_Keys[ i ], hash );
+    }
+  }
+  return status;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::SetToUnion( const MojoSortedSet& a, const MojoSortedSet& b )
+{
+  if( m_Status || &a == this || &b == this )
+  {
+    return m_Status ? m_Status : kMojoStatus_InvalidArguments;
+  }
+  // Linear merge. Every key of both sets ends up in the output anyway.
+  Truncate( 0 );
+  m_ChangeCount += 1;
+  MojoStatus status = Reserve( a.m_Count + b.m_Count );
+  if( !status )
+  {
+    int i = 0;
+    int j = 0;
+    while( i < a.m_Count || j < b.m_Count )
+    {
+      if( j == b.m_Count || ( i < a.m_Count && a.m_Hashes[ i ] < b.m_Hashes[ j ] ) )
+      {
+        Append( a.m_Keys[ i ], a.m_Hashes[ i ] );
+        i += 1;
+      }
+      else if( i == a.m_Count || b.m_Hashes[ j ] < a.m_Hashes[ i ] )
+      {
+        Append( b.m_Keys[ j ], b.m_Hashes[ j ] );
+        j += 1;
+      }
+      else
+      {
+        // Equal hashes. Take the whole run from a, then the keys from the run in b that a does not have.
+        uint64_t hash = a.m_Hashes[ i ];
+        int run_start = i;
+        while( i < a.m_Count && a.m_Hashes[ i ] == hash )
+        {
+          Append( a.m_Keys[ i ], hash );
+          i += 1;
+        }
+        while( j < b.m_Count && b.m_Hashes[ j ] == hash )
+        {
+          if( !MojoSortedRunContains( a.m_Hashes, a.m_Keys, a.m_Count, run_start, hash, b.m_Keys[ j ] ) )
+          {
+            Append( b.m_Keys[ j ], hash );
+          }
+          j += 1;
+        }
+      }
+    }
+  }
+  return status;
+}
+
+template< typename key_T >
+MojoStatus MojoSortedSet< key_T >::SetToDifference( const MojoSortedSet& a, const MojoSortedSet& b )
+{
+  if( m_Status || &a == this || &b == this )
+  {
+    return m_Status ? m_Status : kMojoStatus_InvalidArguments;
+  }
+  // Walk a, and gallop through b.
+  Truncate( 0 );
+  m_ChangeCount += 1;
+  MojoStatus status = Reserve( a.m_Count );
+  int position = 0;
+  for( int i = 0; !status && i < a.m_Count; ++i )
+  {
+    uint64_t hash = a.m_Hashes[ i ];
+    position = MojoGallop( b.m_Hashes, b.m_Count, position, hash );
+    if( !MojoSortedRunContains( b.m_Hashes, b.m_Keys, b.m_Count, position, hash, a.m_Keys[ i ] ) )
+    {
+      Append( a.m_Keys[ i ], hash );
+    }
+  }
+  return status;
+}
+
+template< typename key_T >
+bool MojoSortedSet< key_T >::Contains( const key_T& key ) const
+{
+  if( m_Status || !m_Count || key.IsHashNull() )
+  {
+    return false;
+  }
+  uint64_t hash = key.GetHash();
+  return MojoSortedRunContains( m_Hashes, m_Keys, m_Count, MojoGallop( m_Hashes, m_Count, 0, hash ), hash, key );
+}
+
+template< typename key_T >
+void MojoSortedSet< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  for( int i = 0; i < count; ++i )
+  {
+    if( MojoMaskTest( mask, i ) && !MojoSortedSet::Contains( keys[ i ] ) )
+    {
+      MojoMaskClear( mask, i );
+    }
+  }
+}
+
+template< typename key_T >
+bool MojoSortedSet< key_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                       const MojoAbstractSet< key_T >* limit ) const
+{
+  MojoEnumerationBatch< key_T > batch( collector, limit );
+  return batch.AddRange( m_Keys, m_Count ) && batch.Flush();
+}
+
+template< typename key_T >
+bool MojoSortedSet< key_T >::_GetSorted( const uint64_t** hashes, const key_T** keys, int* count ) const
+{
+  if( m_Status )
+  {
+    return false;
+  }
+  *hashes = m_Hashes;
+  *keys = m_Keys;
+  *count = m_Count;
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+/**
+ Enumerate the intersection of sets that all return arrays from _GetSorted(). The smallest set is walked in order,
+ and every other set is galloped through to the same hash. Used by MojoIntersection.
+ \param[in] sets Input sets.
+ \param[in] set_count Number of input sets.
+ \param[in] collector Receives the keys.
+ \param[in] limit Limit set, or NULL.
+ \param[out] more Return value of Enumerate().
+ \return False if any input is not sorted, in which case nothing was enumerated.
+ \private
+ */
+template< typename key_T >
+bool MojoEnumerateSorted( const MojoAbstractSet< key_T >* const* sets, int set_count,
+                          const MojoCollector< key_T >& collector, const MojoAbstractSet< key_T >* limit,
+                          bool* more )
+{
+  if( !set_count )
+  {
+    return false;
+  }
+  const uint64_t* hashes[ kMojoInputSetMax ];
+  const key_T* keys[ kMojoInputSetMax ];
+  int counts[ kMojoInputSetMax ];
+  int positions[ kMojoInputSetMax ];
+  int driver = 0;
+  for( int i = 0; i < set_count; ++i )
+  {
+    if( !sets[ i ]->_GetSorted( &hashes[ i ], &keys[ i ], &counts[ i ] ) )
+    {
+      return false;
+    }
+    positions[ i ] = 0;
+    if( counts[ i ] < counts[ driver ] )
+    {
+      driver = i;
+    }
+  }
+
+  MojoEnumerationBatch< key_T > batch( collector, limit );
+  for( int k = 0; k < counts[ driver ]; ++k )
+  {
+    uint64_t hash = hashes[ driver ][ k ];
+    bool found = true;
+    for( int i = 0; found && i < set_count; ++i )
+    {
+      if( i != driver )
+      {
+        positions[ i ] = MojoGallop( hashes[ i ], counts[ i ], positions[ i ], hash );
+        if( positions[ i ] == counts[ i ] )
+        {
+          // Nothing left in this set, so nothing left in the intersection.
+          *more = batch.Flush();
+          return true;
+        }
+        found = MojoSortedRunContains( hashes[ i ], keys[ i ], counts[ i ], positions[ i ], hash,
+                                       keys[ driver ][ k ] );
+      }
+    }
+    if( found && !batch.Add( keys[ driver ][ k ] ) )
+    {
+      *more = false;
+      return true;
+    }
+  }
+  *more = batch.Flush();
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+/**
+ Enumerate the union of sets that all return arrays from _GetSorted(), by merging them in hash order. Keys that
+ are in more than one input are pushed once. Used by MojoUnion.
+ \param[in] sets Input sets.
+ \param[in] set_count Number of input sets.
+ \param[in] collector Receives the keys.
+ \param[in] limit Limit set, or NULL.
+ \param[out] more Return value of Enumerate().
+ \return False if any input is not sorted, in which case nothing was enumerated.
+ \private
+ */
+template< typename key_T >
+bool MojoEnumerateSortedUnion( const MojoAbstractSet< key_T >* const* sets, int set_count,
+                               const MojoCollector< key_T >& collector, const MojoAbstractSet< key_T >* limit,
+                               bool* more )
+{
+  if( !set_count )
+  {
+    return false;
+  }
+  const uint64_t* hashes[ kMojoInputSetMax ];
+  const key_T* keys[ kMojoInputSetMax ];
+  int counts[ kMojoInputSetMax ];
+  int positions[ kMojoInputSetMax ];
+  for( int i = 0; i < set_count; ++i )
+  {
+    if( !sets[ i ]->_GetSorted( &hashes[ i ], &keys[ i ], &counts[ i ] ) )
+    {
+      return false;
+    }
+    positions[ i ] = 0;
+  }
+
+  MojoEnumerationBatch< key_T > batch( collector, limit );
+  for( ;; )
+  {
+    // Find the lowest hash at the front of any input.
+    bool found = false;
+    uint64_t hash = 0;
+    for( int i = 0; i < set_count; ++i )
+    {
+      if( positions[ i ] < counts[ i ] && ( !found || hashes[ i ][ positions[ i ] ] < hash ) )
+      {
+        hash = hashes[ i ][ positions[ i ] ];
+        found = true;
+      }
+    }
+    if( !found )
+    {
+      break;
+    }
+
+    // Push every key with that hash, unless an earlier input has it too. Then step past the hash in all inputs.
+    for( int i = 0; i < set_count; ++i )
+    {
+      for( int k = positions[ i ]; k < counts[ i ] && hashes[ i ][ k ] == hash; ++k )
+      {
+        bool duplicate = false;
+        for( int j = 0; !duplicate && j < i; ++j )
+        {
+          duplicate = MojoSortedRunContains( hashes[ j ], keys[ j ], counts[ j ], positions[ j ], hash,
+                                             keys[ i ][ k ] );
+        }
+        if( !duplicate && !batch.Add( keys[ i ][ k ] ) )
+        {
+          *more = false;
+          return true;
+        }
+      }
+    }
+    for( int i = 0; i < set_count; ++i )
+    {
+      while( positions[ i ] < counts[ i ] && hashes[ i ][ positions[ i ] ] == hash )
+      {
+        positions[ i ] += 1;
+      }
+    }
+  }
+  *more = batch.Flush();
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
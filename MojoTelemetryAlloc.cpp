@@ -0,0 +1,297 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Standard Libs
+#include <string.h>
+
+#include "MojoTelemetryAlloc.h"
+
+// Every block starts with a header. It is 16 bytes to keep the memory after it aligned like malloc() does.
+struct Header
+{
+  const char* m_Name;         // The copy owned by the stats. NULL if the stats could not be allocated.
+  size_t      m_ByteCount;
+};
+static const size_t kHeaderSize = 16;
+static_assert( sizeof( Header ) <= kHeaderSize, "Header does not fit" );
+
+// Allocations without a name are counted under this one.
+static const char* const kNoName = "(no name)";
+
+static void AddBytes( MojoAllocStats* stats, int64_t byte_count, int64_t count )
+{
+  stats->m_LiveBytes += byte_count;
+  stats->m_LiveCount += count;
+  stats->m_PeakBytes = MojoMax( stats->m_PeakBytes, stats->m_LiveBytes );
+}
+
+static bool MoreLiveBytes( const MojoAllocStats& a, const MojoAllocStats& b )
+{
+  return a.m_LiveBytes > b.m_LiveBytes;
+}
+
+MojoTelemetryAlloc::MojoTelemetryAlloc( MojoAlloc* parent )
+{
+  m_Parent = parent ? parent : MojoAlloc::GetDefault();
+  m_Lock.clear();
+  m_Stats.Create( "MojoTelemetryAlloc", MojoAllocStats(), NULL, m_Parent );
+  m_Snapshot.Create( "MojoTelemetryAlloc", MojoAllocStats(), NULL, m_Parent );
+}
+
+MojoTelemetryAlloc::~MojoTelemetryAlloc()
+{
+  // The table looks at its keys, so it goes first. The names are still in the snapshot.
+  Lock();
+  TakeSnapshot();
+  Unlock();
+  m_Stats.Destroy();
+  for( int i = 0; i < m_Snapshot.GetCount(); ++i )
+  {
+    m_Parent->Free( ( void* )m_Snapshot[ i ].m_Name );
+  }
+}
+
+void* MojoTelemetryAlloc::Allocate( size_t byte_count, const char* name )
+{
+  name = name ? name : kNoName;
+  char* block = ( char* )m_Parent->Allocate( byte_count + kHeaderSize, name );
+  if( !block )
+  {
+    return NULL;
+  }
+  Header* header = ( Header* )block;
+  header->m_Name = NULL;
+  header->m_ByteCount = byte_count;
+
+  Lock();
+  MojoAllocStats* stats = FindStats( name );
+  if( stats )
+  {
+    header->m_Name = stats->m_Name;
+    stats->m_AllocCount += 1;
+    AddBytes( stats, byte_count, 1 );
+  }
+  m_Total.m_AllocCount += 1;
+  AddBytes( &m_Total, byte_count, 1 );
+  Unlock();
+
+  return block + kHeaderSize;
+}
+
+void MojoTelemetryAlloc::Free( void* p )
+{
+  if( !p )
+  {
+    return;
+  }
+  Header* header = ( Header* )( ( char* )p - kHeaderSize );
+  int64_t byte_count = header->m_ByteCount;
+
+  Lock();
+  MojoAllocStats* stats = FindStats( header->m_Name );
+  if( stats )
+  {
+    AddBytes( stats, -byte_count, -1 );
+  }
+  AddBytes( &m_Total, -byte_count, -1 );
+  Unlock();
+
+  m_Parent->Free( header );
+}
+
+void* MojoTelemetryAlloc::Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name )
+{
+  // The header has the size of the block.
+  ( void )old_byte_count;
+  if( !p )
+  {
+    return NULL;
+  }
+  Header* header = ( Header* )( ( char* )p - kHeaderSize );
+  const char* block_name = header->m_Name;
+  int64_t block_byte_count = header->m_ByteCount;
+
+  Header* new_header = ( Header* )m_Parent->Reallocate( header, block_byte_count + kHeaderSize,
+                                                       new_byte_count + kHeaderSize, name );
+  if( !new_header )
+  {
+    // The caller will allocate a new block and copy. That is counted as an allocation, not a resize.
+    return NULL;
+  }
+  new_header->m_ByteCount = new_byte_count;
+  int64_t difference = ( int64_t )new_byte_count - block_byte_count;
+
+  Lock();
+  MojoAllocStats* stats = FindStats( block_name );
+  if( stats )
+  {
+    stats->m_ResizeCount += 1;
+    AddBytes( stats, difference, 0 );
+  }
+  m_Total.m_ResizeCount += 1;
+  AddBytes( &m_Total, difference, 0 );
+  Unlock();
+
+  return ( char* )new_header + kHeaderSize;
+}
+
+void MojoTelemetryAlloc::NotifyResize( const char* name )
+{
+  Lock();
+  MojoAllocStats* stats = FindStats( name ? name : kNoName );
+  if( stats )
+  {
+    stats->m_ResizeCount += 1;
+  }
+  m_Total.m_ResizeCount += 1;
+  Unlock();
+
+  m_Parent->NotifyResize( name );
+}
+
+MojoStatus MojoTelemetryAlloc::GetSnapshot( MojoArray< MojoAllocStats >* snapshot ) const
+{
+  // The snapshot is taken into an internal array first. The array passed in may allocate through this allocator,
+  // which must not happen while the lock is held.
+  Lock();
+  TakeSnapshot();
+  Unlock();
+
+  MojoStatus status = snapshot->Clear();
+  MojoSpan< const MojoAllocStats > first;
+  MojoSpan< const MojoAllocStats > second;
+  m_Snapshot.GetSpans( &first, &second );
+  for( int i = 0; i < first.m_Count && !status; ++i )
+  {
+    status = snapshot->Push( first.m_Values[ i ] );
+  }
+  for( int i = 0; i < second.m_Count && !status; ++i )
+  {
+    status = snapshot->Push( second.m_Values[ i ] );
+  }
+  return status;
+}
+
+MojoAllocStats MojoTelemetryAlloc::GetTotal() const
+{
+  Lock();
+  MojoAllocStats total = m_Total;
+  Unlock();
+  return total;
+}
+
+void MojoTelemetryAlloc::Print( FILE* file ) const
+{
+  Lock();
+  TakeSnapshot();
+  fprintf( file, "%-32s %12s %12s %10s %10s %10s\n", "Name", "Live bytes", "Peak bytes", "Live", "Allocs",
+          "Resizes" );
+  for( int i = 0; i < m_Snapshot.GetCount(); ++i )
+  {
+    MojoAllocStats stats = m_Snapshot[ i ];
+    fprintf( file, "%-32s %12lld %12lld %10lld %10lld %10lld\n", stats.m_Name, ( long long )stats.m_LiveBytes,
+            ( long long )stats.m_PeakBytes, ( long long )stats.m_LiveCount, ( long long )stats.m_AllocCount,
+            ( long long )stats.m_ResizeCount );
+  }
+  fprintf( file, "%-32s %12lld %12lld %10lld %10lld %10lld\n", "Total", ( long long )m_Total.m_LiveBytes,
+          ( long long )m_Total.m_PeakBytes, ( long long )m_Total.m_LiveCount, ( long long )m_Total.m_AllocCount,
+          ( long long )m_Total.m_ResizeCount );
+  Unlock();
+}
+
+void MojoTelemetryAlloc::ResetCounts()
+{
+  Lock();
+  const char* name;
+  MojoForEachKey( m_Stats, name )
+  {
+    MojoAllocStats* stats = m_Stats.FindForImmediateChange( name );
+    stats->m_PeakBytes = stats->m_LiveBytes;
+    stats->m_AllocCount = 0;
+    stats->m_ResizeCount = 0;
+  }
+  m_Total.m_PeakBytes = m_Total.m_LiveBytes;
+  m_Total.m_AllocCount = 0;
+  m_Total.m_ResizeCount = 0;
+  Unlock();
+}
+
+void MojoTelemetryAlloc::Lock() const
+{
+  while( m_Lock.test_and_set( std::memory_order_acquire ) )
+  {
+  }
+}
+
+void MojoTelemetryAlloc::Unlock() const
+{
+  m_Lock.clear( std::memory_order_release );
+}
+
+MojoAllocStats* MojoTelemetryAlloc::FindStats( const char* name )
+{
+  // Called with the lock held. The first time a name is seen, its text is copied, so the caller may release it.
+  if( !name )
+  {
+    return NULL;
+  }
+  MojoAllocStats* stats = m_Stats.FindForImmediateChange( name );
+  if( !stats )
+  {
+    size_t byte_count = strlen( name ) + 1;
+    char* copy = ( char* )m_Parent->Allocate( byte_count, "MojoTelemetryAlloc" );
+    if( !copy )
+    {
+      return NULL;
+    }
+    memcpy( copy, name, byte_count );
+    MojoAllocStats new_stats;
+    new_stats.m_Name = copy;
+    if( m_Stats.Insert( copy, new_stats ) )
+    {
+      m_Parent->Free( copy );
+      return NULL;
+    }
+    stats = m_Stats.FindForImmediateChange( copy );
+  }
+  return stats;
+}
+
+void MojoTelemetryAlloc::TakeSnapshot() const
+{
+  // Called with the lock held.
+  m_Snapshot.Clear();
+  const char* name;
+  MojoForEachKey( m_Stats, name )
+  {
+    m_Snapshot.Push( m_Stats.Find( name ) );
+  }
+  m_Snapshot.SortBy( MoreLiveBytes );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+// -- Mojo
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoUtil.h"
+#include "MojoArray.h"
+#include "MojoMap.h"
+
+/**
+ \struct MojoAllocStats
+ \ingroup group_config
+ Allocation statistics for one name. See MojoTelemetryAlloc.
+ */
+struct MojoAllocStats
+{
+  /// Name passed to MojoAlloc::Allocate(). This is the name of the container, as passed to Create(). Points to a
+  /// copy that is owned by the MojoTelemetryAlloc, and stays valid until the MojoTelemetryAlloc is destroyed.
+  const char* m_Name;
+  /// Bytes currently allocated.
+  int64_t     m_LiveBytes;
+  /// Highest value m_LiveBytes has had.
+  int64_t     m_PeakBytes;
+  /// Blocks currently allocated.
+  int64_t     m_LiveCount;
+  /// Calls to Allocate() so far.
+  int64_t     m_AllocCount;
+  /// Resizes so far: calls to Reallocate() that succeeded, and calls to MojoAlloc::NotifyResize().
+  int64_t     m_ResizeCount;
+
+  MojoAllocStats()
+  : m_Name( NULL ), m_LiveBytes( 0 ), m_PeakBytes( 0 ), m_LiveCount( 0 ), m_AllocCount( 0 ), m_ResizeCount( 0 )
+  {}
+
+  /**
+   Stats are equal if they are for the same name. MojoArray requires this operator.
+   */
+  bool operator==( const MojoAllocStats& other ) const { return m_Name == other.m_Name; }
+};
+
+/**
+ \class MojoTelemetryAlloc
+ \ingroup group_config
+ An allocator that passes all requests on to another allocator, and keeps statistics per allocation name.
+
+ Every container passes its name to the allocator. MojoTelemetryAlloc keeps live bytes, peak bytes, and allocation
+ and resize counts for each name, so you can see which containers drive memory use and allocation rate.
+ \code
+ MojoTelemetryAlloc telemetry;
+ MojoAlloc::SetDefault( &telemetry );
+ // ...
+ telemetry.Print();
+ \endcode
+
+ Each block gets a 16 byte header that records its name and size. Statistics are kept per name text, so the cost
+ per allocation is a hash of the name and a lookup in a small hash table. The first time a name is seen, its text is
+ copied, so names passed to Allocate() need not outlive their blocks. Containers grow hash tables by moving to a new
+ block, and report that through MojoAlloc::NotifyResize(), so those moves are counted as resizes. The allocator is
+ thread safe. The statistics table and the copies of the names are allocated from the parent allocator.
+ */
+class MojoTelemetryAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Constructor.
+   \param[in] parent Allocator to pass requests on to. If omitted, the global default at the time of construction
+   will be used. See documentation for MojoAlloc for details on how to set the global default.
+   */
+  MojoTelemetryAlloc( MojoAlloc* parent = NULL );
+
+  virtual ~MojoTelemetryAlloc();
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  virtual void  Free( void* p ) override;
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name ) override;
+  virtual void  NotifyResize( const char* name ) override;
+  virtual bool  IsArena() const override { return m_Parent->IsArena(); }
+
+  /**
+   Get the statistics for all names, highest live byte count first.
+   \param[out] snapshot Receives the statistics. Previous contents are removed.
+   \return Status code.
+   */
+  MojoStatus GetSnapshot( MojoArray< MojoAllocStats >* snapshot ) const;
+
+  /**
+   Get the statistics for all names combined. The name is NULL.
+   \return The statistics.
+   */
+  MojoAllocStats GetTotal() const;
+
+  /**
+   Print the statistics for all names, highest live byte count first.
+   \param[in] file File to print to.
+   */
+  void Print( FILE* file = stdout ) const;
+
+  /**
+   Clear all counts, except the live bytes and counts. Peak bytes are set to the live bytes.
+   */
+  void ResetCounts();
+
+private:
+  // Copying would share the statistics table.
+  MojoTelemetryAlloc( const MojoTelemetryAlloc& );
+  MojoTelemetryAlloc& operator=( const MojoTelemetryAlloc& );
+
+  MojoAlloc*                                                m_Parent;
+  mutable std::atomic_flag                                  m_Lock;
+  MojoMap< MojoHashableCString, MojoAllocStats >            m_Stats;      // Keys are the copies of the names
+  mutable MojoArray< MojoAllocStats >                       m_Snapshot;   // Built with the lock held
+  MojoAllocStats                                            m_Total;
+
+  void Lock() const;
+  void Unlock() const;
+  MojoAllocStats* FindStats( const char* name );
+  void TakeSnapshot() const;
+};
+
+// ---------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,318 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the
+ following disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.ItShouldJustWorkTM.com/mojolib/ */
+
+// ---------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+// -- Standard Libs
+#include <limits.h>
+
+// -- Mojo
+#include "MojoStatus.h"
+#include "MojoConfig.h"
+#include "MojoAlloc.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoArray.h"
+#include "MojoMap.h"
+#include "MojoMultiMap.h"
+
+/**
+ \enum MojoTraversalOrder
+ \ingroup group_function
+ Order in which MojoTraversal visits nodes.
+ */
+enum MojoTraversalOrder
+{
+  /// Follow each path as deep as it goes before backtracking.
+  kMojoTraversalOrder_DepthFirst = 0,
+  /// Visit all nodes at distance 1, then all nodes at distance 2, and so on.
+  kMojoTraversalOrder_BreadthFirst,
+};
+
+/**
+ \class MojoTraversal
+ \ingroup group_function
+ Engine for transitive closure over a MojoMultiMap, such as the children of children in a MojoManyToMany.
+
+ Every node is emitted and expanded at most once per traversal, so shared nodes in a graph with diamonds cost no
+ more than other nodes, and cycles terminate. Pending nodes are kept in an explicit work list rather than on the
+ call stack, so there is no limit on depth.
+
+ Visited nodes are marked with a generation number in an internal table. Starting a new traversal increments the
+ generation number, which implicitly unmarks all nodes without clearing the table.
+
+ \note A traversal object must not be used by more than one traversal at a time. Do not start another traversal
+ on the same object from inside the collector.
+ \tparam key_T Key type. Must be hashable.
+ */
+template< typename key_T >
+class MojoTraversal final
+{
+public:
+  /**
+   Default constructor. You must call Create() before the traversal is ready for use.
+   */
+  MojoTraversal()
+  {
+    Init();
+  }
+
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the traversal. Will also be used for internal memory allocation.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig
+   for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   */
+  MojoTraversal( const char* name, const MojoConfig* config = NULL, MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, config, alloc );
+  }
+
+  /**
+   Create after default constructor or Destroy().
+   \param[in] name The name of the traversal. Will also be used for internal memory allocation.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig
+   for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global default will be used. See documentation for MojoAlloc
+   for details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const MojoConfig* config = NULL, MojoAlloc* alloc = NULL );
+
+  /**
+   Release all resources.
+   */
+  void Destroy();
+
+  /**
+   Push all nodes reachable from the input set into the collector. Input nodes are not pushed, unless they can be
+   reached from another input node.
+   \param[in] input_set Nodes to start from.
+   \param[in] multi_map Edges, from key to values.
+   \param[in] collector Receives the nodes.
+   \param[in] limit If not NULL, only nodes in this set are pushed. The traversal itself is not limited.
+   \param[in] max_depth Maximum distance from the input set. 1 pushes only the values of the input keys.
+   \param[in] order Order of traversal. If max_depth is specified, the traversal is always breadth-first. That way
+   every node is first reached along its shortest path, and no node within max_depth is missed.
+   \return false if the collector aborted the traversal, true otherwise.
+   */
+  bool Enumerate( const MojoAbstractSet< key_T >* input_set, const MojoMultiMap< key_T, key_T >* multi_map,
+                 const MojoCollector< key_T >& collector, const MojoAbstractSet< key_T >* limit = NULL,
+                 int max_depth = INT_MAX, MojoTraversalOrder order = kMojoTraversalOrder_DepthFirst );
+
+  /**
+   Return status state.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+
+  /**
+   Return name of the traversal.
+   \return Given name.
+   */
+  const char* GetName() const { return m_Name; }
+
+  ~MojoTraversal();
+
+private:
+  struct Node
+  {
+    Node()
+    : m_Depth( 0 )
+    {}
+    Node( const key_T& key, int depth )
+    : m_Key( key )
+    , m_Depth( depth )
+    {}
+    bool operator== ( const Node& other ) const { return m_Key == other.m_Key && m_Depth == other.m_Depth; }
+    key_T m_Key;
+    int   m_Depth;
+  };
+
+  class InputCollector final : public MojoCollector< key_T >
+  {
+  public:
+    InputCollector( MojoArray< Node >* work )
+    : m_Work( work )
+    {}
+    virtual bool Push( const key_T& key ) const override
+    {
+      m_Work->Push( Node( key, 0 ) );
+      return true;
+    }
+  private:
+    MojoArray< Node >* m_Work;
+  };
+
+  const char*           m_Name;
+  MojoMap< key_T, int > m_Visited;      // Generation in which the node was last visited
+  MojoArray< Node >     m_Work;
+  int                   m_Generation;
+  int                   m_VisitCount;   // Nodes visited in current generation
+  MojoStatus            m_Status;
+
+  void Init();
+  void BeginGeneration();
+  bool Visit( const key_T& key );
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+void MojoTraversal< key_T >::Init()
+{
+  m_Name = NULL;
+  m_Generation = 0;
+  m_VisitCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T >
+MojoStatus MojoTraversal< key_T >::Create( const char* name, const MojoConfig* config, MojoAlloc* alloc )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else
+  {
+    m_Name = name;
+    m_Status = m_Visited.Create( name, 0, config, alloc );
+    if( !m_Status )
+    {
+      m_Status = m_Work.Create( name, Node(), config, alloc );
+    }
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoTraversal< key_T >::~MojoTraversal()
+{
+  Destroy();
+}
+
+template< typename key_T >
+void MojoTraversal< key_T >::Destroy()
+{
+  m_Visited.Destroy();
+  m_Work.Destroy();
+  Init();
+}
+
+template< typename key_T >
+void MojoTraversal< key_T >::BeginGeneration()
+{
+  // Stamps of earlier generations are left in the table. Clear it when it is mostly stale, so nodes that have
+  // since been removed from the graph don't accumulate. Also when the generation number is about to wrap.
+  if( m_Generation == INT_MAX || m_Visited.GetCount() > 4 * m_VisitCount + kMojoBufferMinCount )
+  {
+    m_Visited.Clear();
+    m_Generation = 0;
+  }
+  m_Generation += 1;
+  m_VisitCount = 0;
+}
+
+template< typename key_T >
+bool MojoTraversal< key_T >::Visit( const key_T& key )
+{
+  int* generation = m_Visited.FindForImmediateChange( key );
+  if( generation )
+  {
+    if( *generation == m_Generation )
+    {
+      return false;
+    }
+    *generation = m_Generation;
+  }
+  else
+  {
+    m_Visited.Insert( key, m_Generation );
+  }
+  m_VisitCount += 1;
+  return true;
+}
+
+template< typename key_T >
+bool MojoTraversal< key_T >::Enumerate( const MojoAbstractSet< key_T >* input_set,
+                                      const MojoMultiMap< key_T, key_T >* multi_map,
+                                      const MojoCollector< key_T >& collector,
+                                      const MojoAbstractSet< key_T >* limit, int max_depth,
+                                      MojoTraversalOrder order )
+{
+  if( m_Status )
+  {
+    return true;
+  }
+
+  BeginGeneration();
+  bool breadth_first = ( order == kMojoTraversalOrder_BreadthFirst || max_depth != INT_MAX );
+
+  // Input nodes are not marked as visited. They are only emitted if they are reached from another input node.
+  input_set->Enumerate( InputCollector( &m_Work ) );
+
+  bool more = true;
+  while( more && m_Work.GetCount() )
+  {
+    Node node = breadth_first ? m_Work.Shift() : m_Work.Pop();
+    const MojoSet< key_T >* values = multi_map->Find( node.m_Key );
+    if( values )
+    {
+      // Emit and queue in a single pass over the values.
+      key_T value;
+      MojoForEachKey( *values, value )
+      {
+        if( Visit( value ) )
+        {
+          if( !limit || limit->Contains( value ) )
+          {
+            more = collector.Push( value );
+            if( !more )
+            {
+              break;
+            }
+          }
+          if( node.m_Depth + 1 < max_depth )
+          {
+            m_Work.Push( Node( value, node.m_Depth + 1 ) );
+          }
+        }
+      }
+    }
+  }
+
+  m_Work.Clear();
+  return more;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
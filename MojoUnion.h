@@ -31,7 +31,11 @@
 #include "MojoConstants.h"
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
+#include "MojoBitSet.h"
+#include "MojoSortedSet.h"
+#include "MojoSet.h"
 #include "MojoUtil.h"
+#include "MojoProbeOrder.h"
 #include "MojoDifference.h"
 
 /**
@@ -44,6 +48,15 @@
 
  `S = S1 ∪ S2 ∪ S3 ...`
 
+ Contains() tests the inputs that are most likely to contain a key first, as learned from earlier calls. See
+ MojoProbeOrder. Contains() may be called from several threads at once. The order is learned with atomic
+ operations, so each call does write to the union, but does not race.
+
+ Enumerate() must push each key once, however many inputs contain it. Normally, each input is enumerated with the
+ inputs before it as a limit, so every key of input i is tested against up to i other inputs. With many inputs,
+ that adds up to more than keeping one scratch MojoSet of the keys pushed so far. Enumerate() weighs the two by
+ _GetEnumerationCost(), see kMojoUnionScratchCost. If all inputs are MojoSortedSet, it merges them instead.
+
  \image html Set-Union.png
  */
 template< typename key_T >
@@ -70,16 +83,71 @@ public:
    */
   MojoUnion& Add( const MojoAbstractSet< key_T >* s );
   virtual bool Contains( const key_T& key ) const override;
+  /**
+   Test a block of keys against each input in probe order, stopping once no key is left. One key per block is
+   sampled, so the probe order keeps learning. See MojoAbstractSet::ContainsBatch().
+   */
+  virtual void ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const override;
   virtual bool Enumerate( const MojoCollector< key_T >& collector,
                          const MojoAbstractSet< key_T >* limit = NULL ) const override;
   /** \private */
   virtual int _GetEnumerationCost() const override;
   /** \private */
   virtual int _GetChangeCount() const override;
+  /** \private */
+  virtual MojoSetKind _GetKind() const override { return kMojoSetKind_Union; }
+  /** \private */
+  virtual int _GetInputCount() const override { return m_SetCount; }
+  /** \private */
+  virtual const MojoAbstractSet< key_T >* _GetInput( int index ) const override { return m_Sets[ index ]; }
   
 private:
   const MojoAbstractSet< key_T >* m_Sets[ kMojoInputSetMax ];
   int                       m_SetCount;
+  mutable MojoProbeOrder    m_ProbeOrder;
+
+  // Pushes only the keys that are not in the scratch set yet, and adds them to it.
+  class UniqueCollector final : public MojoCollector< key_T >
+  {
+  public:
+    UniqueCollector( const MojoCollector< key_T >& collector, MojoSet< key_T >* seen )
+    : m_Collector( collector )
+    , m_Seen( seen )
+    {}
+    virtual bool Push( const key_T& key ) const override
+    {
+      return PushBatch( &key, 1 );
+    }
+    virtual bool PushBatch( const key_T* keys, int count ) const override
+    {
+      key_T unique_keys[ kMojoBatchSize ];
+      int unique_count = 0;
+      for( int i = 0; i < count; ++i )
+      {
+        int seen_count = m_Seen->GetCount();
+        // If the scratch set cannot take the key, push it anyway. A duplicate is better than a missing key.
+        if( kMojoStatus_Ok != m_Seen->Insert( keys[ i ] ) || m_Seen->GetCount() != seen_count )
+        {
+          unique_keys[ unique_count++ ] = keys[ i ];
+          if( unique_count == kMojoBatchSize )
+          {
+            if( !m_Collector.PushBatch( unique_keys, unique_count ) )
+            {
+              return false;
+            }
+            unique_count = 0;
+          }
+        }
+      }
+      return !unique_count || m_Collector.PushBatch( unique_keys, unique_count );
+    }
+  private:
+    const MojoCollector< key_T >& m_Collector;
+    MojoSet< key_T >*             m_Seen;
+  };
+
+  bool ContainsSampled( const key_T& key ) const;
+  bool PrefersScratchSet() const;
 };
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -91,6 +159,7 @@ MojoUnion< key_T >::MojoUnion( const MojoAbstractSet< key_T >* s1,
                                const MojoAbstractSet< key_T >* s3,
                                const MojoAbstractSet< key_T >* s4 )
 : m_SetCount( 0 )
+, m_ProbeOrder( true )
 {
   Add( s1 );
   Add( s2 );
@@ -106,6 +175,7 @@ MojoUnion< key_T >& MojoUnion< key_T >::Add( const MojoAbstractSet< key_T >* s )
     if( m_SetCount < kMojoInputSetMax )
     {
       m_Sets[ m_SetCount++ ] = s;
+      m_ProbeOrder.Add();
     }
   }
   return *this;
@@ -114,9 +184,14 @@ MojoUnion< key_T >& MojoUnion< key_T >::Add( const MojoAbstractSet< key_T >* s )
 template< typename key_T >
 bool MojoUnion< key_T >::Contains( const key_T& key ) const
 {
+  if( m_ProbeOrder.IsSampleDue() )
+  {
+    return ContainsSampled( key );
+  }
+  MojoProbeOrder::Iterator order( m_ProbeOrder );
   for( int i = 0; i < m_SetCount; ++i )
   {
-    if( m_Sets[ i ]->Contains( key ) )
+    if( m_Sets[ order.Next() ]->Contains( key ) )
     {
       return true;
     }
@@ -124,6 +199,92 @@ bool MojoUnion< key_T >::Contains( const key_T& key ) const
   return false;
 }
 
+template< typename key_T >
+bool MojoUnion< key_T >::ContainsSampled( const key_T& key ) const
+{
+  // Test and time every input, to learn which inputs pass most often for the time they take.
+  bool result = false;
+  for( int i = 0; i < m_SetCount; ++i )
+  {
+    uint64_t start = MojoProbeOrder::GetTicks();
+    bool passed = m_Sets[ i ]->Contains( key );
+    m_ProbeOrder.Record( i, passed, MojoProbeOrder::GetTicks() - start );
+    result = result || passed;
+  }
+  m_ProbeOrder.EndSample();
+  return result;
+}
+
+template< typename key_T >
+void MojoUnion< key_T >::ContainsBatch( const key_T* keys, int count, uint64_t* mask ) const
+{
+  uint64_t found[ kMojoBatchSize / 64 ];
+  uint64_t pending[ kMojoBatchSize / 64 ];
+  uint64_t hits[ kMojoBatchSize / 64 ];
+  for( int base = 0; base < count; base += kMojoBatchSize )
+  {
+    // Keys found by an input need not be tested against the inputs that follow.
+    int n = MojoMin( count - base, kMojoBatchSize );
+    int word_count = MojoMaskWordCount( n );
+    uint64_t* block_mask = mask + base / 64;
+    for( int w = 0; w < word_count; ++w )
+    {
+      found[ w ] = 0;
+      pending[ w ] = block_mask[ w ];
+    }
+    for( int i = 0; i < n; ++i )
+    {
+      if( MojoMaskTest( pending, i ) )
+      {
+        // If another thread is sampling, the key is tested along with the others.
+        if( m_ProbeOrder.BeginSample() )
+        {
+          if( ContainsSampled( keys[ base + i ] ) )
+          {
+            found[ i >> 6 ] |= ( uint64_t )1 << ( i & 63 );
+          }
+          MojoMaskClear( pending, i );
+        }
+        break;
+      }
+    }
+    MojoProbeOrder::Iterator order( m_ProbeOrder );
+    for( int i = 0; i < m_SetCount && !MojoMaskIsEmpty( pending, n ); ++i )
+    {
+      for( int w = 0; w < word_count; ++w )
+      {
+        hits[ w ] = pending[ w ];
+      }
+      m_Sets[ order.Next() ]->ContainsBatch( keys + base, n, hits );
+      for( int w = 0; w < word_count; ++w )
+      {
+        found[ w ] |= hits[ w ];
+        pending[ w ] &= ~hits[ w ];
+      }
+    }
+    for( int w = 0; w < word_count; ++w )
+    {
+      block_mask[ w ] = found[ w ];
+    }
+  }
+}
+
+template< typename key_T >
+bool MojoUnion< key_T >::PrefersScratchSet() const
+{
+  // Enumerating input i with the inputs before it as a limit tests each of its keys against up to i inputs. A
+  // scratch set costs one insert per key, at kMojoUnionScratchCost tests each.
+  uint64_t limited_cost = 0;
+  uint64_t scratch_cost = 0;
+  for( int i = 0; i < m_SetCount; ++i )
+  {
+    uint64_t cost = ( uint64_t )m_Sets[ i ]->_GetEnumerationCost();
+    limited_cost += cost * i;
+    scratch_cost += cost * kMojoUnionScratchCost;
+  }
+  return limited_cost > scratch_cost;
+}
+
 template< typename key_T >
 inline int MojoUnion< key_T >::_GetEnumerationCost() const
 {
@@ -156,6 +317,24 @@ inline bool MojoUnion< key_T >::Enumerate( const MojoCollector< key_T >& collect
                                           const MojoAbstractSet< key_T >* limit ) const
 {
   bool more = true;
+  if( MojoEnumerateWords( kMojoSetKind_Union, m_Sets, m_SetCount, collector, limit, &more ) )
+  {
+    return more;
+  }
+  if( MojoEnumerateSortedUnion( m_Sets, m_SetCount, collector, limit, &more ) )
+  {
+    return more;
+  }
+  if( PrefersScratchSet() )
+  {
+    MojoSet< key_T > seen( "MojoUnion" );
+    UniqueCollector unique_collector( collector, &seen );
+    for( int i = 0; more && i < m_SetCount; ++i )
+    {
+      more = m_Sets[ i ]->Enumerate( unique_collector, limit );
+    }
+    return more;
+  }
   if( limit )
   {
     MojoDifference< key_T > combined_limit;
@@ -31,6 +31,7 @@
 // -- Standard Libs
 #include <stdint.h>
 #include <string.h>
+#include <type_traits>
 
 /**
  \file MojoUtil.h
@@ -105,6 +106,125 @@ T MojoMax( const T& a, const T& b ) { return a > b ? a : b; }
 template< typename T >
 T MojoMin( const T& a, const T& b ) { return a <= b ? a : b; }
 
+/**
+ \ingroup group_util
+ True if values of type T can be copied and moved as raw bytes, and need not be constructed or destroyed.
+ Containers use this to replace per-element loops with memcpy() and memmove().
+ */
+template< typename T >
+struct MojoIsTriviallyCopyable
+{
+  static const bool value = std::is_trivially_copyable< T >::value;
+};
+
+/**
+ \ingroup group_util
+ True if values of type T need not be destroyed. Containers use this to skip visiting every value on destruction.
+ */
+template< typename T >
+struct MojoIsTriviallyDestructible
+{
+  static const bool value = std::is_trivially_destructible< T >::value;
+};
+
+/**
+ \ingroup group_util
+ Number of 64-bit words in a mask for count keys. See MojoAbstractSet::ContainsBatch().
+ */
+inline int MojoMaskWordCount( int count ) { return ( count + 63 ) >> 6; }
+
+/**
+ \ingroup group_util
+ Set the first count bits of a mask, and clear the remaining bits of its last word.
+ */
+inline void MojoMaskSetAll( uint64_t* mask, int count )
+{
+  int word_count = MojoMaskWordCount( count );
+  for( int i = 0; i < word_count; ++i )
+  {
+    mask[ i ] = ~( uint64_t )0;
+  }
+  if( count & 63 )
+  {
+    mask[ word_count - 1 ] = ( ( uint64_t )1 << ( count & 63 ) ) - 1;
+  }
+}
+
+/** \ingroup group_util Test bit index of a mask. */
+inline bool MojoMaskTest( const uint64_t* mask, int index )
+{
+  return ( ( mask[ index >> 6 ] >> ( index & 63 ) ) & 1 ) != 0;
+}
+
+/** \ingroup group_util Clear bit index of a mask. */
+inline void MojoMaskClear( uint64_t* mask, int index )
+{
+  mask[ index >> 6 ] &= ~( ( uint64_t )1 << ( index & 63 ) );
+}
+
+/** \ingroup group_util True if none of the first count bits of a mask are set. */
+inline bool MojoMaskIsEmpty( const uint64_t* mask, int count )
+{
+  int word_count = MojoMaskWordCount( count );
+  for( int i = 0; i < word_count; ++i )
+  {
+    if( mask[ i ] )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** \ingroup group_util Number of bits set in a word. */
+inline int MojoPopCount( uint64_t word )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+  return __builtin_popcountll( word );
+#else
+  word = word - ( ( word >> 1 ) & 0x5555555555555555ULL );
+  word = ( word & 0x3333333333333333ULL ) + ( ( word >> 2 ) & 0x3333333333333333ULL );
+  word = ( word + ( word >> 4 ) ) & 0x0f0f0f0f0f0f0f0fULL;
+  return ( int )( ( word * 0x0101010101010101ULL ) >> 56 );
+#endif
+}
+
+/** \ingroup group_util Index of the lowest set bit in a word. The word must not be zero. */
+inline int MojoCountTrailingZeros( uint64_t word )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+  return __builtin_ctzll( word );
+#else
+  return MojoPopCount( ( word & ( 0 - word ) ) - 1 );
+#endif
+}
+
+/**
+ \ingroup group_util
+ Hint to the CPU that the memory at address will be read soon. Does nothing on compilers that lack the builtin.
+ */
+inline void MojoPrefetch( const void* address )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+  __builtin_prefetch( address );
+#else
+  ( void )address;
+#endif
+}
+
+/**
+ \ingroup group_util
+ A contiguous range of values in memory. See MojoArray::GetSpans().
+ */
+template< typename T >
+struct MojoSpan
+{
+  /// First value in the range.
+  T*  m_Values;
+  /// Number of values in the range.
+  int m_Count;
+};
+
 /**
  \ingroup group_util
  If your keys are unique integers and also well-distributed, for example ( 0xc94f1aa2, 0x278a827f, 0x18f12203 ),
@@ -32,6 +32,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
 
 // -- MojoLib
 #include "MojoLib.h"
@@ -57,6 +60,13 @@ static uint32_t Random()
   return ( rand() << 16 ) | rand();
 }
 
+// Separate generator, so tests that use it don't change the sequence that later tests get from Random().
+static uint32_t Random( uint32_t* seed )
+{
+  *seed = *seed * 1664525 + 1013904223;
+  return *seed >> 8;
+}
+
 // ---------------------------------------------------------------------------------------------------------------
 
 MojoMap< MojoHashable< void* >, const char* > g_AllocName( "g_AllocName", NULL );
@@ -83,6 +93,14 @@ public:
     m_ActiveAlloc -= 1;
     free( p );
   }
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t new_byte_count, const char* name ) override
+  {
+    new_byte_count += -new_byte_count & 15; // Make 16-byte aligned
+    g_AllocName.Remove( p );
+    void* new_p = realloc( p, new_byte_count );
+    g_AllocName.Insert( new_p ? new_p : p, name );
+    return new_p;
+  }
   void Print()
   {
     printf( "\n" );
@@ -340,6 +358,583 @@ REGISTER_UNIT_TEST( MojoArrayTestEdge, Container )
 
 // ---------------------------------------------------------------------------------------------------------------
 
+REGISTER_UNIT_TEST( MojoArrayContainsTest, Container )
+{
+  typedef MojoHash< uint64_t > Key;
+  const int n = 1000;
+  {
+    MojoArray< Key > array( "array" );
+    MojoArray< Key > indexed( "indexed" );
+    EXPECT_INT( kMojoStatus_Ok, indexed.CreateIndex() );
+    EXPECT_INT( kMojoStatus_DoubleInitialized, indexed.CreateIndex() );
+
+    // Wrap around the end of the ring buffer, so the values are in two spans.
+    for( int i = 1; i <= n; ++i )
+    {
+      array.Push( i );
+      indexed.Push( i );
+    }
+    for( int i = 1; i <= n / 2; ++i )
+    {
+      array.Shift();
+      indexed.Shift();
+      array.Push( n + i );
+      indexed.Push( n + i );
+    }
+    array.Unshift( 7 );
+    indexed.Unshift( 7 );
+    array.Insert( 100, 3 * n );
+    indexed.Insert( 100, 3 * n );
+
+    bool ok = true;
+    for( int i = 0; i <= 3 * n + 1; ++i )
+    {
+      bool expected = ( i > n / 2 && i <= n + n / 2 ) || i == 7 || i == 3 * n;
+      ok = ok && array.Contains( i ) == expected;
+      ok = ok && indexed.Contains( i ) == expected;
+    }
+    EXPECT_TRUE( ok );
+
+    // Values that remain after removal of a duplicate must still be found.
+    indexed.Push( 7 );
+    indexed.Remove( 0 );
+    EXPECT_TRUE( indexed.Contains( 7 ) );
+    indexed.Pop();
+    EXPECT_FALSE( indexed.Contains( 7 ) );
+    indexed.Clear();
+    EXPECT_FALSE( indexed.Contains( n ) );
+    indexed.Push( n );
+    EXPECT_TRUE( indexed.Contains( n ) );
+
+    // Replacing a value and removing a range update the index as well.
+    indexed.Push( n + 1 );
+    indexed.Push( n + 2 );
+    EXPECT_INT( n, indexed.SwapAt( 0, 5 ).GetHash() );
+    EXPECT_FALSE( indexed.Contains( n ) );
+    EXPECT_TRUE( indexed.Contains( 5 ) );
+    EXPECT_INT( kMojoStatus_Ok, indexed.RemoveRange( 1, 2 ) );
+    EXPECT_FALSE( indexed.Contains( n + 1 ) );
+    EXPECT_FALSE( indexed.Contains( n + 2 ) );
+    EXPECT_TRUE( indexed.Contains( 5 ) );
+
+    indexed.DestroyIndex();
+    EXPECT_TRUE( indexed.Contains( 5 ) );
+    EXPECT_FALSE( indexed.Contains( 7 ) );
+
+    // An index created on a filled array holds its values. Contains() only reads, so threads may share the array.
+    EXPECT_INT( kMojoStatus_Ok, array.CreateIndex() );
+    const int thread_count = 4;
+    std::atomic< int > error_count( 0 );
+    std::thread threads[ thread_count ];
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ] = std::thread( [ &array, &error_count ]()
+      {
+        for( int i = 0; i <= 3 * n + 1; ++i )
+        {
+          bool expected = ( i > n / 2 && i <= n + n / 2 ) || i == 7 || i == 3 * n;
+          error_count += array.Contains( i ) != expected;
+        }
+      } );
+    }
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ].join();
+    }
+    EXPECT_INT( 0, error_count.load() );
+
+    Key fixed_buffer[ 100 ];
+    MojoArray< Key > fixed( "fixed", Key(), NULL, NULL, fixed_buffer, 100 );
+    EXPECT_INT( kMojoStatus_CouldNotAlloc, fixed.CreateIndex() );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoArrayTrivialTest, Container )
+{
+  // Trivially copyable values take the memmove() path. RefCountedInt takes the element by element path. Apply the
+  // same random operations to both and compare.
+  uint32_t seed = 1;
+  {
+    MojoArray< int > array( "array" );
+    MojoArray< RefCountedInt > reference( "reference" );
+    bool ok = true;
+    for( int i = 0; i < 20000 && ok; ++i )
+    {
+      int count = array.GetCount();
+      int op = Random( &seed ) % 8;
+      int index = count ? ( int )( Random( &seed ) % count ) : 0;
+      if( op <= 2 || count < 2 )
+      {
+        array.Push( i );
+        reference.Push( i );
+      }
+      else if( op == 3 )
+      {
+        array.Unshift( i );
+        reference.Unshift( i );
+      }
+      else if( op == 4 )
+      {
+        array.Insert( index, i );
+        reference.Insert( index, i );
+      }
+      else if( op == 5 )
+      {
+        ok = ok && array.Remove( index ) == reference.Remove( index );
+      }
+      else if( op == 6 )
+      {
+        ok = ok && array.Shift() == reference.Shift();
+      }
+      else
+      {
+        int range = 1 + Random( &seed ) % 5;
+        array.RemoveRange( index, range );
+        reference.RemoveRange( index, range );
+      }
+      ok = ok && array.GetCount() == reference.GetCount();
+      if( ( i & 255 ) == 0 )
+      {
+        for( int j = 0; j < array.GetCount(); ++j )
+        {
+          ok = ok && array[ j ] == reference[ j ];
+        }
+      }
+    }
+    EXPECT_TRUE( ok );
+    for( int j = 0; j < array.GetCount(); ++j )
+    {
+      ok = ok && array[ j ] == reference[ j ];
+    }
+    EXPECT_TRUE( ok );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoArraySpanTest, Container )
+{
+  {
+    MojoArray< int > array( "array" );
+    MojoSpan< const int > first;
+    MojoSpan< const int > second;
+    array.GetSpans( &first, &second );
+    EXPECT_INT( 0, first.m_Count );
+    EXPECT_INT( 0, second.m_Count );
+
+    // Unshift wraps the start index around to the end of the buffer.
+    for( int i = 0; i < 100; ++i )
+    {
+      array.Push( i );
+      array.Unshift( -i - 1 );
+    }
+    array.GetSpans( &first, &second );
+    EXPECT_INT( array.GetCount(), first.m_Count + second.m_Count );
+    EXPECT_TRUE( second.m_Count > 0 );
+    bool ok = true;
+    for( int i = 0; i < array.GetCount(); ++i )
+    {
+      int value = i < first.m_Count ? first.m_Values[ i ] : second.m_Values[ i - first.m_Count ];
+      ok = ok && value == array[ i ] && value == i - 100;
+    }
+    EXPECT_TRUE( ok );
+
+    EXPECT_INT( kMojoStatus_Ok, array.Linearize() );
+    array.GetSpans( &first, &second );
+    EXPECT_INT( 200, first.m_Count );
+    EXPECT_INT( 0, second.m_Count );
+    for( int i = 0; i < first.m_Count; ++i )
+    {
+      ok = ok && first.m_Values[ i ] == i - 100;
+    }
+    EXPECT_TRUE( ok );
+  }
+  {
+    MojoArray< MojoId > array( "array" );
+    array.Push( "b" );
+    array.Push( "c" );
+    array.Unshift( "a" );
+    EXPECT_INT( kMojoStatus_Ok, array.Linearize() );
+    MojoSpan< const MojoId > first;
+    MojoSpan< const MojoId > second;
+    array.GetSpans( &first, &second );
+    EXPECT_INT( 3, first.m_Count );
+    EXPECT_INT( 0, second.m_Count );
+    EXPECT_TRUE( first.m_Values[ 0 ] == "a" );
+    EXPECT_TRUE( first.m_Values[ 1 ] == "b" );
+    EXPECT_TRUE( first.m_Values[ 2 ] == "c" );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoRingQueueTest, Container )
+{
+  const char* names[] = { "a", "b", "c", "d", "e", "f", "g", "h", "i" };
+  const MojoRingQueueMode modes[] =
+  {
+    kMojoRingQueueMode_SingleProducerSingleConsumer, kMojoRingQueueMode_MultiProducerMultiConsumer
+  };
+  for( int m = 0; m < 2; ++m )
+  {
+    MojoRingQueue< MojoId > queue( "queue", 5, modes[ m ] );
+    EXPECT_INT( kMojoStatus_Ok, queue.GetStatus() );
+    EXPECT_INT( 8, queue.GetCapacity() );
+    MojoId value;
+    EXPECT_FALSE( queue.Pop( &value ) );
+    bool ok = true;
+    for( int i = 0; i < 8; ++i )
+    {
+      ok = ok && queue.Push( MojoId( names[ i ] ) );
+    }
+    EXPECT_TRUE( ok );
+    EXPECT_FALSE( queue.Push( MojoId( names[ 8 ] ) ) );
+    EXPECT_INT( 8, queue.GetCount() );
+    EXPECT_TRUE( queue.Pop( &value ) );
+    EXPECT_TRUE( value == MojoId( names[ 0 ] ) );
+    EXPECT_TRUE( queue.Push( MojoId( names[ 8 ] ) ) );
+    for( int i = 1; i <= 8; ++i )
+    {
+      ok = ok && queue.Pop( &value ) && value == MojoId( names[ i ] );
+    }
+    EXPECT_TRUE( ok );
+    EXPECT_FALSE( queue.Pop( &value ) );
+    EXPECT_INT( 0, queue.GetCount() );
+  }
+  {
+    // One producer thread, one consumer thread. Values must arrive in order.
+    const int count = 200000;
+    MojoRingQueue< int > queue( "spsc", 64 );
+    std::thread producer( [ &queue, count ]()
+    {
+      for( int i = 1; i <= count; ++i )
+      {
+        while( !queue.Push( i ) )
+        {
+          std::this_thread::yield();
+        }
+      }
+    } );
+    bool ok = true;
+    int expected = 1;
+    while( expected <= count )
+    {
+      int value = 0;
+      if( queue.Pop( &value ) )
+      {
+        ok = ok && value == expected;
+        expected += 1;
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+    EXPECT_TRUE( ok );
+  }
+  {
+    // Several producers and consumers. Every value must arrive exactly once.
+    const int thread_count = 4;
+    const int count = 50000;
+    MojoRingQueue< int > queue( "mpmc", 64, kMojoRingQueueMode_MultiProducerMultiConsumer );
+    std::atomic< int > popped_count( 0 );
+    std::atomic< int64_t > popped_sum( 0 );
+    std::thread producers[ thread_count ];
+    std::thread consumers[ thread_count ];
+    for( int t = 0; t < thread_count; ++t )
+    {
+      producers[ t ] = std::thread( [ &queue, t, count ]()
+      {
+        for( int i = 1; i <= count; ++i )
+        {
+          while( !queue.Push( t * count + i ) )
+          {
+            std::this_thread::yield();
+          }
+        }
+      } );
+      consumers[ t ] = std::thread( [ &queue, &popped_count, &popped_sum, thread_count, count ]()
+      {
+        while( popped_count.load() < thread_count * count )
+        {
+          int value = 0;
+          if( queue.Pop( &value ) )
+          {
+            popped_sum += value;
+            popped_count += 1;
+          }
+          else
+          {
+            std::this_thread::yield();
+          }
+        }
+      } );
+    }
+    for( int t = 0; t < thread_count; ++t )
+    {
+      producers[ t ].join();
+      consumers[ t ].join();
+    }
+    int64_t total = ( int64_t )thread_count * count;
+    EXPECT_INT( thread_count * count, popped_count.load() );
+    EXPECT_TRUE( popped_sum.load() == total * ( total + 1 ) / 2 );
+    EXPECT_INT( 0, queue.GetCount() );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Runs jobs last to first, to show up jobs that depend on each other.
+class ReverseJobs final : public MojoJobs
+{
+public:
+  ReverseJobs() : m_RunCount( 0 ) {}
+  virtual void Run( void ( *function )( void* context, int index ), void* context, int count ) override
+  {
+    m_RunCount += 1;
+    for( int i = count - 1; i >= 0; --i )
+    {
+      function( context, i );
+    }
+  }
+  int m_RunCount;
+};
+
+struct LessByTens
+{
+  bool operator()( int a, int b ) const { return a / 10 < b / 10; }
+};
+
+REGISTER_UNIT_TEST( MojoArraySortTest, Container )
+{
+  uint32_t seed = 3;
+  {
+    MojoArray< MojoHash< uint64_t > > serial( "serial" );
+    MojoArray< MojoHash< uint64_t > > parallel( "parallel" );
+    for( int i = 0; i < 100000; ++i )
+    {
+      uint64_t value = 1 + ( ( uint64_t )( Random( &seed ) % 50000 ) << 24 );
+      serial.Unshift( value );
+      parallel.Unshift( value );
+    }
+
+    EXPECT_INT( kMojoStatus_Ok, serial.Sort() );
+    bool ok = true;
+    for( int i = 1; i < serial.GetCount(); ++i )
+    {
+      ok = ok && serial[ i - 1 ] <= serial[ i ];
+    }
+    EXPECT_TRUE( ok );
+
+    ReverseJobs jobs;
+    MojoJobs::SetDefault( &jobs );
+    EXPECT_INT( kMojoStatus_Ok, parallel.Sort() );
+    MojoJobs::SetDefault( NULL );
+    EXPECT_TRUE( jobs.m_RunCount > 0 );
+    EXPECT_INT( serial.GetCount(), parallel.GetCount() );
+    for( int i = 0; i < serial.GetCount(); ++i )
+    {
+      ok = ok && serial[ i ] == parallel[ i ];
+    }
+    EXPECT_TRUE( ok );
+
+    MojoSet< MojoHash< uint64_t > > set( "set" );
+    EXPECT_INT( kMojoStatus_Ok, parallel.ToSet( &set ) );
+    EXPECT_INT( kMojoStatus_Ok, serial.SortUnique() );
+    EXPECT_INT( set.GetCount(), serial.GetCount() );
+    for( int i = 0; i < serial.GetCount(); ++i )
+    {
+      ok = ok && set.Contains( serial[ i ] );
+      ok = ok && ( i == 0 || serial[ i - 1 ] < serial[ i ] );
+    }
+    EXPECT_TRUE( ok );
+  }
+  {
+    MojoArray< MojoId > ids( "ids" );
+    ids.Push( "delta" );
+    ids.Push( "alpha" );
+    ids.Push( MojoId() );
+    ids.Push( "charlie" );
+    ids.Push( "bravo" );
+    ids.Push( "alpha" );
+    EXPECT_INT( kMojoStatus_Ok, ids.SortBy( MojoIdLessByString() ) );
+    EXPECT_TRUE( ids[ 0 ].IsNull() );
+    EXPECT_TRUE( ids[ 1 ] == "alpha" );
+    EXPECT_TRUE( ids[ 2 ] == "alpha" );
+    EXPECT_TRUE( ids[ 3 ] == "bravo" );
+    EXPECT_TRUE( ids[ 4 ] == "charlie" );
+    EXPECT_TRUE( ids[ 5 ] == "delta" );
+    ids.Remove( 0 );
+    EXPECT_INT( kMojoStatus_Ok, ids.SortUnique() );
+    EXPECT_INT( 4, ids.GetCount() );
+  }
+  {
+    // Values that compare equal keep their order.
+    MojoArray< int > values( "values" );
+    for( int i = 0; i < 1000; ++i )
+    {
+      values.Push( ( 99 - i % 100 ) * 10 + i / 100 );
+    }
+    EXPECT_INT( kMojoStatus_Ok, values.SortBy( LessByTens() ) );
+    bool ok = true;
+    for( int i = 0; i < values.GetCount(); ++i )
+    {
+      ok = ok && values[ i ] == i;
+    }
+    EXPECT_TRUE( ok );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSegmentedArrayTest, Container )
+{
+  // Apply the same random operations to a segmented array and a plain array and compare. Biased towards growth,
+  // so the arrays span several segments.
+  uint32_t seed = 2;
+  {
+    MojoSegmentedArray< RefCountedInt > array( "array" );
+    MojoArray< int > reference( "reference" );
+    bool ok = true;
+    for( int i = 0; i < 40000 && ok; ++i )
+    {
+      int count = array.GetCount();
+      int op = Random( &seed ) % 14;
+      int index = count ? ( int )( Random( &seed ) % count ) : 0;
+      if( op <= 5 || count < 2 )
+      {
+        array.Push( i );
+        reference.Push( i );
+      }
+      else if( op == 6 )
+      {
+        array.Unshift( i );
+        reference.Unshift( i );
+      }
+      else if( op <= 8 )
+      {
+        array.Insert( index, i );
+        reference.Insert( index, i );
+      }
+      else if( op == 9 )
+      {
+        ok = ok && array.Remove( index ) == reference.Remove( index );
+      }
+      else if( op == 10 )
+      {
+        ok = ok && array.Shift() == reference.Shift();
+      }
+      else if( op == 11 )
+      {
+        ok = ok && array.Pop() == reference.Pop();
+      }
+      else
+      {
+        // Once the array is large, also remove ranges that span segments.
+        int range = 1 + Random( &seed ) % ( op == 13 && count > 4 * kMojoSegmentSize ? 2 * kMojoSegmentSize : 2 );
+        array.RemoveRange( index, range );
+        reference.RemoveRange( index, range );
+      }
+      ok = ok && array.GetCount() == reference.GetCount();
+      if( ( i & 1023 ) == 0 )
+      {
+        for( int j = 0; j < array.GetCount(); ++j )
+        {
+          ok = ok && array[ j ] == reference[ j ];
+        }
+      }
+    }
+    EXPECT_TRUE( ok );
+    EXPECT_TRUE( array.GetCount() > 2 * kMojoSegmentSize );
+    for( int j = 0; j < array.GetCount(); ++j )
+    {
+      ok = ok && array[ j ] == reference[ j ];
+    }
+    EXPECT_TRUE( ok );
+    EXPECT_TRUE( array.Contains( reference[ 100 ] ) );
+    EXPECT_FALSE( array.Contains( -1 ) );
+    EXPECT_NULL( array.GetPointerAt( array.GetCount() ) );
+
+    // Growing at either end does not move elements.
+    RefCountedInt* first = array.GetPointerAt( 0 );
+    RefCountedInt* last = array.GetPointerAt( -1 );
+    int first_value = *first;
+    int last_value = *last;
+    for( int i = 0; i < 10 * kMojoSegmentSize; ++i )
+    {
+      array.Push( i );
+      array.Unshift( i );
+    }
+    EXPECT_TRUE( first == array.GetPointerAt( 10 * kMojoSegmentSize ) );
+    EXPECT_TRUE( last == array.GetPointerAt( -10 * kMojoSegmentSize - 1 ) );
+    EXPECT_INT( first_value, *first );
+    EXPECT_INT( last_value, *last );
+
+    array.Clear();
+    EXPECT_INT( 0, array.GetCount() );
+    EXPECT_INT( kMojoStatus_IndexOutOfRange, array.Insert( 1, 1 ) );
+    EXPECT_INT( kMojoStatus_Ok, array.Insert( 0, 1 ) );
+  }
+
+  // Removing from the middle carries values across segments. No copies may be left behind past the end.
+  {
+    const int id_count = 2 * kMojoSegmentSize + 10;
+    int base_count = g_MojoIdManager.GetCount();
+    MojoSegmentedArray< MojoId > ids( "ids" );
+    char buffer[ 32 ];
+    for( int i = 0; i < id_count; ++i )
+    {
+      snprintf( buffer, sizeof buffer, "id%d", i );
+      ids.Push( buffer );
+    }
+    EXPECT_INT( base_count + id_count, g_MojoIdManager.GetCount() );
+    ids.Remove( 1 );
+    EXPECT_INT( base_count + id_count - 1, g_MojoIdManager.GetCount() );
+    // The first value of the last segment was carried into the segment before it. Remove it.
+    ids.Remove( 2 * kMojoSegmentSize - 1 );
+    EXPECT_INT( base_count + id_count - 2, g_MojoIdManager.GetCount() );
+
+    // Removing a range moves whichever side of it is shorter, across segments.
+    MojoArray< int > numbers( "numbers" );
+    for( int i = 0; i < id_count; ++i )
+    {
+      numbers.Push( i );
+    }
+    numbers.Remove( 1 );
+    numbers.Remove( 2 * kMojoSegmentSize - 1 );
+    const int ranges[][ 2 ] = { { kMojoSegmentSize - 20, kMojoSegmentSize / 2 }, { 10, 300 }, { 5, 2 } };
+    for( int r = 0; r < 3; ++r )
+    {
+      EXPECT_INT( kMojoStatus_Ok, ids.RemoveRange( ranges[ r ][ 0 ], ranges[ r ][ 1 ] ) );
+      numbers.RemoveRange( ranges[ r ][ 0 ], ranges[ r ][ 1 ] );
+    }
+    EXPECT_INT( numbers.GetCount(), ids.GetCount() );
+    EXPECT_INT( base_count + numbers.GetCount(), g_MojoIdManager.GetCount() );
+    bool ok = true;
+    for( int j = 0; j < numbers.GetCount(); ++j )
+    {
+      snprintf( buffer, sizeof buffer, "id%d", numbers[ j ] );
+      ok = ok && ids[ j ] == MojoId( buffer );
+    }
+    EXPECT_TRUE( ok );
+    numbers.Destroy();
+    ids.Destroy();
+    EXPECT_INT( base_count, g_MojoIdManager.GetCount() );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, RefCountedInt::s_InfoAssignedCount );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
 REGISTER_UNIT_TEST( MojoMapTest, Container )
 {
   MojoMap< MojoHash< uint32_t >, RefCountedInt > map;
@@ -536,6 +1131,251 @@ REGISTER_UNIT_TEST( MojoSetTestString, Container )
 
 // ---------------------------------------------------------------------------------------------------------------
 
+REGISTER_UNIT_TEST( MojoBitSetTest, Container )
+{
+  const int key_max = 5000;
+  uint32_t seed = 4321;
+  MojoBitSet< MojoHashable< int > > a( "a" );
+  MojoBitSet< MojoHashable< int > > b( "b", 1000 );
+  MojoBitSet< MojoHashable< int > > c( "c" );
+  MojoSet< MojoHashable< int > > a_ref( "a_ref" );
+  MojoSet< MojoHashable< int > > b_ref( "b_ref" );
+  MojoSet< MojoHashable< int > > c_ref( "c_ref" );
+
+  EXPECT_INT( kMojoStatus_InvalidArguments, a.Insert( 0 ) );
+  EXPECT_INT( kMojoStatus_InvalidArguments, a.Insert( -1 ) );
+  EXPECT_INT( kMojoStatus_NotFound, a.Remove( 10 ) );
+  for( int i = 1; i < key_max; ++i )
+  {
+    uint32_t r = Random( &seed );
+    if( r & 1 )
+    {
+      a.Insert( i );
+      a_ref.Insert( i );
+    }
+    if( ( r & 6 ) == 0 && i < key_max / 2 )
+    {
+      b.Insert( i );
+      b_ref.Insert( i );
+    }
+    if( r & 8 )
+    {
+      c.Insert( i );
+      c_ref.Insert( i );
+    }
+  }
+  a.Insert( 1 );
+  a_ref.Insert( 1 );
+  EXPECT_INT( a_ref.GetCount(), a.GetCount() );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &a, &a_ref ) );
+  EXPECT_FALSE( a.Contains( key_max * 10 ) );
+
+  // Iterate
+  int iteration_count = 0;
+  MojoHashable< int > key;
+  MojoForEachKey( b, key )
+  {
+    EXPECT_TRUE( b_ref.Contains( key ) );
+    iteration_count += 1;
+  }
+  EXPECT_INT( b_ref.GetCount(), iteration_count );
+
+  // Boolean sets of bitsets combine words, and must agree with the same boolean sets of hash sets.
+  MojoIntersection< MojoHashable< int > > intersection( &a, &b, &c );
+  MojoIntersection< MojoHashable< int > > intersection_ref( &a_ref, &b_ref, &c_ref );
+  MojoUnion< MojoHashable< int > > union_set( &b, &a );
+  MojoUnion< MojoHashable< int > > union_ref( &b_ref, &a_ref );
+  MojoDifference< MojoHashable< int > > difference( &a, &b, &c );
+  MojoDifference< MojoHashable< int > > difference_ref( &a_ref, &b_ref, &c_ref );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &intersection, &intersection_ref ) );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &union_set, &union_ref ) );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &difference, &difference_ref ) );
+
+  // With a limit that is not a bitset.
+  MojoDifference< MojoHashable< int > > a_minus_b( &a, &b );
+  MojoComplement< MojoHashable< int > > not_c( &c_ref );
+  MojoSet< MojoHashable< int > > limited( "limited" );
+  a_minus_b.Enumerate( MojoSetCollector< MojoHashable< int > >( &limited ), &not_c );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &limited, &difference_ref ) );
+
+  // Materialize the same results in place.
+  MojoBitSet< MojoHashable< int > > result( "result" );
+  result.Or( a );
+  result.And( b );
+  result.And( c );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &result, &intersection_ref ) );
+  result.Clear();
+  EXPECT_INT( 0, result.GetCount() );
+  result.Or( b );
+  result.Or( a );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &result, &union_ref ) );
+  result.Clear();
+  result.Or( a );
+  result.AndNot( b );
+  result.AndNot( c );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &result, &difference_ref ) );
+
+  // Remove
+  MojoForEachKey( a_ref, key )
+  {
+    EXPECT_INT( kMojoStatus_Ok, a.Remove( key ) );
+  }
+  EXPECT_INT( 0, a.GetCount() );
+  MojoArray< MojoHashable< int > > output( "output" );
+  intersection.Enumerate( MojoArrayCollector< MojoHashable< int > >( &output ) );
+  EXPECT_INT( 0, output.GetCount() );
+
+  a.Destroy();
+  b.Destroy();
+  c.Destroy();
+  a_ref.Destroy();
+  b_ref.Destroy();
+  c_ref.Destroy();
+  limited.Destroy();
+  result.Destroy();
+  output.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Key type where every four consecutive values share a hash, to exercise runs of equal hashes.
+class CollidingKey
+{
+public:
+  CollidingKey() : m_Value( 0 ) {}
+  CollidingKey( int value ) : m_Value( value ) {}
+  bool operator==( const CollidingKey& other ) const { return m_Value == other.m_Value; }
+  uint64_t GetHash() const
+  {
+    int group = m_Value / 4;
+    return MojoFnv64( ( const char* )&group, sizeof( group ) );
+  }
+  bool IsHashNull() const { return m_Value == 0; }
+  int m_Value;
+};
+
+REGISTER_UNIT_TEST( MojoSortedSetTest, Container )
+{
+  const int key_max = 4000;
+  uint32_t seed = 2468;
+  MojoSortedSet< CollidingKey > a( "a" );
+  MojoSortedSet< CollidingKey > b( "b" );
+  MojoSortedSet< CollidingKey > c( "c" );
+  MojoSet< MojoHashable< int > > a_ref( "a_ref" );
+  MojoSet< MojoHashable< int > > b_ref( "b_ref" );
+  MojoSet< MojoHashable< int > > c_ref( "c_ref" );
+  MojoArray< CollidingKey > c_keys( "c_keys" );
+
+  EXPECT_INT( kMojoStatus_InvalidArguments, a.Insert( 0 ) );
+  EXPECT_INT( kMojoStatus_NotFound, a.Remove( 10 ) );
+  for( int i = 1; i < key_max; ++i )
+  {
+    uint32_t r = Random( &seed );
+    if( r & 1 )
+    {
+      EXPECT_INT( kMojoStatus_Ok, a.Insert( i ) );
+      a_ref.Insert( i );
+    }
+    if( ( r & 6 ) == 0 )
+    {
+      EXPECT_INT( kMojoStatus_Ok, b.Insert( i ) );
+      b_ref.Insert( i );
+    }
+    if( r & 8 )
+    {
+      // Twice, so FromArray() has duplicates to remove.
+      c_keys.Push( i );
+      c_keys.Push( i );
+      c_ref.Insert( i );
+    }
+  }
+  EXPECT_INT( kMojoStatus_Ok, c.FromArray( &c_keys ) );
+  a.Insert( 1 );
+  a_ref.Insert( 1 );
+  EXPECT_INT( a_ref.GetCount(), a.GetCount() );
+  EXPECT_INT( c_ref.GetCount(), c.GetCount() );
+  for( int i = 0; i < key_max + 10; ++i )
+  {
+    EXPECT_INT( a_ref.Contains( i ), a.Contains( i ) );
+    EXPECT_INT( c_ref.Contains( i ), c.Contains( i ) );
+  }
+
+  // Iterate
+  int iteration_count = 0;
+  CollidingKey key;
+  MojoForEachKey( b, key )
+  {
+    EXPECT_TRUE( b_ref.Contains( key.m_Value ) );
+    iteration_count += 1;
+  }
+  EXPECT_INT( b_ref.GetCount(), iteration_count );
+
+  // Merges
+  MojoIntersection< MojoHashable< int > > ab_ref( &a_ref, &b_ref );
+  MojoIntersection< MojoHashable< int > > abc_ref( &a_ref, &b_ref, &c_ref );
+  MojoUnion< MojoHashable< int > > a_or_b_ref( &a_ref, &b_ref );
+  MojoDifference< MojoHashable< int > > a_minus_b_ref( &a_ref, &b_ref );
+  MojoSortedSet< CollidingKey > result( "result" );
+  EXPECT_INT( kMojoStatus_InvalidArguments, result.SetToIntersection( result, a ) );
+  const MojoAbstractSet< MojoHashable< int > >* expected[] = { &ab_ref, &a_or_b_ref, &a_minus_b_ref };
+  for( int op = 0; op < 3; ++op )
+  {
+    EXPECT_INT( kMojoStatus_Ok, op == 0 ? result.SetToIntersection( a, b ) :
+                                op == 1 ? result.SetToUnion( a, b ) : result.SetToDifference( a, b ) );
+    int match_count = 0;
+    MojoForEachKey( result, key )
+    {
+      match_count += expected[ op ]->Contains( key.m_Value );
+    }
+    EXPECT_INT( match_count, result.GetCount() );
+    for( int i = 1; i < key_max; ++i )
+    {
+      match_count -= expected[ op ]->Contains( i );
+    }
+    EXPECT_INT( 0, match_count );
+  }
+
+  // MojoIntersection merges when all inputs are sorted.
+  MojoIntersection< CollidingKey > abc( &a, &b, &c );
+  MojoArray< CollidingKey > output( "output" );
+  abc.Enumerate( MojoArrayCollector< CollidingKey >( &output ) );
+  int expected_count = 0;
+  for( int i = 1; i < key_max; ++i )
+  {
+    expected_count += abc_ref.Contains( i );
+  }
+  EXPECT_INT( expected_count, output.GetCount() );
+  for( int i = 0; i < output.GetCount(); ++i )
+  {
+    EXPECT_TRUE( abc_ref.Contains( output[ i ].m_Value ) );
+  }
+
+  // Remove
+  MojoHashable< int > int_key;
+  MojoForEachKey( a_ref, int_key )
+  {
+    EXPECT_INT( kMojoStatus_Ok, a.Remove( ( int )int_key ) );
+  }
+  EXPECT_INT( 0, a.GetCount() );
+  output.Clear();
+  abc.Enumerate( MojoArrayCollector< CollidingKey >( &output ) );
+  EXPECT_INT( 0, output.GetCount() );
+
+  a.Destroy();
+  b.Destroy();
+  c.Destroy();
+  a_ref.Destroy();
+  b_ref.Destroy();
+  c_ref.Destroy();
+  c_keys.Destroy();
+  result.Destroy();
+  output.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
 static MojoId MakeId( const char* group, int number )
 {
   char buffer[ 20 ];
@@ -734,18 +1574,222 @@ REGISTER_UNIT_TEST( MojoOneToManyTest, Function )
 
 // ---------------------------------------------------------------------------------------------------------------
 
-REGISTER_UNIT_TEST( MojoOneToOneTest, Function )
+REGISTER_UNIT_TEST( MojoHierarchyTest, Function )
 {
-  MojoOneToOne< MojoId, MojoId > one_to_one( "one_to_one" );
+  {
+    MojoOneToMany< MojoId, MojoId > tree( "tree" );
+    MojoHierarchy< MojoId > hierarchy( "hierarchy", &tree );
+
+    // R -> ( A -> ( A1 -> A1x, A2 ), B -> B1 )
+    // S -> S1
+    tree.InsertParentChild( "R", "A" );
+    tree.InsertParentChild( "R", "B" );
+    tree.InsertParentChild( "A", "A1" );
+    tree.InsertParentChild( "A", "A2" );
+    tree.InsertParentChild( "B", "B1" );
+    tree.InsertParentChild( "A1", "A1x" );
+    tree.InsertParentChild( "S", "S1" );
+
+    EXPECT_INT( 0, hierarchy.GetDepth( "R" ) );
+    EXPECT_INT( 1, hierarchy.GetDepth( "A" ) );
+    EXPECT_INT( 3, hierarchy.GetDepth( "A1x" ) );
+    EXPECT_INT( -1, hierarchy.GetDepth( "X" ) );
+
+    EXPECT_TRUE ( hierarchy.IsAncestorOf( "R", "A1x" ) );
+    EXPECT_TRUE ( hierarchy.IsAncestorOf( "A", "A1x" ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( "A1x", "A" ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( "B", "A1x" ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( "A", "A" ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( "S", "A" ) );
+
+    EXPECT_STRING( "A", hierarchy.FindLowestCommonAncestor( "A1x", "A2" ).AsCString() );
+    EXPECT_STRING( "R", hierarchy.FindLowestCommonAncestor( "A1x", "B1" ).AsCString() );
+    EXPECT_STRING( "A", hierarchy.FindLowestCommonAncestor( "A", "A1x" ).AsCString() );
+    EXPECT_STRING( "A1x", hierarchy.FindLowestCommonAncestor( "A1x", "A1x" ).AsCString() );
+    EXPECT_STRING( NULL, hierarchy.FindLowestCommonAncestor( "A1", "S1" ).AsCString() );
+
+    // Reparent B under S. Index must pick up the change.
+    tree.InsertParentChild( "S", "B" );
+    EXPECT_INT( 2, hierarchy.GetDepth( "B1" ) );
+    EXPECT_TRUE ( hierarchy.IsAncestorOf( "S", "B1" ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( "R", "B1" ) );
+    EXPECT_STRING( "S", hierarchy.FindLowestCommonAncestor( "S1", "B1" ).AsCString() );
+
+    // Removing a child detaches its subtree, which becomes a tree of its own.
+    tree.RemoveChild( "A" );
+    EXPECT_INT( 0, hierarchy.GetDepth( "A" ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( "R", "A1x" ) );
+    EXPECT_INT( -1, hierarchy.GetDepth( "R" ) ); // R has no children left
+
+    hierarchy.Destroy();
+    tree.Destroy();
+  }
 
-  one_to_one.InsertParentChild( "A", "A1" );
-  one_to_one.InsertParentChild( "A", "A2" );
-  one_to_one.InsertParentChild( "A", "A3" );
-  one_to_one.InsertParentChild( "A", "C1" );
+  // A long chain, to exercise jump pointers.
+  {
+    MojoOneToMany< MojoHash< uint32_t >, MojoHash< uint32_t > > chain( "chain" );
+    MojoHierarchy< MojoHash< uint32_t > > hierarchy( "hierarchy", &chain );
 
-  one_to_one.InsertParentChild( "B", "B1" );
-  one_to_one.InsertParentChild( "B", "B2" );
-  one_to_one.InsertParentChild( "B", "B3" );
+    const int chain_count = 10000;
+    for( int i = 1; i < chain_count; ++i )
+    {
+      chain.InsertParentChild( i, i + 1 );
+    }
+    chain.InsertParentChild( 5000, 20000 ); // A side branch
+
+    EXPECT_INT( chain_count - 1, hierarchy.GetDepth( chain_count ) );
+    EXPECT_TRUE ( hierarchy.IsAncestorOf( 1, chain_count ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( chain_count, 1 ) );
+    EXPECT_INT( 5000, hierarchy.FindLowestCommonAncestor( chain_count, 20000 ) );
+    EXPECT_INT( 1234, hierarchy.FindLowestCommonAncestor( 1234, 9876 ) );
+    EXPECT_INT( 4999, hierarchy.FindLowestCommonAncestor( 4999, 20000 ) );
+
+    hierarchy.Destroy();
+    chain.Destroy();
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoBatchTest, Container )
+{
+  const int n = 1000;
+
+  // Emptying and refilling a set inside a batch should not reallocate. Changes are counted as they are made.
+  {
+    MojoSet< MojoHash< uint32_t > > set( "set" );
+    for( int i = 1; i <= n; ++i )
+    {
+      set.Insert( i );
+    }
+    int change_count = set._GetChangeCount();
+    int total_alloc = MyCountingAlloc.m_TotalAlloc;
+
+    set._BeginBatch();
+    for( int i = 1; i <= n; ++i )
+    {
+      set.Remove( i );
+    }
+    EXPECT_INT( change_count + n, set._GetChangeCount() );
+    for( int i = 1; i <= n; ++i )
+    {
+      set.Insert( i );
+    }
+    set._EndBatch();
+
+    EXPECT_INT( total_alloc, MyCountingAlloc.m_TotalAlloc );
+    EXPECT_INT( change_count + 2 * n, set._GetChangeCount() );
+    EXPECT_INT( n, set.GetCount() );
+
+    // Shrink is deferred to the end of the batch, then done in one step.
+    set._BeginBatch();
+    for( int i = 1; i <= n; ++i )
+    {
+      set.Remove( i );
+    }
+    set._EndBatch();
+    EXPECT_INT( total_alloc + 1, MyCountingAlloc.m_TotalAlloc );
+    EXPECT_INT( 0, set.GetCount() );
+  }
+
+  // The value sets of a multimap do not shrink until the batch ends either.
+  {
+    MojoMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > multi_map( "multi_map" );
+    for( int i = 1; i <= n; ++i )
+    {
+      multi_map.Insert( 1, i );
+    }
+    multi_map._BeginBatch();
+    multi_map.Remove( 1, n );
+    int total_alloc = MyCountingAlloc.m_TotalAlloc;
+    for( int i = 2; i < n; ++i )
+    {
+      multi_map.Remove( 1, i );
+    }
+    EXPECT_INT( total_alloc, MyCountingAlloc.m_TotalAlloc );
+    EXPECT_INT( 1, multi_map.GetValueCount( 1 ) );
+    multi_map._EndBatch();
+    EXPECT_INT( total_alloc + 1, MyCountingAlloc.m_TotalAlloc );
+    EXPECT_INT( 1, multi_map.GetValueCount( 1 ) );
+    EXPECT_TRUE( multi_map.Contains( 1, 1 ) );
+  }
+
+  // Reparent all children in a batch. A cache that depends on the relation sees the change.
+  {
+    MojoOneToMany< MojoHash< uint32_t >, MojoHash< uint32_t > > rel( "rel" );
+    for( int i = 1; i <= n; ++i )
+    {
+      rel.InsertParentChild( n + 1, i );
+    }
+    MojoSet< MojoHash< uint32_t > > input( "input" );
+    input.Insert( n + 2 );
+    MojoFunction< MojoHash< uint32_t >, MojoHash< uint32_t > > children( &input, rel.GetParentToChildMultiMap() );
+    MojoCacheSet< MojoHash< uint32_t > > cache( "cache", &children );
+    cache.Update();
+    EXPECT_FALSE( cache.Contains( 1 ) );
+
+    int change_count = rel._GetChangeCount();
+    rel.BeginBatch();
+    for( int i = 1; i <= n; ++i )
+    {
+      rel.InsertParentChild( n + 2, i );
+    }
+    EXPECT_FALSE( change_count == rel._GetChangeCount() );
+    EXPECT_INT( n + 2, rel.FindParent( n / 2 ) ); // Changes are visible during the batch
+    rel.EndBatch();
+
+    EXPECT_FALSE( change_count == rel._GetChangeCount() );
+    EXPECT_FALSE( rel.ContainsParent( n + 1 ) );
+    EXPECT_INT( n, rel.FindChildren( n + 2 )->GetCount() );
+    EXPECT_FALSE( cache.Contains( 1 ) );
+    cache.Update();
+    EXPECT_TRUE( cache.Contains( 1 ) );
+    EXPECT_TRUE( cache.Contains( n ) );
+  }
+
+  // Objects that cache what they learn from a relation give current answers in the middle of a batch.
+  {
+    MojoOneToMany< MojoHash< uint32_t >, MojoHash< uint32_t > > rel( "rel" );
+    MojoHierarchy< MojoHash< uint32_t > > hierarchy( "hierarchy", &rel );
+    rel.InsertParentChild( 1, 2 );
+    rel.InsertParentChild( 2, 3 );
+    rel.InsertParentChild( 4, 5 );
+    MojoSet< MojoHash< uint32_t > > input( "input" );
+    input.Insert( 4 );
+    MojoFunction< MojoHash< uint32_t >, MojoHash< uint32_t > > children( &input, rel.GetParentToChildMultiMap() );
+    EXPECT_INT( 2, hierarchy.GetDepth( 3 ) );
+    children.BuildIndex();
+    EXPECT_FALSE( children.Contains( 3 ) );
+
+    rel.BeginBatch();
+    rel.InsertParentChild( 4, 3 );
+    EXPECT_INT( 1, hierarchy.GetDepth( 3 ) );
+    EXPECT_TRUE( hierarchy.IsAncestorOf( 4, 3 ) );
+    EXPECT_TRUE( children.Contains( 3 ) );
+    rel.InsertParentChild( 1, 3 );
+    EXPECT_INT( 1, hierarchy.GetDepth( 3 ) );
+    EXPECT_FALSE( hierarchy.IsAncestorOf( 4, 3 ) );
+    EXPECT_FALSE( children.Contains( 3 ) );
+    rel.EndBatch();
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoOneToOneTest, Function )
+{
+  MojoOneToOne< MojoId, MojoId > one_to_one( "one_to_one" );
+
+  one_to_one.InsertParentChild( "A", "A1" );
+  one_to_one.InsertParentChild( "A", "A2" );
+  one_to_one.InsertParentChild( "A", "A3" );
+  one_to_one.InsertParentChild( "A", "C1" );
+
+  one_to_one.InsertParentChild( "B", "B1" );
+  one_to_one.InsertParentChild( "B", "B2" );
+  one_to_one.InsertParentChild( "B", "B3" );
   one_to_one.InsertParentChild( "B", "C2" );
 
   one_to_one.InsertParentChild( "C", "C1" );
@@ -798,41 +1842,1070 @@ REGISTER_UNIT_TEST( MojoSetTestStatus, Config )
     config.m_BufferMinCount = key_max_count;
     config.m_DynamicAlloc = false;
 
-    MojoSet< MojoHashable< uint32_t > > set;
-    MojoStatus status = set.Create( __FUNCTION__, &config );
-    EXPECT_INT( kMojoStatus_Ok, status );
-    
-    // Now fill the whole table. This should work.
-    int max_fit = key_max_count * kMojoTableGrowThreshold / 100;
-    for( int i = 0; i < max_fit; ++i )
+    MojoSet< MojoHashable< uint32_t > > set;
+    MojoStatus status = set.Create( __FUNCTION__, &config );
+    EXPECT_INT( kMojoStatus_Ok, status );
+    
+    // Now fill the whole table. This should work.
+    int max_fit = key_max_count * kMojoTableGrowThreshold / 100;
+    for( int i = 0; i < max_fit; ++i )
+    {
+      status = set.Insert( i + 1 );
+      EXPECT_INT( kMojoStatus_Ok, status );
+    }
+
+    // More won't fit. Should not crash but report status.
+    for( int i = max_fit; i < max_fit + 10; ++i )
+    {
+      status = set.Insert( i + 1 );
+      EXPECT_INT( kMojoStatus_CouldNotAlloc, status );
+    }
+
+    // Verify that set is still functional.
+    for( int i = 0; i < max_fit; ++i )
+    {
+      status = set.Remove( i + 1 );
+      EXPECT_INT( kMojoStatus_Ok, status );
+    }
+    
+    // Verify keys are really gone.
+    for( int i = 0; i < max_fit; ++i )
+    {
+      EXPECT_FALSE( set.Contains( i + 1 ) );
+    }
+    
+    set.Destroy();
+    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  }
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSetResizePolicyTest, Config )
+{
+  // Load factors must leave room between growing and shrinking.
+  {
+    MojoConfig config;
+    config.m_MaxLoadPercent = 100;
+    MojoSet< MojoHashable< int > > set( __FUNCTION__, &config );
+    EXPECT_INT( kMojoStatus_InvalidArguments, set.GetStatus() );
+    config.m_MaxLoadPercent = 50;
+    config.m_MinLoadPercent = 25;
+    MojoMap< MojoHashable< int >, int > map( __FUNCTION__, 0, &config );
+    EXPECT_INT( kMojoStatus_InvalidArguments, map.GetStatus() );
+  }
+
+  const int cycle_count = 10;
+  const int key_count = 1000;
+  for( int policy = 0; policy < 3; ++policy )
+  {
+    MojoConfig config;
+    if( policy == 1 )
+    {
+      config.m_ShrinkDelay = 2 * key_count;
+    }
+    else if( policy == 2 )
+    {
+      config.m_MinLoadPercent = 0;
+    }
+    MojoSet< MojoHashable< int > > set( __FUNCTION__, &config );
+    MojoMap< MojoHashable< int >, int > map( __FUNCTION__, 0, &config );
+
+    // Fill up and empty out, over and over.
+    int first_set_resize_count = 0;
+    int first_map_resize_count = 0;
+    int cycle_set_resize_count = 0;
+    int cycle_map_resize_count = 0;
+    for( int cycle = 0; cycle < cycle_count; ++cycle )
+    {
+      for( int i = 1; i <= key_count; ++i )
+      {
+        set.Insert( i );
+        map.Insert( i, i );
+      }
+      for( int i = 1; i <= key_count; ++i )
+      {
+        set.Remove( i );
+        map.Remove( i );
+      }
+      if( cycle == 0 )
+      {
+        first_set_resize_count = set.GetResizeCount();
+        first_map_resize_count = map.GetResizeCount();
+      }
+      else if( cycle == 1 )
+      {
+        cycle_set_resize_count = set.GetResizeCount() - first_set_resize_count;
+        cycle_map_resize_count = map.GetResizeCount() - first_map_resize_count;
+      }
+    }
+    EXPECT_INT( 0, set.GetCount() );
+    EXPECT_INT( 0, map.GetCount() );
+    if( policy == 0 )
+    {
+      // Default policy shrinks and grows again on every cycle.
+      EXPECT_TRUE( cycle_set_resize_count > 0 );
+      EXPECT_INT( first_set_resize_count + ( cycle_count - 1 ) * cycle_set_resize_count, set.GetResizeCount() );
+      EXPECT_INT( first_map_resize_count + ( cycle_count - 1 ) * cycle_map_resize_count, map.GetResizeCount() );
+    }
+    else
+    {
+      // Only grows once.
+      EXPECT_TRUE( first_set_resize_count > 0 );
+      EXPECT_INT( first_set_resize_count, set.GetResizeCount() );
+      EXPECT_INT( first_map_resize_count, map.GetResizeCount() );
+    }
+    set.Destroy();
+    map.Destroy();
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoAllocAlignedTest, Config )
+{
+  // Aligned blocks come from the parent's Allocate(), with the block pointer stored just before the aligned pointer.
+  void* a = MyCountingAlloc.AllocateAligned( 100, 64, "a" );
+  void* b = MyCountingAlloc.AllocateAligned( 100, 4096, "b" );
+  EXPECT_INT( 2, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, ( int )( ( uintptr_t )a & 63 ) );
+  EXPECT_INT( 0, ( int )( ( uintptr_t )b & 4095 ) );
+  memset( a, 1, 100 );
+  memset( b, 2, 100 );
+  MyCountingAlloc.FreeAligned( a );
+  MyCountingAlloc.FreeAligned( b );
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  // Arrays grow and shrink through Reallocate(), keeping their contents.
+  MojoArray< int > array( "array" );
+  for( int i = 0; i < 1000; ++i )
+  {
+    array.Push( i );
+  }
+  for( int i = 0; i < 990; ++i )
+  {
+    array.Pop();
+  }
+  EXPECT_INT( 10, array.GetCount() );
+  bool ok = true;
+  for( int i = 0; i < 10; ++i )
+  {
+    ok = ok && array[ i ] == i;
+  }
+  EXPECT_TRUE( ok );
+  EXPECT_INT( 1, MyCountingAlloc.m_ActiveAlloc );
+  array.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoArenaAllocTest, Config )
+{
+  {
+    MojoArenaAlloc arena( 4096 );
+    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+    // Pieces of one block, aligned.
+    char* a = ( char* )arena.Allocate( 10, "a" );
+    char* b = ( char* )arena.Allocate( 10, "b" );
+    EXPECT_INT( 1, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 16, ( int )( b - a ) );
+    EXPECT_INT( 32, ( int )arena.GetUsedByteCount() );
+
+    // Only the most recent allocation is taken back, or grown in place.
+    arena.Free( a );
+    EXPECT_INT( 32, ( int )arena.GetUsedByteCount() );
+    arena.Free( b );
+    EXPECT_TRUE( arena.Allocate( 10, "c" ) == b );
+    EXPECT_TRUE( arena.Reallocate( b, 16, 1000, "c" ) == b );
+    EXPECT_INT( 16 + 1008, ( int )arena.GetUsedByteCount() );
+    EXPECT_NULL( arena.Reallocate( a, 16, 1000, "a" ) );
+    EXPECT_NULL( arena.Reallocate( b, 1008, 10000, "c" ) );
+
+    // Oversized allocations get a block of their own.
+    EXPECT_NOT_NULL( arena.Allocate( 10000, "big" ) );
+    EXPECT_INT( 2, MyCountingAlloc.m_ActiveAlloc );
+
+    // Containers allocate from the arena, and don't free.
+    {
+      MojoSet< MojoHash< int > > set( "set", NULL, &arena );
+      MojoMultiMap< MojoHash< int >, MojoHash< int > > multi_map( "multi_map", 0, NULL, &arena );
+      MojoArray< MojoId > ids( "ids", MojoId(), NULL, &arena );
+      for( int i = 1; i <= 1000; ++i )
+      {
+        set.Insert( i );
+        multi_map.Insert( i % 10 + 1, i );
+        ids.Push( "arena" );
+      }
+      EXPECT_INT( 1000, set.GetCount() );
+      EXPECT_TRUE( multi_map.Contains( 5, 994 ) );
+      EXPECT_INT( 1000, ids.GetCount() );
+    }
+    EXPECT_TRUE( MyCountingAlloc.m_ActiveAlloc > 2 );
+    // Values that need destruction are still destroyed.
+    EXPECT_NULL( MojoId::FindCString( MojoFnv64( "arena" ) ) );
+
+    arena.Reset();
+    EXPECT_INT( 0, ( int )arena.GetUsedByteCount() );
+    EXPECT_TRUE( MyCountingAlloc.m_ActiveAlloc <= 1 );
+
+    // A MojoArray that is the only user of the arena grows in place.
+    {
+      MojoArray< int > array( "array", 0, NULL, &arena );
+      for( int i = 0; i < 500; ++i )
+      {
+        array.Push( i );
+      }
+      MojoSpan< const int > span;
+      MojoSpan< const int > rest;
+      array.GetSpans( &span, &rest );
+      EXPECT_INT( 500, span.m_Count );
+      EXPECT_INT( 1, MyCountingAlloc.m_ActiveAlloc );
+      EXPECT_TRUE( arena.GetUsedByteCount() < 4096 );
+    }
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoPoolAllocTest, Config )
+{
+  {
+    MojoPoolAlloc pool;
+    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+    // Blocks of a size class are cut from one slab, and are recycled. The pool also keeps a table of its slabs.
+    char* a = ( char* )pool.Allocate( 100, "a" );
+    char* b = ( char* )pool.Allocate( 100, "b" );
+    EXPECT_INT( 2, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )a & 15 ) );
+    EXPECT_INT( 128, ( int )( b - a ) );
+    pool.Free( a );
+    EXPECT_TRUE( pool.Allocate( 90, "c" ) == a );
+    EXPECT_TRUE( pool.Reallocate( a, 90, 110, "c" ) == a );
+    EXPECT_NULL( pool.Reallocate( a, 110, 200, "c" ) );
+
+    // A power of 2 size fits its size class exactly, also when aligned. Blocks are aligned to their size class.
+    char* c = ( char* )pool.AllocateAligned( 1024, kMojoCacheLineSize, "c" );
+    char* d = ( char* )pool.AllocateAligned( 1024, kMojoCacheLineSize, "d" );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )c & 1023 ) );
+    EXPECT_INT( 1024, ( int )( d - c ) );
+    EXPECT_INT( 3, MyCountingAlloc.m_ActiveAlloc );
+    pool.FreeAligned( c );
+    pool.FreeAligned( d );
+
+    // Large blocks come from the parent.
+    void* large = pool.Allocate( kMojoPoolMaxSize + 1, "large" );
+    void* large_aligned = pool.AllocateAligned( kMojoPoolMaxSize + 1, kMojoCacheLineSize, "large" );
+    EXPECT_INT( 5, MyCountingAlloc.m_ActiveAlloc );
+    pool.Free( large );
+    pool.FreeAligned( large_aligned );
+    pool.Free( a );
+    pool.Free( b );
+    EXPECT_INT( 3, MyCountingAlloc.m_ActiveAlloc );
+
+    // Several threads allocating and freeing at once. Each checks that its blocks are not touched by others.
+    const int thread_count = 4;
+    std::atomic< int > error_count( 0 );
+    std::thread threads[ thread_count ];
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ] = std::thread( [ &pool, &error_count, t ]()
+      {
+        uint32_t seed = t + 1;
+        unsigned char* blocks[ 64 ] = {};
+        int sizes[ 64 ] = {};
+        for( int i = 0; i < 20000; ++i )
+        {
+          int slot = Random( &seed ) % 64;
+          if( blocks[ slot ] )
+          {
+            for( int j = 0; j < sizes[ slot ]; ++j )
+            {
+              error_count += blocks[ slot ][ j ] != ( unsigned char )( slot + t );
+            }
+            pool.Free( blocks[ slot ] );
+            blocks[ slot ] = NULL;
+          }
+          else
+          {
+            sizes[ slot ] = 1 + Random( &seed ) % 3000;
+            blocks[ slot ] = ( unsigned char* )pool.Allocate( sizes[ slot ], "thread" );
+            memset( blocks[ slot ], slot + t, sizes[ slot ] );
+          }
+        }
+        for( int slot = 0; slot < 64; ++slot )
+        {
+          pool.Free( blocks[ slot ] );
+        }
+      } );
+    }
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ].join();
+    }
+    EXPECT_INT( 0, error_count.load() );
+
+    // Containers.
+    {
+      MojoMultiMap< MojoHash< int >, MojoHash< int > > multi_map( "multi_map", 0, NULL, &pool );
+      for( int i = 1; i <= 1000; ++i )
+      {
+        multi_map.Insert( i % 100 + 1, i );
+      }
+      EXPECT_TRUE( multi_map.Contains( 5, 904 ) );
+    }
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+static MojoAllocStats FindStats( const MojoArray< MojoAllocStats >& snapshot, const char* name )
+{
+  for( int i = 0; i < snapshot.GetCount(); ++i )
+  {
+    if( !strcmp( snapshot[ i ].m_Name, name ) )
+    {
+      return snapshot[ i ];
+    }
+  }
+  return MojoAllocStats();
+}
+
+REGISTER_UNIT_TEST( MojoTelemetryAllocTest, Config )
+{
+  {
+    char name[ 16 ];
+    MojoTelemetryAlloc telemetry;
+    MojoArray< MojoAllocStats > snapshot( "snapshot" );
+    {
+      MojoSet< MojoHash< int > > set( "telemetry set", NULL, &telemetry );
+      MojoArray< int > array( "telemetry array", 0, NULL, &telemetry );
+      for( int i = 1; i <= 1000; ++i )
+      {
+        set.Insert( i );
+        array.Push( i );
+      }
+
+      // Same text at a different address counts as the same name. The text is copied, so the name may change.
+      strcpy( name, "telemetry set" );
+      void* p = telemetry.Allocate( 100, name );
+      strcpy( name, "changed" );
+
+      EXPECT_INT( kMojoStatus_Ok, telemetry.GetSnapshot( &snapshot ) );
+      MojoAllocStats set_stats = FindStats( snapshot, "telemetry set" );
+      MojoAllocStats array_stats = FindStats( snapshot, "telemetry array" );
+      EXPECT_INT( 2, ( int )set_stats.m_LiveCount );
+      EXPECT_TRUE( set_stats.m_LiveBytes >= 1000 * ( int )sizeof( MojoHash< int > ) + 100 );
+      EXPECT_TRUE( set_stats.m_AllocCount > 2 );
+      EXPECT_TRUE( set_stats.m_ResizeCount > 0 );
+      EXPECT_INT( 0, ( int )FindStats( snapshot, "changed" ).m_LiveCount );
+      EXPECT_INT( 1, ( int )array_stats.m_LiveCount );
+      EXPECT_TRUE( array_stats.m_LiveBytes >= 1000 * ( int )sizeof( int ) );
+      EXPECT_TRUE( array_stats.m_ResizeCount > 0 );
+
+      // Sorted by live bytes.
+      bool ok = true;
+      for( int i = 1; i < snapshot.GetCount(); ++i )
+      {
+        ok = ok && snapshot[ i - 1 ].m_LiveBytes >= snapshot[ i ].m_LiveBytes;
+      }
+      EXPECT_TRUE( ok );
+      telemetry.Free( p );
+    }
+    EXPECT_INT( kMojoStatus_Ok, telemetry.GetSnapshot( &snapshot ) );
+    MojoAllocStats set_stats = FindStats( snapshot, "telemetry set" );
+    EXPECT_INT( 0, ( int )set_stats.m_LiveBytes );
+    EXPECT_INT( 0, ( int )set_stats.m_LiveCount );
+    EXPECT_TRUE( set_stats.m_PeakBytes > 0 );
+    EXPECT_INT( 0, ( int )telemetry.GetTotal().m_LiveBytes );
+
+    telemetry.ResetCounts();
+    EXPECT_INT( 0, ( int )telemetry.GetTotal().m_PeakBytes );
+    EXPECT_INT( 0, ( int )telemetry.GetTotal().m_AllocCount );
+
+    FILE* file = tmpfile();
+    telemetry.Print( file );
+    EXPECT_TRUE( ftell( file ) > 0 );
+    fclose( file );
+  }
+  {
+    // A resize that fails is not counted. The caller allocates a new block instead.
+    MojoPoolAlloc pool;
+    MojoTelemetryAlloc telemetry( &pool );
+    void* p = telemetry.Allocate( 100, "resize" );
+    EXPECT_NULL( telemetry.Reallocate( p, 100, 100000, "resize" ) );
+    EXPECT_INT( 0, ( int )telemetry.GetTotal().m_ResizeCount );
+    telemetry.Free( p );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoHugePageAllocTest, Config )
+{
+  {
+    MojoHugePageAlloc huge;
+
+    // Small blocks go to the fallback.
+    void* small = huge.Allocate( 1000, "small" );
+    EXPECT_INT( 1, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 0, ( int )huge.GetMappedByteCount() );
+    huge.Free( small );
+
+#if defined( __linux__ )
+    // Large blocks are mapped, and grow and shrink without losing their contents.
+    const size_t mb = 1024 * 1024;
+    unsigned char* p = ( unsigned char* )huge.Allocate( 3 * mb, "large" );
+    EXPECT_NOT_NULL( p );
+    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 4, ( int )( huge.GetMappedByteCount() / mb ) );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p & 63 ) );
+    for( size_t i = 0; i < 3 * mb; i += 4096 )
+    {
+      p[ i ] = ( unsigned char )( i / 4096 );
+    }
+    p = ( unsigned char* )huge.Reallocate( p, 3 * mb, 9 * mb, "large" );
+    EXPECT_NOT_NULL( p );
+    EXPECT_INT( 10, ( int )( huge.GetMappedByteCount() / mb ) );
+    bool ok = true;
+    for( size_t i = 0; i < 3 * mb; i += 4096 )
+    {
+      ok = ok && p[ i ] == ( unsigned char )( i / 4096 );
+    }
+    EXPECT_TRUE( ok );
+    unsigned char* shrunk = ( unsigned char* )huge.Reallocate( p, 9 * mb, 2 * mb, "large" );
+    EXPECT_TRUE( shrunk == p );
+    for( size_t i = 0; i < 2 * mb; i += 4096 )
+    {
+      ok = ok && p[ i ] == ( unsigned char )( i / 4096 );
+    }
+    EXPECT_TRUE( ok );
+    EXPECT_NULL( huge.Reallocate( p, 2 * mb, 1000, "large" ) );
+    huge.Free( p );
+    EXPECT_INT( 0, ( int )huge.GetMappedByteCount() );
+
+    // A table large enough to be mapped.
+    {
+      MojoMap< MojoHash< uint64_t >, uint64_t > map( "huge map", 0, NULL, &huge );
+      for( uint64_t i = 1; i <= 200000; ++i )
+      {
+        map.Insert( i * 7919, i );
+      }
+      EXPECT_TRUE( huge.GetMappedByteCount() > 0 );
+      for( uint64_t i = 1; i <= 200000; ++i )
+      {
+        ok = ok && map.Find( i * 7919 ) == i;
+      }
+      EXPECT_TRUE( ok );
+    }
+    EXPECT_INT( 0, ( int )huge.GetMappedByteCount() );
+#endif
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Plain malloc() and free(), to compare against.
+class MallocAlloc final : public MojoAlloc
+{
+public:
+  virtual void* Allocate( size_t byte_count, const char* name ) override
+  {
+    return malloc( byte_count );
+  }
+  virtual void Free( void* p ) override
+  {
+    free( p );
+  }
+};
+
+// Insert and remove keys of a multimap, so its table and value sets keep growing and shrinking.
+static int MultiMapChurn( MojoAlloc* alloc )
+{
+  MojoMultiMap< MojoHash< int >, MojoHash< int > > multi_map( "churn", 0, NULL, alloc );
+  uint32_t seed = 5;
+  for( int round = 0; round < 20; ++round )
+  {
+    for( int i = 0; i < 5000; ++i )
+    {
+      multi_map.Insert( 1 + Random( &seed ) % 2000, i + 1 );
+    }
+    for( int key = 1; key <= 2000; ++key )
+    {
+      multi_map.Remove( key );
+    }
+  }
+  return multi_map.GetCount();
+}
+
+// Random Find() in a large table. With regular pages, most lookups miss the TLB.
+static int RandomFindNanoseconds( MojoAlloc* alloc, int key_count )
+{
+  MojoMap< MojoHash< uint64_t >, uint64_t > map( "find", 0, NULL, alloc );
+  for( int i = 1; i <= key_count; ++i )
+  {
+    map.Insert( ( uint64_t )i * 0x9E3779B97F4A7C15ull, i );
+  }
+  uint32_t seed = 7;
+  uint64_t sum = 0;
+  const int lookup_count = 1000000;
+  clock_t start = clock();
+  for( int i = 0; i < lookup_count; ++i )
+  {
+    sum += map.Find( ( uint64_t )( 1 + Random( &seed ) % key_count ) * 0x9E3779B97F4A7C15ull );
+  }
+  clock_t time = clock() - start;
+  return sum ? ( int )( ( double )time * 1e9 / CLOCKS_PER_SEC / lookup_count ) : -1;
+}
+
+REGISTER_UNIT_TEST( MojoHugePageAllocFindTest, Benchmark )
+{
+  // Production tables span several GB. This one spans 32 MB, which is already well beyond what the TLB covers with
+  // regular pages.
+  const int key_count = 1 << 20;
+  MallocAlloc malloc_alloc;
+  MojoHugePageAlloc huge( &malloc_alloc );
+  int malloc_time = RandomFindNanoseconds( &malloc_alloc, key_count );
+  int huge_time = RandomFindNanoseconds( &huge, key_count );
+  EXPECT_TRUE( malloc_time >= 0 && huge_time >= 0 );
+  printf( "malloc %d ns, MojoHugePageAlloc %d ns ", malloc_time, huge_time );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Deep expansion as it was done before MojoTraversal: recurse into every child, with no visited set.
+static void ExpandWithoutVisited( const MojoMultiMap< MojoHashable< int >, MojoHashable< int > >* multi_map,
+                                  const MojoHashable< int >& node, MojoSet< MojoHashable< int > >* output )
+{
+  const MojoSet< MojoHashable< int > >* values = multi_map->Find( node );
+  if( values )
+  {
+    MojoHashable< int > value;
+    MojoForEachKey( *values, value )
+    {
+      output->Insert( value );
+      ExpandWithoutVisited( multi_map, value, output );
+    }
+  }
+}
+
+REGISTER_UNIT_TEST( MojoTraversalWideDagTest, Benchmark )
+{
+  // A dependency graph of 11 layers, 2000 nodes wide. Every node depends on 3 random nodes in the next layer, so
+  // nodes are shared by many paths.
+  const int layer_count = 11;
+  const int width = 2000;
+  uint32_t seed = 4242;
+  MojoMultiMap< MojoHashable< int >, MojoHashable< int > > multi_map( "multi_map" );
+  MojoSet< MojoHashable< int > > roots( "roots" );
+  for( int layer = 0; layer < layer_count - 1; ++layer )
+  {
+    for( int i = 0; i < width; ++i )
+    {
+      for( int j = 0; j < 3; ++j )
+      {
+        multi_map.Insert( 1 + layer * width + i, 1 + ( layer + 1 ) * width + ( int )( Random( &seed ) % width ) );
+      }
+    }
+  }
+  for( int i = 0; i < width; i += 100 )
+  {
+    roots.Insert( 1 + i );
+  }
+
+  MojoSet< MojoHashable< int > > recursive_output( "recursive_output" );
+  clock_t start = clock();
+  MojoHashable< int > root;
+  MojoForEachKey( roots, root )
+  {
+    ExpandWithoutVisited( &multi_map, root, &recursive_output );
+  }
+  clock_t recursive_time = clock() - start;
+
+  MojoSet< MojoHashable< int > > traversal_output( "traversal_output" );
+  clock_t traversal_time;
+  {
+    MojoFunctionDeep< MojoHashable< int > > deep( &roots, &multi_map );
+    start = clock();
+    deep.Enumerate( MojoSetCollector< MojoHashable< int > >( &traversal_output ) );
+    traversal_time = clock() - start;
+  }
+
+  EXPECT_INT( recursive_output.GetCount(), traversal_output.GetCount() );
+
+  multi_map.Destroy();
+  roots.Destroy();
+  recursive_output.Destroy();
+  traversal_output.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "recursive %d ms, MojoTraversal %d ms ", ( int )( recursive_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( traversal_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoPoolAllocChurnTest, Benchmark )
+{
+  MallocAlloc malloc_alloc;
+  MojoPoolAlloc pool( &malloc_alloc );
+
+  clock_t start = clock();
+  EXPECT_INT( 0, MultiMapChurn( &malloc_alloc ) );
+  clock_t malloc_time = clock() - start;
+
+  start = clock();
+  EXPECT_INT( 0, MultiMapChurn( &pool ) );
+  clock_t pool_time = clock() - start;
+
+  printf( "malloc %d ms, MojoPoolAlloc %d ms ", ( int )( malloc_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( pool_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+// Forwards to another set, after some busy work. Counts calls to Contains().
+class ProbeCountingSet final : public MojoAbstractSet< MojoHashable< int > >
+{
+public:
+  ProbeCountingSet( const MojoAbstractSet< MojoHashable< int > >* set, int work )
+  : m_CallCount( 0 )
+  , m_Set( set )
+  , m_Work( work )
+  , m_Sink( 0 )
+  {}
+  virtual bool Contains( const MojoHashable< int >& key ) const override
+  {
+    m_CallCount += 1;
+    for( int i = 0; i < m_Work; ++i )
+    {
+      m_Sink = m_Sink * 1664525 + 1013904223;
+    }
+    return m_Set->Contains( key );
+  }
+  virtual bool Enumerate( const MojoCollector< MojoHashable< int > >& collector,
+                         const MojoAbstractSet< MojoHashable< int > >* limit ) const override
+  {
+    return m_Set->Enumerate( collector, limit );
+  }
+  virtual int _GetEnumerationCost() const override { return m_Set->_GetEnumerationCost(); }
+  virtual int _GetChangeCount() const override { return m_Set->_GetChangeCount(); }
+  mutable int m_CallCount;
+private:
+  const MojoAbstractSet< MojoHashable< int > >* m_Set;
+  int                                           m_Work;
+  mutable volatile uint32_t                     m_Sink;
+};
+
+// Counts keys, and the calls that delivered them. Push() is only called if PushBatch() is not overridden.
+class CountingCollector final : public MojoCollector< MojoHashable< int > >
+{
+public:
+  CountingCollector( bool batched )
+  : m_Batched( batched )
+  , m_KeyCount( 0 )
+  , m_CallCount( 0 )
+  {}
+  virtual bool Push( const MojoHashable< int >& ) const override
+  {
+    m_KeyCount += 1;
+    m_CallCount += 1;
+    return true;
+  }
+  virtual bool PushBatch( const MojoHashable< int >* values, int count ) const override
+  {
+    if( !m_Batched )
+    {
+      return MojoCollector< MojoHashable< int > >::PushBatch( values, count );
+    }
+    m_KeyCount += count;
+    m_CallCount += 1;
+    return true;
+  }
+  bool        m_Batched;
+  mutable int m_KeyCount;
+  mutable int m_CallCount;
+};
+
+REGISTER_UNIT_TEST( MojoAdaptiveProbeTest, Benchmark )
+{
+  const int key_count = 1000000;
+  MojoSet< MojoHashable< int > > few( "few" );
+  for( int i = 1; i <= key_count; i += 100 )
+  {
+    few.Insert( i );
+  }
+  MojoComplement< MojoHashable< int > > everything;
+  MojoComplement< MojoHashable< int > > most( &few );
+
+  // Intersection of a slow set that has every key, and a small set, added in the worst order.
+  ProbeCountingSet slow( &everything, 100 );
+  MojoIntersection< MojoHashable< int > > intersection( &slow, &few );
+  clock_t start = clock();
+  int fixed_count = 0;
+  for( int i = 1; i <= key_count; ++i )
+  {
+    fixed_count += slow.Contains( i ) && few.Contains( i );
+  }
+  clock_t intersection_fixed_time = clock() - start;
+  slow.m_CallCount = 0;
+  start = clock();
+  int adaptive_count = 0;
+  for( int i = 1; i <= key_count; ++i )
+  {
+    adaptive_count += intersection.Contains( i );
+  }
+  clock_t intersection_adaptive_time = clock() - start;
+  EXPECT_INT( key_count / 100, adaptive_count );
+  EXPECT_INT( fixed_count, adaptive_count );
+  EXPECT_TRUE( slow.m_CallCount < key_count / 10 );
+
+  // Union of a set that rarely has the key, and a set that nearly always does, added in the worst order.
+  ProbeCountingSet rare( &few, 0 );
+  MojoUnion< MojoHashable< int > > union_set( &rare, &most );
+  start = clock();
+  fixed_count = 0;
+  for( int i = 1; i <= key_count; ++i )
+  {
+    fixed_count += rare.Contains( i ) || most.Contains( i );
+  }
+  clock_t union_fixed_time = clock() - start;
+  rare.m_CallCount = 0;
+  start = clock();
+  adaptive_count = 0;
+  for( int i = 1; i <= key_count; ++i )
+  {
+    adaptive_count += union_set.Contains( i );
+  }
+  clock_t union_adaptive_time = clock() - start;
+  EXPECT_INT( key_count, adaptive_count );
+  EXPECT_INT( fixed_count, adaptive_count );
+  EXPECT_TRUE( rare.m_CallCount < key_count / 10 );
+
+  few.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "intersection %d ms / %d ms, union %d ms / %d ms ",
+         ( int )( intersection_fixed_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( intersection_adaptive_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( union_fixed_time * 1000 / CLOCKS_PER_SEC ), ( int )( union_adaptive_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoBatchEnumerateTest, Benchmark )
+{
+  const int key_count = 2000000;
+  MojoSet< MojoHashable< int > > all( "all" );
+  MojoSet< MojoHashable< int > > half( "half" );
+  for( int i = 1; i <= key_count; ++i )
+  {
+    all.Insert( i );
+    if( i & 1 )
+    {
+      half.Insert( i );
+    }
+  }
+
+  // A limit without a ContainsBatch() override, and a collector without a PushBatch() override, take one virtual
+  // call per key, as before.
+  ProbeCountingSet half_single( &half, 0 );
+  CountingCollector single( false );
+  clock_t start = clock();
+  all.Enumerate( single, &half_single );
+  clock_t single_time = clock() - start;
+
+  CountingCollector batched( true );
+  start = clock();
+  all.Enumerate( batched, &half );
+  clock_t batched_time = clock() - start;
+
+  EXPECT_INT( key_count / 2, single.m_KeyCount );
+  EXPECT_INT( key_count / 2, batched.m_KeyCount );
+
+  all.Destroy();
+  half.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "per key %d ms, batched %d ms ", ( int )( single_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( batched_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoBitSetBooleanTest, Benchmark )
+{
+  const int key_count = 2000000;
+  MojoSet< MojoHashable< int > > set_a( "set_a" );
+  MojoSet< MojoHashable< int > > set_b( "set_b" );
+  MojoBitSet< MojoHashable< int > > bits_a( "bits_a" );
+  MojoBitSet< MojoHashable< int > > bits_b( "bits_b" );
+  for( int i = 1; i <= key_count; ++i )
+  {
+    if( i % 2 == 0 )
+    {
+      set_a.Insert( i );
+      bits_a.Insert( i );
+    }
+    if( i % 3 == 0 )
+    {
+      set_b.Insert( i );
+      bits_b.Insert( i );
+    }
+  }
+
+  MojoIntersection< MojoHashable< int > > set_intersection( &set_a, &set_b );
+  CountingCollector set_keys( true );
+  clock_t start = clock();
+  set_intersection.Enumerate( set_keys );
+  clock_t set_time = clock() - start;
+
+  MojoIntersection< MojoHashable< int > > bits_intersection( &bits_a, &bits_b );
+  CountingCollector bits_keys( true );
+  start = clock();
+  bits_intersection.Enumerate( bits_keys );
+  clock_t bits_time = clock() - start;
+
+  EXPECT_INT( key_count / 6, set_keys.m_KeyCount );
+  EXPECT_INT( key_count / 6, bits_keys.m_KeyCount );
+
+  set_a.Destroy();
+  set_b.Destroy();
+  bits_a.Destroy();
+  bits_b.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "MojoSet %d ms, MojoBitSet %d ms ", ( int )( set_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( bits_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSortedSetIntersectionTest, Benchmark )
+{
+  const int key_count = 2000000;
+  MojoArray< MojoHashable< int > > even_keys( "even_keys" );
+  MojoArray< MojoHashable< int > > third_keys( "third_keys" );
+  for( int i = 1; i <= key_count; ++i )
+  {
+    if( i % 2 == 0 )
+    {
+      even_keys.Push( i );
+    }
+    if( i % 3 == 0 )
+    {
+      third_keys.Push( i );
+    }
+  }
+  MojoSet< MojoHashable< int > > even_set( "even_set" );
+  MojoSet< MojoHashable< int > > third_set( "third_set" );
+  even_set.FromArray( &even_keys );
+  third_set.FromArray( &third_keys );
+  MojoSortedSet< MojoHashable< int > > even_sorted( "even_sorted" );
+  MojoSortedSet< MojoHashable< int > > third_sorted( "third_sorted" );
+  even_sorted.FromArray( &even_keys );
+  third_sorted.FromArray( &third_keys );
+
+  MojoIntersection< MojoHashable< int > > set_intersection( &even_set, &third_set );
+  CountingCollector set_keys( true );
+  clock_t start = clock();
+  set_intersection.Enumerate( set_keys );
+  clock_t set_time = clock() - start;
+
+  MojoIntersection< MojoHashable< int > > sorted_intersection( &even_sorted, &third_sorted );
+  CountingCollector sorted_keys( true );
+  start = clock();
+  sorted_intersection.Enumerate( sorted_keys );
+  clock_t sorted_time = clock() - start;
+
+  EXPECT_INT( key_count / 6, set_keys.m_KeyCount );
+  EXPECT_INT( key_count / 6, sorted_keys.m_KeyCount );
+
+  even_keys.Destroy();
+  third_keys.Destroy();
+  even_set.Destroy();
+  third_set.Destroy();
+  even_sorted.Destroy();
+  third_sorted.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "MojoSet %d ms, MojoSortedSet %d ms ", ( int )( set_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( sorted_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoCacheSetUpdateTest, Benchmark )
+{
+  const int key_count = 1000000;
+  const int update_count = 20;
+  MojoConfig config;
+  config.m_ChangeLogCount = 1024;
+  MojoSet< MojoHashable< int > > logged_a( "logged_a", &config );
+  MojoSet< MojoHashable< int > > logged_b( "logged_b", &config );
+  MojoSet< MojoHashable< int > > plain_a( "plain_a" );
+  MojoSet< MojoHashable< int > > plain_b( "plain_b" );
+  for( int i = 1; i <= key_count; ++i )
+  {
+    logged_a.Insert( i );
+    plain_a.Insert( i );
+    if( i & 1 )
+    {
+      logged_b.Insert( i );
+      plain_b.Insert( i );
+    }
+  }
+  MojoIntersection< MojoHashable< int > > logged_intersection( &logged_a, &logged_b );
+  MojoIntersection< MojoHashable< int > > plain_intersection( &plain_a, &plain_b );
+  MojoCacheSet< MojoHashable< int > > logged_cache( "logged_cache", &logged_intersection );
+  MojoCacheSet< MojoHashable< int > > plain_cache( "plain_cache", &plain_intersection );
+  logged_cache.Update();
+  plain_cache.Update();
+
+  // One insert into a leaf, then update the cache, over and over.
+  clock_t start = clock();
+  for( int i = 0; i < update_count; ++i )
+  {
+    plain_b.Insert( 2 * i + 2 );
+    plain_cache.Update();
+  }
+  clock_t rebuild_time = clock() - start;
+  start = clock();
+  for( int i = 0; i < update_count; ++i )
+  {
+    logged_b.Insert( 2 * i + 2 );
+    logged_cache.Update();
+  }
+  clock_t delta_time = clock() - start;
+
+  EXPECT_INT( update_count + 1, plain_cache.GetRebuildCount() );
+  EXPECT_INT( 1, logged_cache.GetRebuildCount() );
+  EXPECT_INT( key_count / 2 + update_count, logged_cache._GetEnumerationCost() );
+  EXPECT_INT( key_count / 2 + update_count, plain_cache._GetEnumerationCost() );
+
+  printf( "rebuild %d ms, apply changes %d ms ", ( int )( rebuild_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( delta_time * 1000 / CLOCKS_PER_SEC ) );
+}
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoUnionScratchTest, Benchmark )
+{
+  const int key_count = 200000;
+  const int input_count = 10;
+  MojoSet< MojoHashable< int > > inputs[ input_count ];
+  MojoUnion< MojoHashable< int > > set_union;
+  for( int i = 0; i < input_count; ++i )
+  {
+    // Each input overlaps half of the one before it.
+    inputs[ i ].Create( "input" );
+    for( int j = 1; j <= key_count; ++j )
+    {
+      inputs[ i ].Insert( i * key_count / 2 + j );
+    }
+    set_union.Add( &inputs[ i ] );
+  }
+
+  // What MojoUnion did before: enumerate each input with the inputs before it as a limit.
+  CountingCollector limited_keys( true );
+  MojoComplement< MojoHashable< int > > combined_limit;
+  clock_t start = clock();
+  inputs[ 0 ].Enumerate( limited_keys );
+  for( int i = 1; i < input_count; ++i )
+  {
+    combined_limit.Add( &inputs[ i - 1 ] );
+    inputs[ i ].Enumerate( limited_keys, &combined_limit );
+  }
+  clock_t limited_time = clock() - start;
+
+  CountingCollector scratch_keys( true );
+  start = clock();
+  set_union.Enumerate( scratch_keys );
+  clock_t scratch_time = clock() - start;
+
+  EXPECT_INT( ( input_count + 1 ) * key_count / 2, limited_keys.m_KeyCount );
+  EXPECT_INT( ( input_count + 1 ) * key_count / 2, scratch_keys.m_KeyCount );
+
+  for( int i = 0; i < input_count; ++i )
+  {
+    inputs[ i ].Destroy();
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "limited %d ms, scratch set %d ms ", ( int )( limited_time * 1000 / CLOCKS_PER_SEC ),
+         ( int )( scratch_time * 1000 / CLOCKS_PER_SEC ) );
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoEmptyContainerMemoryTest, Benchmark )
+{
+  // Memory held by many empty and nearly empty sets. A fixed size table is allocated up front, like all tables used
+  // to be. A dynamic table is allocated on the first insert.
+  const int set_count = 100000;
+  MojoConfig fixed_config;
+  fixed_config.m_DynamicTable = false;
+  int64_t live_bytes[ 2 ][ 2 ];
+  for( int dynamic = 0; dynamic < 2; ++dynamic )
+  {
+    MojoTelemetryAlloc telemetry;
+    MojoSet< MojoHashable< int > >* sets = new MojoSet< MojoHashable< int > >[ set_count ];
+    for( int i = 0; i < set_count; ++i )
     {
-      status = set.Insert( i + 1 );
-      EXPECT_INT( kMojoStatus_Ok, status );
+      sets[ i ].Create( "empty set", dynamic ? NULL : &fixed_config, &telemetry );
     }
-
-    // More won't fit. Should not crash but report status.
-    for( int i = max_fit; i < max_fit + 10; ++i )
+    live_bytes[ dynamic ][ 0 ] = telemetry.GetTotal().m_LiveBytes;
+    for( int i = 0; i < set_count; ++i )
     {
-      status = set.Insert( i + 1 );
-      EXPECT_INT( kMojoStatus_CouldNotAlloc, status );
+      sets[ i ].Insert( i + 1 );
     }
+    live_bytes[ dynamic ][ 1 ] = telemetry.GetTotal().m_LiveBytes;
+    delete[] sets;
+    EXPECT_INT( 0, ( int )telemetry.GetTotal().m_LiveBytes );
+  }
+  EXPECT_INT( 0, ( int )live_bytes[ 1 ][ 0 ] );
+  EXPECT_TRUE( live_bytes[ 1 ][ 1 ] * 4 < live_bytes[ 0 ][ 1 ] );
 
-    // Verify that set is still functional.
-    for( int i = 0; i < max_fit; ++i )
-    {
-      status = set.Remove( i + 1 );
-      EXPECT_INT( kMojoStatus_Ok, status );
-    }
-    
-    // Verify keys are really gone.
-    for( int i = 0; i < max_fit; ++i )
+  // Clearing keeps the buffer, so a container that is cleared and refilled does not allocate again. Clearing a
+  // container that never had a buffer does not allocate one.
+  {
+    MojoSet< MojoHashable< int > > set( "reused set" );
+    MojoMap< MojoHashable< int >, MojoHashable< int > > map( "reused map" );
+    MojoArray< MojoHashable< int > > array( "reused array" );
+    MojoSet< MojoHashable< int > > unused( "unused set" );
+    int total_alloc = MyCountingAlloc.m_TotalAlloc;
+    unused.Clear();
+    EXPECT_INT( total_alloc, MyCountingAlloc.m_TotalAlloc );
+    for( int cycle = 0; cycle < 3; ++cycle )
     {
-      EXPECT_FALSE( set.Contains( i + 1 ) );
+      if( cycle == 1 )
+      {
+        total_alloc = MyCountingAlloc.m_TotalAlloc;
+      }
+      for( int i = 1; i <= 100; ++i )
+      {
+        set.Insert( i );
+        map.Insert( i, i );
+        array.Push( i );
+      }
+      set.Clear();
+      map.Clear();
+      array.Clear();
     }
-    
-    set.Destroy();
-    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( total_alloc, MyCountingAlloc.m_TotalAlloc );
   }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+
+  printf( "empty %d KB / %d KB, one key %d KB / %d KB ", ( int )( live_bytes[ 0 ][ 0 ] / 1024 ),
+         ( int )( live_bytes[ 1 ][ 0 ] / 1024 ), ( int )( live_bytes[ 0 ][ 1 ] / 1024 ),
+         ( int )( live_bytes[ 1 ][ 1 ] / 1024 ) );
 }
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -1049,6 +3122,493 @@ REGISTER_UNIT_TEST( MojoEqualityTest, Boolean )
 
 // ---------------------------------------------------------------------------------------------------------------
 
+// Compare ContainsBatch() to Contains() for all keys in [ 0, key_max ), with every third key masked out.
+static bool ContainsBatchMatches( const MojoAbstractSet< MojoHashable< int > >* set, int key_max )
+{
+  MojoHashable< int > keys[ 1000 ];
+  uint64_t mask[ 1000 / 64 + 1 ];
+  for( int base = 0; base < key_max; base += 1000 )
+  {
+    int count = MojoMin( key_max - base, 1000 );
+    MojoMaskSetAll( mask, count );
+    for( int i = 0; i < count; ++i )
+    {
+      keys[ i ] = base + i;
+      if( i % 3 == 0 )
+      {
+        MojoMaskClear( mask, i );
+      }
+    }
+    set->ContainsBatch( keys, count, mask );
+    for( int i = 0; i < count; ++i )
+    {
+      if( MojoMaskTest( mask, i ) != ( i % 3 != 0 && set->Contains( keys[ i ] ) ) )
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+REGISTER_UNIT_TEST( MojoContainsBatchTest, Boolean )
+{
+  const int key_max = 3000;
+  uint32_t seed = 12345;
+  MojoSet< MojoHashable< int > > a( "a" );
+  MojoSet< MojoHashable< int > > b( "b" );
+  MojoMap< MojoHashable< int >, int > c( "c" );
+  MojoArray< MojoHashable< int > > d( "d" );
+  MojoArray< MojoHashable< int > > e( "e" );
+  e.CreateIndex();
+  for( int i = 1; i < key_max; ++i )
+  {
+    uint32_t r = Random( &seed );
+    if( r & 1 )
+    {
+      a.Insert( i );
+    }
+    if( r & 2 )
+    {
+      b.Insert( i );
+    }
+    if( r & 4 )
+    {
+      c.Insert( i, i );
+    }
+    if( ( r & 24 ) == 0 )
+    {
+      d.Push( i );
+    }
+    else if( ( r & 24 ) == 8 )
+    {
+      e.Push( i );
+    }
+  }
+
+  MojoIntersection< MojoHashable< int > > intersection( &a, &b, &c );
+  MojoUnion< MojoHashable< int > > union_set( &a, &d, &e );
+  MojoDifference< MojoHashable< int > > difference( &union_set, &b, &c );
+  MojoComplement< MojoHashable< int > > complement( &intersection, &d );
+  const MojoAbstractSet< MojoHashable< int > >* sets[] =
+  {
+    &a, &c, &d, &e, &intersection, &union_set, &difference, &complement
+  };
+  for( int i = 0; i < ( int )( sizeof( sets ) / sizeof( sets[ 0 ] ) ); ++i )
+  {
+    EXPECT_TRUE( ContainsBatchMatches( sets[ i ], key_max + 10 ) );
+  }
+
+  // Enumerating in blocks delivers the same keys, in far fewer calls.
+  const MojoAbstractSet< MojoHashable< int > >* enumerated[] = { &a, &d, &intersection, &union_set, &difference };
+  for( int i = 0; i < ( int )( sizeof( enumerated ) / sizeof( enumerated[ 0 ] ) ); ++i )
+  {
+    CountingCollector single( false );
+    CountingCollector batched( true );
+    enumerated[ i ]->Enumerate( single );
+    enumerated[ i ]->Enumerate( batched );
+    EXPECT_INT( single.m_KeyCount, batched.m_KeyCount );
+    EXPECT_INT( single.m_KeyCount, single.m_CallCount );
+    EXPECT_TRUE( batched.m_CallCount * 32 < batched.m_KeyCount );
+  }
+  EXPECT_TRUE( MojoIsSubsetOf< MojoHashable< int > >( &intersection, &a ) );
+  EXPECT_FALSE( MojoIsSubsetOf< MojoHashable< int > >( &a, &intersection ) );
+  EXPECT_TRUE( MojoAreDisjoint< MojoHashable< int > >( &intersection, &complement ) );
+
+  a.Destroy();
+  b.Destroy();
+  c.Destroy();
+  d.Destroy();
+  e.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoConcurrentContainsTest, Boolean )
+{
+  // Several threads query the same intersection and union while they learn their probe order.
+  const int key_max = 1000;
+  MojoSet< MojoHashable< int > > a( "a" );
+  MojoSet< MojoHashable< int > > b( "b" );
+  MojoSet< MojoHashable< int > > c( "c" );
+  for( int i = 1; i < key_max; ++i )
+  {
+    if( i % 2 )
+    {
+      a.Insert( i );
+    }
+    if( i % 3 )
+    {
+      b.Insert( i );
+    }
+    if( i % 5 )
+    {
+      c.Insert( i );
+    }
+  }
+  MojoIntersection< MojoHashable< int > > intersection( &a, &b, &c );
+  MojoUnion< MojoHashable< int > > set_union( &a, &b, &c );
+
+  const int thread_count = 4;
+  std::atomic< int > error_count( 0 );
+  std::thread threads[ thread_count ];
+  for( int t = 0; t < thread_count; ++t )
+  {
+    threads[ t ] = std::thread( [ &intersection, &set_union, &error_count, t ]()
+    {
+      uint32_t seed = t + 1;
+      for( int i = 0; i < 100000; ++i )
+      {
+        int key = 1 + Random( &seed ) % ( key_max - 1 );
+        bool in_all = ( key % 2 ) && ( key % 3 ) && ( key % 5 );
+        bool in_any = ( key % 2 ) || ( key % 3 ) || ( key % 5 );
+        error_count += intersection.Contains( key ) != in_all;
+        error_count += set_union.Contains( key ) != in_any;
+      }
+    } );
+  }
+  for( int t = 0; t < thread_count; ++t )
+  {
+    threads[ t ].join();
+  }
+  EXPECT_INT( 0, error_count.load() );
+
+  a.Destroy();
+  b.Destroy();
+  c.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoCacheSetDeltaTest, Boolean )
+{
+  const int key_max = 2000;
+  uint32_t seed = 97531;
+  MojoConfig config;
+  config.m_ChangeLogCount = 64;
+  MojoSet< MojoHashable< int > > a( "a", &config );
+  MojoSet< MojoHashable< int > > b( "b", &config );
+  MojoSet< MojoHashable< int > > c( "c", &config );
+  MojoSet< MojoHashable< int > > unlogged( "unlogged" );
+  for( int i = 1; i < key_max; ++i )
+  {
+    uint32_t r = Random( &seed );
+    if( r & 1 )
+    {
+      a.Insert( i );
+    }
+    if( r & 2 )
+    {
+      b.Insert( i );
+    }
+    if( ( r & 12 ) == 0 )
+    {
+      c.Insert( i );
+    }
+  }
+
+  // ( a ∩ b ) - c, with b appearing twice.
+  MojoIntersection< MojoHashable< int > > a_and_b( &a, &b );
+  MojoUnion< MojoHashable< int > > c_or_b( &c, &b );
+  MojoDifference< MojoHashable< int > > expression( &a_and_b, &c, &c_or_b );
+  MojoCacheSet< MojoHashable< int > > cache( "cache", &expression );
+  cache.Update();
+  EXPECT_INT( 1, cache.GetRebuildCount() );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &cache, &expression ) );
+
+  // A few changes at a time are applied from the logs.
+  MojoSet< MojoHashable< int > >* sets[] = { &a, &b, &c };
+  for( int round = 0; round < 50; ++round )
+  {
+    for( int i = 0; i < 10; ++i )
+    {
+      uint32_t r = Random( &seed );
+      MojoSet< MojoHashable< int > >* set = sets[ r % 3 ];
+      int key = 1 + ( r >> 8 ) % key_max;
+      if( ( r >> 4 ) & 1 )
+      {
+        set->Insert( key );
+      }
+      else
+      {
+        set->Remove( key );
+      }
+    }
+    cache.Update();
+    EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &cache, &expression ) );
+  }
+  EXPECT_INT( 1, cache.GetRebuildCount() );
+
+  // More changes than the log holds.
+  for( int i = 1; i <= 100; ++i )
+  {
+    c.Insert( i );
+  }
+  cache.Update();
+  EXPECT_INT( 2, cache.GetRebuildCount() );
+  EXPECT_TRUE( MojoAreEquivalent< MojoHashable< int > >( &cache, &expression ) );
+
+  // Clear() empties the log.
+  b.Clear();
+  cache.Update();
+  EXPECT_INT( 3, cache.GetRebuildCount() );
+  EXPECT_INT( 0, cache._GetEnumerationCost() );
+
+  // Nothing changed, nothing to do.
+  cache.Update();
+  EXPECT_INT( 3, cache.GetRebuildCount() );
+
+  // A leaf without a log forces a rebuild on every change.
+  MojoIntersection< MojoHashable< int > > a_and_unlogged( &a, &unlogged );
+  MojoCacheSet< MojoHashable< int > > unlogged_cache( "unlogged_cache", &a_and_unlogged );
+  unlogged_cache.Update();
+  a.Insert( key_max );
+  unlogged.Insert( key_max );
+  unlogged_cache.Update();
+  EXPECT_INT( 2, unlogged_cache.GetRebuildCount() );
+  EXPECT_TRUE( unlogged_cache.Contains( key_max ) );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoQueryPlanTest, Boolean )
+{
+  const int key_max = 200;
+  MojoSet< MojoHashable< int > > a( "a" );
+  MojoSet< MojoHashable< int > > b( "b" );
+  MojoSet< MojoHashable< int > > c( "c" );
+  MojoSet< MojoHashable< int > > d( "d" );
+  uint32_t seed = 1;
+  for( int i = 0; i < key_max / 2; ++i )
+  {
+    a.Insert( 1 + Random( &seed ) % key_max );
+    b.Insert( 1 + Random( &seed ) % key_max );
+    c.Insert( 1 + Random( &seed ) % ( key_max / 2 ) );
+    d.Insert( 1 + Random( &seed ) % ( key_max / 4 ) );
+  }
+
+  MojoUnion< MojoHashable< int > > a_or_b( &a, &b );
+  MojoDifference< MojoHashable< int > > c_not_d( &c, &d );
+  MojoIntersection< MojoHashable< int > > a_and_b( &a, &b );
+  MojoIntersection< MojoHashable< int > > a_and_d( &a, &d );
+  MojoUnion< MojoHashable< int > > b_or_c( &b, &c );
+  MojoComplement< MojoHashable< int > > not_c( &c );
+  MojoUnion< MojoHashable< int > > b_or_c_or_d( &b, &c, &d );
+
+  MojoIntersection< MojoHashable< int > > e1( &a_or_b, &c_not_d );
+  MojoUnion< MojoHashable< int > > e2( &a_and_b, &not_c );
+  MojoDifference< MojoHashable< int > > e3( &a, &b_or_c, &a_and_d );
+  MojoIntersection< MojoHashable< int > > e4( &a_and_b, &c );
+  MojoDifference< MojoHashable< int > > e5( &a, &b_or_c_or_d );
+  MojoUnion< MojoHashable< int > > e6( &a_and_d, &c_not_d, &b );
+  const MojoAbstractSet< MojoHashable< int > >* expressions[] = { &e1, &e2, &e3, &e4, &e5, &e6 };
+
+  for( int e = 0; e < 6; ++e )
+  {
+    const MojoAbstractSet< MojoHashable< int > >* expression = expressions[ e ];
+    MojoQueryPlan< MojoHashable< int > > plan( "plan", expression );
+    EXPECT_INT( kMojoStatus_Ok, plan.GetStatus() );
+
+    // Same answers as the expression.
+    int count = 0;
+    int limited_count = 0;
+    bool ok = true;
+    for( int i = 1; i <= key_max; ++i )
+    {
+      bool contains = expression->Contains( i );
+      ok = ok && plan.Contains( i ) == contains;
+      count += contains;
+      limited_count += contains && d.Contains( i );
+    }
+    EXPECT_TRUE( ok );
+
+    // Each key enumerated once, with and without limit.
+    MojoArray< MojoHashable< int > > keys( "keys" );
+    bool enumerable = plan.Enumerate( MojoArrayCollector< MojoHashable< int > >( &keys ) );
+    EXPECT_TRUE( enumerable == ( expression != &e2 ) );
+    if( enumerable )
+    {
+      MojoSet< MojoHashable< int > > unique( "unique" );
+      keys.ToSet( &unique );
+      EXPECT_INT( count, keys.GetCount() );
+      EXPECT_INT( count, unique.GetCount() );
+      EXPECT_TRUE( MojoIsSubsetOf( &unique, expression ) );
+      keys.Clear();
+      plan.Enumerate( MojoArrayCollector< MojoHashable< int > >( &keys ), &d );
+      EXPECT_INT( limited_count, keys.GetCount() );
+    }
+  }
+
+  // Nested intersections are flattened, and complements pushed down to the leaves.
+  MojoQueryPlan< MojoHashable< int > > flat( "flat", &e4 );
+  EXPECT_INT( 3, flat.GetInstructionCount() );
+  MojoQueryPlan< MojoHashable< int > > pushed( "pushed", &e5 );
+  EXPECT_INT( 4, pushed.GetInstructionCount() );
+
+  // Only recompiled when a set changes size a lot.
+  EXPECT_INT( 1, flat.GetCompileCount() );
+  c.Insert( key_max + 1 );
+  flat.Update();
+  EXPECT_INT( 1, flat.GetCompileCount() );
+  for( int i = 1; i <= 10 * key_max; ++i )
+  {
+    c.Insert( key_max + i );
+  }
+  flat.Update();
+  EXPECT_INT( 2, flat.GetCompileCount() );
+  EXPECT_FALSE( flat.Contains( key_max + 1 ) );
+  a.Insert( key_max + 1 );
+  b.Insert( key_max + 1 );
+  EXPECT_TRUE( flat.Contains( key_max + 1 ) );
+
+  {
+    // Leaves that can only be tested, not enumerated, such as a filter.
+    MojoSet< MojoId > human_powered( "Human Powered" );
+    MojoSet< MojoId > motorized( "Motorized" );
+    MojoSet< MojoId > wheels( "Wheels" );
+    human_powered.Insert( "American Flyer" );
+    human_powered.Insert( "Kayak" );
+    human_powered.Insert( "Bicycle" );
+    motorized.Insert( "18 Wheeler" );
+    motorized.Insert( "Yacht" );
+    motorized.Insert( "Helicopter" );
+    motorized.Insert( "Sedan" );
+    wheels.Insert( "American Flyer" );
+    wheels.Insert( "Bicycle" );
+    wheels.Insert( "18 Wheeler" );
+    wheels.Insert( "Sedan" );
+    StringFilter string_filter_er( "er" );
+
+    MojoUnion< MojoId > all_vehicles( &human_powered, &motorized );
+    MojoDifference< MojoId > no_wheels( &all_vehicles, &wheels );
+    MojoIntersection< MojoId > vehicles_with_er( &all_vehicles, &string_filter_er );
+    MojoQueryPlan< MojoId > no_wheels_plan( "plan", &no_wheels );
+    MojoQueryPlan< MojoId > vehicles_with_er_plan( "plan", &vehicles_with_er );
+    EXPECT_INT( 3, CountSet( &no_wheels_plan ) );               // "Kayak", "Yacht", "Helicopter"
+    EXPECT_INT( 3, CountSet( &vehicles_with_er_plan ) );        // "American Flyer", "18 Wheeler", "Helicopter"
+  }
+
+  flat.Destroy();
+  pushed.Destroy();
+  a.Destroy();
+  b.Destroy();
+  c.Destroy();
+  d.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoUnionPlanTest, Boolean )
+{
+  const int key_max = 3000;
+  const int input_count = 12;
+  uint32_t seed = 86420;
+  MojoSet< MojoHashable< int > > inputs[ input_count ];
+  MojoSortedSet< CollidingKey > sorted_a( "sorted_a" );
+  MojoSortedSet< CollidingKey > sorted_b( "sorted_b" );
+  MojoSortedSet< CollidingKey > sorted_c( "sorted_c" );
+  MojoSet< MojoHashable< int > > many_ref( "many_ref" );
+  MojoSet< MojoHashable< int > > few_ref( "few_ref" );
+  MojoSet< MojoHashable< int > > sorted_ref( "sorted_ref" );
+  for( int i = 0; i < input_count; ++i )
+  {
+    inputs[ i ].Create( "input" );
+  }
+  for( int i = 1; i < key_max; ++i )
+  {
+    uint32_t r = Random( &seed );
+    for( int j = 0; j < input_count; ++j )
+    {
+      if( r & ( 1 << j ) )
+      {
+        inputs[ j ].Insert( i );
+        many_ref.Insert( i );
+        if( j < 2 )
+        {
+          few_ref.Insert( i );
+        }
+      }
+    }
+    if( r & ( 1 << 12 ) )
+    {
+      sorted_a.Insert( i );
+      sorted_ref.Insert( i );
+    }
+    if( r & ( 1 << 13 ) )
+    {
+      sorted_b.Insert( i );
+      sorted_ref.Insert( i );
+    }
+    if( ( r & ( 3 << 14 ) ) == 0 )
+    {
+      sorted_c.Insert( i );
+      sorted_ref.Insert( i );
+    }
+  }
+
+  // Many inputs are enumerated through a scratch set, two inputs limit each other, sorted inputs are merged.
+  MojoUnion< MojoHashable< int > > many;
+  for( int i = 0; i < input_count; ++i )
+  {
+    many.Add( &inputs[ i ] );
+  }
+  MojoUnion< MojoHashable< int > > few( &inputs[ 0 ], &inputs[ 1 ] );
+  MojoUnion< CollidingKey > sorted( &sorted_a, &sorted_b, &sorted_c );
+
+  MojoArray< MojoHashable< int > > pushed( "pushed" );
+  MojoSet< MojoHashable< int > > unique( "unique" );
+  many.Enumerate( MojoArrayCollector< MojoHashable< int > >( &pushed ) );
+  unique.FromArray( &pushed );
+  EXPECT_INT( many_ref.GetCount(), pushed.GetCount() );
+  EXPECT_INT( many_ref.GetCount(), unique.GetCount() );
+  EXPECT_TRUE( MojoAreEquivalent( &many_ref, &unique ) );
+
+  pushed.Clear();
+  few.Enumerate( MojoArrayCollector< MojoHashable< int > >( &pushed ) );
+  unique.FromArray( &pushed );
+  EXPECT_INT( few_ref.GetCount(), pushed.GetCount() );
+  EXPECT_INT( few_ref.GetCount(), unique.GetCount() );
+  EXPECT_TRUE( MojoAreEquivalent( &few_ref, &unique ) );
+
+  // With a limit, only keys in the limit.
+  pushed.Clear();
+  many.Enumerate( MojoArrayCollector< MojoHashable< int > >( &pushed ), &few_ref );
+  unique.FromArray( &pushed );
+  EXPECT_INT( few_ref.GetCount(), pushed.GetCount() );
+  EXPECT_TRUE( MojoAreEquivalent( &few_ref, &unique ) );
+
+  MojoArray< CollidingKey > sorted_pushed( "sorted_pushed" );
+  sorted.Enumerate( MojoArrayCollector< CollidingKey >( &sorted_pushed ) );
+  EXPECT_INT( sorted_ref.GetCount(), sorted_pushed.GetCount() );
+  unique.Clear();
+  for( int i = 0; i < sorted_pushed.GetCount(); ++i )
+  {
+    unique.Insert( sorted_pushed[ i ].m_Value );
+  }
+  EXPECT_INT( sorted_ref.GetCount(), unique.GetCount() );
+  EXPECT_TRUE( MojoAreEquivalent( &sorted_ref, &unique ) );
+
+  for( int i = 0; i < input_count; ++i )
+  {
+    inputs[ i ].Destroy();
+  }
+  sorted_a.Destroy();
+  sorted_b.Destroy();
+  sorted_c.Destroy();
+  many_ref.Destroy();
+  few_ref.Destroy();
+  sorted_ref.Destroy();
+  pushed.Destroy();
+  unique.Destroy();
+  sorted_pushed.Destroy();
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
 REGISTER_UNIT_TEST( MojoMultiFunctionTest, Function )
 {
   MojoMultiMap< MojoId, MojoId > multi_map( "multi_map" );
@@ -1100,6 +3660,204 @@ REGISTER_UNIT_TEST( MojoMultiFunctionTest, Function )
 
 // ---------------------------------------------------------------------------------------------------------------
 
+REGISTER_UNIT_TEST( MojoJoinPathTest, Function )
+{
+  typedef MojoHash< uint32_t > Key;
+  const int n = 200;
+  {
+    MojoOneToMany< Key, Key > one_to_many( "one_to_many" );
+    MojoManyToMany< Key, Key > many_to_many( "many_to_many" );
+    MojoMultiMap< Key, Key > multi_map( "multi_map" );
+    MojoMap< Key, Key > map( "map" );
+    MojoSet< Key > input_set( "input_set" );
+
+    // Keys 1..n. Each hop fans out to two keys and folds back, so without deduplication the number of paths
+    // doubles with every hop.
+    for( int i = 1; i <= n; ++i )
+    {
+      one_to_many.InsertParentChild( i, n + 2 * i );
+      one_to_many.InsertParentChild( i, n + 2 * i + 1 );
+      many_to_many.InsertParentChild( n + 2 * i, i );
+      many_to_many.InsertParentChild( n + 2 * i + 1, i );
+      many_to_many.InsertParentChild( n + 2 * i + 1, i % n + 1 );
+      multi_map.Insert( i, 5 * n + i );
+      multi_map.Insert( i % n + 1, 5 * n + i );
+      map.Insert( 5 * n + i, ( 7 * i ) % n + 1 );
+    }
+    for( int i = 1; i <= n; i += 7 )
+    {
+      input_set.Insert( i );
+    }
+
+    MojoFunction< Key, Key > f1( &input_set, &one_to_many );
+    MojoFunction< Key, Key > f2( &f1, &many_to_many );
+    MojoFunction< Key, Key > f3( &f2, &multi_map );
+    MojoFunction< Key, Key > f4( &f3, &map );
+    MojoFunction< Key, Key > f5( &f4, &one_to_many );
+
+    MojoJoinPath< Key > join( &input_set );
+    join.Add( &one_to_many ).Add( &many_to_many ).Add( &multi_map ).Add( &map ).Add( &one_to_many );
+
+    MojoSet< Key > expected( "expected" );
+    MojoSet< Key > actual( "actual" );
+    f5.Enumerate( MojoSetCollector< Key >( &expected ) );
+    join.Enumerate( MojoSetCollector< Key >( &actual ) );
+    EXPECT_TRUE( expected.GetCount() > 0 );
+    EXPECT_TRUE( MojoAreEquivalent< Key >( &expected, &actual ) );
+
+    bool ok = true;
+    for( int i = 1; i <= 3 * n + 1; ++i )
+    {
+      ok = ok && join.Contains( i ) == expected.Contains( i );
+    }
+    EXPECT_TRUE( ok );
+
+    // Partial paths, and an empty path
+    MojoJoinPath< Key > parents( &input_set );
+    parents.Add( &one_to_many ).Add( &many_to_many );
+    MojoJoinPath< Key > empty( &input_set );
+    for( int i = 1; i <= 3 * n + 1; ++i )
+    {
+      ok = ok && parents.Contains( i ) == f2.Contains( i );
+      ok = ok && empty.Contains( i ) == input_set.Contains( i );
+    }
+    EXPECT_TRUE( ok );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoTraversalTest, Function )
+{
+  {
+    MojoMultiMap< MojoId, MojoId > multi_map( "multi_map" );
+    MojoSet< MojoId > input_set( "input_set" );
+    MojoSet< MojoId > output( "output" );
+
+    // A lattice of 40 layers, two nodes wide. Every node links to both nodes in the next layer, so there are 2^40
+    // paths to the bottom. Without a visited set, this would never finish.
+    for( int i = 0; i < 40; ++i )
+    {
+      multi_map.Insert( MakeId( "L", 2 * i ),     MakeId( "L", 2 * i + 2 ) );
+      multi_map.Insert( MakeId( "L", 2 * i ),     MakeId( "L", 2 * i + 3 ) );
+      multi_map.Insert( MakeId( "L", 2 * i + 1 ), MakeId( "L", 2 * i + 2 ) );
+      multi_map.Insert( MakeId( "L", 2 * i + 1 ), MakeId( "L", 2 * i + 3 ) );
+    }
+    // Cycle: Z -> X -> Y -> Z
+    multi_map.Insert( "Z", "X" );
+    multi_map.Insert( "X", "Y" );
+    multi_map.Insert( "Y", "Z" );
+
+    input_set.Insert( MakeId( "L", 0 ) );
+
+    MojoFunctionDeep< MojoId > fn_deep( &input_set, &multi_map );
+    fn_deep.Enumerate( MojoSetCollector< MojoId >( &output ) );
+    EXPECT_INT( 80, output.GetCount() );
+    EXPECT_TRUE( fn_deep.Contains( MakeId( "L", 81 ) ) );
+    EXPECT_FALSE( fn_deep.Contains( MakeId( "L", 1 ) ) );
+    EXPECT_FALSE( fn_deep.Contains( "X" ) );
+
+    // Depth limit
+    MojoFunctionDeep< MojoId > fn_depth( &input_set, &multi_map, 2 );
+    output.Clear();
+    fn_depth.Enumerate( MojoSetCollector< MojoId >( &output ) );
+    EXPECT_INT( 4, output.GetCount() );
+    EXPECT_TRUE( fn_depth.Contains( MakeId( "L", 5 ) ) );
+    EXPECT_FALSE( fn_depth.Contains( MakeId( "L", 6 ) ) );
+
+    // An input node that is part of a cycle is reached from itself
+    input_set.Clear();
+    input_set.Insert( "Z" );
+    output.Clear();
+    fn_deep.Enumerate( MojoSetCollector< MojoId >( &output ) );
+    EXPECT_INT( 3, output.GetCount() );
+    EXPECT_TRUE( fn_deep.Contains( "Z" ) );
+
+    // Breadth-first order
+    MojoArray< MojoId > order( "order" );
+    input_set.Clear();
+    input_set.Insert( MakeId( "L", 0 ) );
+    MojoFunctionDeep< MojoId > fn_bfs( &input_set, &multi_map, INT_MAX, kMojoTraversalOrder_BreadthFirst );
+    fn_bfs.Enumerate( MojoArrayCollector< MojoId >( &order ) );
+    EXPECT_INT( 80, order.GetCount() );
+    bool layered = true;
+    for( int i = 0; i < order.GetCount(); ++i )
+    {
+      MojoId id = order[ i ];
+      layered = layered && ( id == MakeId( "L", ( i & ~1 ) + 2 ) || id == MakeId( "L", ( i & ~1 ) + 3 ) );
+    }
+    EXPECT_TRUE( layered );
+
+    // The limit calls Contains() on the same function while it enumerates. Every node is still pushed once.
+    // A tree: T0 has children T1 to T10, and each of those has one child.
+    for( int i = 1; i <= 10; ++i )
+    {
+      multi_map.Insert( MakeId( "T", 0 ), MakeId( "T", i ) );
+      multi_map.Insert( MakeId( "T", i ), MakeId( "U", i ) );
+    }
+    input_set.Clear();
+    input_set.Insert( MakeId( "T", 0 ) );
+    MojoSet< MojoId > z( "z" );
+    z.Insert( "X" );
+    MojoUnion< MojoId > deep_or_z( &fn_deep, &z );
+    order.Clear();
+    EXPECT_TRUE( fn_deep.Enumerate( MojoArrayCollector< MojoId >( &order ), &deep_or_z ) );
+    EXPECT_INT( 20, order.GetCount() );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoFunctionDeepThreadTest, Function )
+{
+  // Several threads query the same function. Calls that find the shared visited table in use allocate their own.
+  // They use the internal allocator, because the counting allocator is not thread safe.
+  const int key_max = 1000;
+  {
+    MojoMultiMap< MojoHashable< int >, MojoHashable< int > > multi_map( "multi_map" );
+    MojoSet< MojoHashable< int > > input_set( "input_set" );
+    for( int i = 1; i < key_max; ++i )
+    {
+      multi_map.Insert( i, i + 1 );
+      if( 2 * i <= key_max )
+      {
+        multi_map.Insert( i, 2 * i );
+      }
+    }
+    input_set.Insert( 1 );
+    MojoFunctionDeep< MojoHashable< int > > fn_deep( &input_set, &multi_map );
+    EXPECT_TRUE( fn_deep.Contains( key_max ) );
+
+    MojoAlloc::SetDefault( NULL );
+    const int thread_count = 4;
+    std::atomic< int > error_count( 0 );
+    std::thread threads[ thread_count ];
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ] = std::thread( [ &fn_deep, &error_count, t ]()
+      {
+        uint32_t seed = t + 1;
+        for( int i = 0; i < 200; ++i )
+        {
+          int key = 1 + Random( &seed ) % ( key_max + 10 );
+          error_count += fn_deep.Contains( key ) != ( key >= 2 && key <= key_max );
+        }
+      } );
+    }
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ].join();
+    }
+    MojoAlloc::SetDefault( &MyCountingAlloc );
+    EXPECT_INT( 0, error_count.load() );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
 REGISTER_UNIT_TEST( MojoFunctionTest, Function )
 {
   MojoMap< MojoId, MojoId > map( "map" );
@@ -1143,6 +3901,96 @@ REGISTER_UNIT_TEST( MojoFunctionTest, Function )
 
 // ---------------------------------------------------------------------------------------------------------------
 
+REGISTER_UNIT_TEST( MojoFunctionInverseTest, Function )
+{
+  typedef MojoHash< uint32_t > Key;
+  const int n = 1000;
+  {
+    MojoOneToOne< Key, Key > one_to_one( "one_to_one" );
+    MojoOneToMany< Key, Key > one_to_many( "one_to_many" );
+    MojoManyToMany< Key, Key > many_to_many( "many_to_many" );
+    MojoMap< Key, Key > map( "map" );
+    MojoSet< Key > input_set( "input_set" );
+
+    // Parent i has children 10 * i + 1 and 10 * i + 2. In many_to_many, parent i + 1 shares the first of these.
+    for( int i = 1; i <= n; ++i )
+    {
+      one_to_one.InsertParentChild( i, 10 * i + 1 );
+      one_to_many.InsertParentChild( i, 10 * i + 1 );
+      one_to_many.InsertParentChild( i, 10 * i + 2 );
+      many_to_many.InsertParentChild( i, 10 * i + 1 );
+      many_to_many.InsertParentChild( i, 10 * i + 2 );
+      many_to_many.InsertParentChild( i + 1, 10 * i + 1 );
+      map.Insert( i, 10 * i + 1 );
+    }
+    for( int i = 1; i <= n; i += 3 )
+    {
+      input_set.Insert( i );
+    }
+
+    MojoFunction< Key, Key > fn_one_to_one( &input_set, &one_to_one );
+    MojoFunction< Key, Key > fn_one_to_many( &input_set, &one_to_many );
+    MojoFunction< Key, Key > fn_many_to_many( &input_set, &many_to_many );
+    MojoFunction< Key, Key > fn_map( &input_set, &map );
+    EXPECT_INT( kMojoStatus_Ok, fn_map.BuildIndex() );
+
+    bool ok = true;
+    for( int i = 1; i <= n; ++i )
+    {
+      bool in_input = ( i % 3 ) == 1;
+      bool prev_in_input = ( i % 3 ) == 0;
+      ok = ok && fn_one_to_one.Contains( 10 * i + 1 ) == in_input;
+      ok = ok && !fn_one_to_one.Contains( 10 * i + 2 );
+      ok = ok && fn_one_to_many.Contains( 10 * i + 1 ) == in_input;
+      ok = ok && fn_one_to_many.Contains( 10 * i + 2 ) == in_input;
+      ok = ok && fn_many_to_many.Contains( 10 * i + 1 ) == ( in_input || prev_in_input );
+      ok = ok && fn_many_to_many.Contains( 10 * i + 2 ) == in_input;
+      ok = ok && fn_map.Contains( 10 * i + 1 ) == in_input;
+      ok = ok && !fn_map.Contains( 10 * i + 2 );
+    }
+    EXPECT_TRUE( ok );
+    EXPECT_FALSE( fn_one_to_many.Contains( 5 ) );
+
+    // Changes to the input set are seen immediately. Changes to the map invalidate the index until it is rebuilt.
+    input_set.Insert( 2 );
+    EXPECT_TRUE( fn_map.Contains( 21 ) );
+    map.Insert( 2, 99 );
+    EXPECT_FALSE( fn_map.Contains( 21 ) );
+    EXPECT_TRUE( fn_map.Contains( 99 ) );
+    EXPECT_INT( kMojoStatus_Ok, fn_map.BuildIndex() );
+    for( int i = 0; i < n; ++i )
+    {
+      ok = ok && fn_map.Contains( 99 ) && !fn_map.Contains( 21 );
+    }
+    EXPECT_TRUE( ok );
+
+    // Contains() only reads, so several threads may query the same function.
+    const int thread_count = 4;
+    std::atomic< int > error_count( 0 );
+    std::thread threads[ thread_count ];
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ] = std::thread( [ &fn_map, &fn_one_to_many, &error_count ]()
+      {
+        for( int i = 3; i <= n; ++i )
+        {
+          bool in_input = ( i % 3 ) == 1;
+          error_count += fn_map.Contains( 10 * i + 1 ) != in_input;
+          error_count += fn_one_to_many.Contains( 10 * i + 2 ) != in_input;
+        }
+      } );
+    }
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ].join();
+    }
+    EXPECT_INT( 0, error_count.load() );
+  }
+  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+
 int main( int argc, const char** argv )
 {
   int error_count = 0;